@@ -0,0 +1,637 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <lsDomain.hpp>
+#include <vcLogger.hpp>
+
+#include "BoschProcessData.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Byte encoding shared by the archive writer and reader: little helpers
+/// for fixed size values, variable length integers and strings.
+class BoschArchiveCoding {
+public:
+  template <class ValueType>
+  static void put(std::string &buffer, const ValueType &value) {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  static void putVarint(std::string &buffer, std::uint64_t value) {
+    while (value >= 0x80) {
+      buffer.push_back(char((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(char(value));
+  }
+
+  static void putSigned(std::string &buffer, std::int64_t value) {
+    putVarint(buffer, (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63));
+  }
+
+  static void putString(std::string &buffer, const std::string &value) {
+    putVarint(buffer, value.size());
+    buffer.append(value);
+  }
+
+  /// Reads from a range of bytes; reading past its end sets the error flag
+  /// and returns zeros.
+  class Cursor {
+    const char *position;
+    const char *end;
+    bool isError = false;
+
+  public:
+    Cursor(const char *begin, const char *passedEnd)
+        : position(begin), end(passedEnd) {}
+
+    bool hasError() const { return isError; }
+
+    template <class ValueType> ValueType get() {
+      ValueType value{};
+      if (std::size_t(end - position) < sizeof(value)) {
+        isError = true;
+        position = end;
+        return value;
+      }
+      std::memcpy(&value, position, sizeof(value));
+      position += sizeof(value);
+      return value;
+    }
+
+    std::uint64_t getVarint() {
+      std::uint64_t value = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (position == end) {
+          isError = true;
+          return 0;
+        }
+        const auto byte = static_cast<unsigned char>(*position++);
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+          return value;
+      }
+      isError = true;
+      return 0;
+    }
+
+    std::int64_t getSigned() {
+      const std::uint64_t value = getVarint();
+      return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+    }
+
+    std::string getString() {
+      const std::uint64_t size = getVarint();
+      if (std::uint64_t(end - position) < size) {
+        isError = true;
+        position = end;
+        return std::string();
+      }
+      std::string value(position, size);
+      position += size;
+      return value;
+    }
+  };
+};
+
+/// Read-only view of a whole file, memory-mapped where possible so that
+/// only the pages which are accessed are read from disk.
+class BoschMappedFile {
+  const char *data = nullptr;
+  std::size_t size = 0;
+  std::string buffer;
+#if defined(__unix__) || defined(__APPLE__)
+  void *mapping = nullptr;
+#endif
+
+public:
+  BoschMappedFile() {}
+
+  BoschMappedFile(const BoschMappedFile &) = delete;
+  BoschMappedFile &operator=(const BoschMappedFile &) = delete;
+
+  ~BoschMappedFile() { close(); }
+
+  bool open(const std::string &fileName) {
+    close();
+#if defined(__unix__) || defined(__APPLE__)
+    const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+      return false;
+    struct stat status;
+    if (fstat(fileDescriptor, &status) == 0 && status.st_size > 0) {
+      void *pointer = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED,
+                           fileDescriptor, 0);
+      if (pointer != MAP_FAILED) {
+        mapping = pointer;
+        data = static_cast<const char *>(pointer);
+        size = status.st_size;
+      }
+    }
+    ::close(fileDescriptor);
+    if (data != nullptr)
+      return true;
+#endif
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file)
+      return false;
+    buffer.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+  }
+
+  void close() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapping != nullptr)
+      munmap(mapping, size);
+    mapping = nullptr;
+#endif
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+  }
+
+  const char *getData() const { return data; }
+
+  std::size_t getSize() const { return size; }
+};
+
+/// Index of a BoschArchive file: one row per run with its name, the
+/// values of all fields (NaN if a run does not have a field) and the
+/// location of its geometry. The archive file is laid out as
+///
+///   header    "DRIEARC1", dimension (uint32), version (uint32), offset
+///             and size of the index (uint64)
+///   records   the encoded geometry of every run
+///   index     field names, then name, field values and geometry location
+///             of every run
+///
+/// Runs are appended after the last record and a new index is written
+/// after them; the header is updated last, so an interrupted write leaves
+/// the archive with its previous index.
+class BoschArchiveIndex {
+public:
+  static constexpr char magic[9] = "DRIEARC1";
+  static constexpr std::uint32_t version = 1;
+  static constexpr std::size_t headerSize = 8 + 2 * 4 + 2 * 8;
+
+  struct Run {
+    std::string name;
+    std::vector<double> values;
+    std::uint64_t geometryOffset = 0;
+    std::uint64_t geometrySize = 0;
+    std::uint64_t numPoints = 0;
+  };
+
+  std::vector<std::string> fields;
+  std::map<std::string, std::size_t> fieldColumns;
+  std::vector<Run> runs;
+
+  std::size_t getColumn(const std::string &field) {
+    auto it = fieldColumns.find(field);
+    if (it != fieldColumns.end())
+      return it->second;
+    fieldColumns[field] = fields.size();
+    fields.push_back(field);
+    for (auto &run : runs)
+      run.values.push_back(std::numeric_limits<double>::quiet_NaN());
+    return fields.size() - 1;
+  }
+
+  std::string encode() const {
+    std::string buffer;
+    BoschArchiveCoding::putVarint(buffer, fields.size());
+    for (auto &field : fields)
+      BoschArchiveCoding::putString(buffer, field);
+    BoschArchiveCoding::putVarint(buffer, runs.size());
+    for (auto &run : runs) {
+      BoschArchiveCoding::putString(buffer, run.name);
+      for (std::size_t i = 0; i < fields.size(); ++i)
+        BoschArchiveCoding::put(buffer, run.values[i]);
+      BoschArchiveCoding::put(buffer, run.geometryOffset);
+      BoschArchiveCoding::put(buffer, run.geometrySize);
+      BoschArchiveCoding::put(buffer, run.numPoints);
+    }
+    return buffer;
+  }
+
+  bool decode(BoschArchiveCoding::Cursor cursor) {
+    fields.clear();
+    fieldColumns.clear();
+    runs.clear();
+    const std::uint64_t numFields = cursor.getVarint();
+    for (std::uint64_t i = 0; i < numFields && !cursor.hasError(); ++i) {
+      fields.push_back(cursor.getString());
+      fieldColumns[fields.back()] = i;
+    }
+    const std::uint64_t numRuns = cursor.getVarint();
+    for (std::uint64_t r = 0; r < numRuns && !cursor.hasError(); ++r) {
+      Run run;
+      run.name = cursor.getString();
+      for (std::uint64_t i = 0; i < numFields; ++i)
+        run.values.push_back(cursor.get<double>());
+      run.geometryOffset = cursor.get<std::uint64_t>();
+      run.geometrySize = cursor.get<std::uint64_t>();
+      run.numPoints = cursor.get<std::uint64_t>();
+      runs.push_back(run);
+    }
+    return !cursor.hasError();
+  }
+
+  /// Whether the range [offset, offset + length) lies within a file of
+  /// the given size. The values are read from the file, so the sum may
+  /// overflow.
+  static bool isWithin(std::uint64_t offset, std::uint64_t length,
+                       std::size_t size) {
+    return offset <= size && length <= size - offset;
+  }
+
+  /// Read the dimension and the index location from the header. Returns
+  /// false if the bytes are not an archive header.
+  static bool decodeHeader(const char *data, std::size_t size,
+                           std::uint32_t &dimension,
+                           std::uint64_t &indexOffset,
+                           std::uint64_t &indexSize) {
+    if (size < headerSize || std::memcmp(data, magic, 8) != 0)
+      return false;
+    BoschArchiveCoding::Cursor cursor(data + 8, data + headerSize);
+    dimension = cursor.get<std::uint32_t>();
+    const auto fileVersion = cursor.get<std::uint32_t>();
+    indexOffset = cursor.get<std::uint64_t>();
+    indexSize = cursor.get<std::uint64_t>();
+    return fileVersion == version && isWithin(indexOffset, indexSize, size);
+  }
+
+  static std::string encodeHeader(std::uint32_t dimension,
+                                  std::uint64_t indexOffset,
+                                  std::uint64_t indexSize) {
+    std::string buffer(magic, 8);
+    BoschArchiveCoding::put(buffer, dimension);
+    BoschArchiveCoding::put(buffer, version);
+    BoschArchiveCoding::put(buffer, indexOffset);
+    BoschArchiveCoding::put(buffer, indexSize);
+    return buffer;
+  }
+};
+
+/// Encoding of the geometry of a run: the grid, the level set width and
+/// the defined points of the level set. The points are stored as runs of
+/// consecutive grid points along x; the start of each run is stored as
+/// the difference to the previous run. Values are quantized to 1/4096 of
+/// a grid cell, which is far below the accuracy of the surface, and stored
+/// in 16 bits, so level set widths up to 7 are supported.
+template <class T, int D> class BoschArchiveGeometry {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+public:
+  static constexpr double valueScale = 4096.;
+
+  static std::string encode(LSPtrType levelSet, std::uint64_t &numPoints) {
+    const auto &grid = levelSet->getGrid();
+    std::string buffer;
+    BoschArchiveCoding::put(buffer, double(grid.getGridDelta()));
+    for (unsigned i = 0; i < D; ++i) {
+      BoschArchiveCoding::putSigned(buffer, grid.getMinGridPoint(i));
+      BoschArchiveCoding::putSigned(buffer, grid.getMaxGridPoint(i));
+      BoschArchiveCoding::putVarint(
+          buffer, static_cast<std::uint64_t>(grid.getBoundaryConditions(i)));
+    }
+    BoschArchiveCoding::putVarint(buffer, levelSet->getLevelSetWidth());
+
+    typename viennals::Domain<T, D>::PointValueVectorType points;
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, D>::DomainType>
+             it(levelSet->getDomain());
+         !it.isFinished(); ++it) {
+      if (it.isDefined())
+        points.push_back(std::make_pair(it.getStartIndices(), it.getValue()));
+    }
+    std::sort(points.begin(), points.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+    numPoints = points.size();
+
+    // split into runs along x
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      bool isContinued = !runs.empty() &&
+                         points[i].first[0] == points[i - 1].first[0] + 1;
+      for (unsigned j = 1; j < D && isContinued; ++j)
+        isContinued = points[i].first[j] == points[i - 1].first[j];
+      if (isContinued)
+        ++runs.back().second;
+      else
+        runs.push_back(std::make_pair(i, 1));
+    }
+
+    BoschArchiveCoding::putVarint(buffer, runs.size());
+    viennahrle::Index<D> previous(0);
+    for (auto &run : runs) {
+      const auto &start = points[run.first].first;
+      for (unsigned j = 0; j < D; ++j)
+        BoschArchiveCoding::putSigned(buffer,
+                                      std::int64_t(start[j]) - previous[j]);
+      previous = start;
+      BoschArchiveCoding::putVarint(buffer, run.second);
+      for (std::size_t i = run.first; i < run.first + run.second; ++i) {
+        const double value =
+            std::max(std::min(double(points[i].second) * valueScale, 32767.),
+                     -32767.);
+        BoschArchiveCoding::put(buffer, std::int16_t(std::lround(value)));
+      }
+    }
+    return buffer;
+  }
+
+  static LSPtrType decode(BoschArchiveCoding::Cursor cursor) {
+    const double gridDelta = cursor.get<double>();
+    viennahrle::IndexType minIndex[D], maxIndex[D];
+    typename viennals::Domain<T, D>::BoundaryType boundaryCons[D];
+    for (unsigned i = 0; i < D; ++i) {
+      minIndex[i] = cursor.getSigned();
+      maxIndex[i] = cursor.getSigned();
+      boundaryCons[i] =
+          static_cast<typename viennals::Domain<T, D>::BoundaryType>(
+              cursor.getVarint());
+    }
+    const int width = cursor.getVarint();
+
+    typename viennals::Domain<T, D>::PointValueVectorType points;
+    const std::uint64_t numRuns = cursor.getVarint();
+    viennahrle::Index<D> index(0);
+    for (std::uint64_t r = 0; r < numRuns && !cursor.hasError(); ++r) {
+      for (unsigned j = 0; j < D; ++j)
+        index[j] += cursor.getSigned();
+      const std::uint64_t length = cursor.getVarint();
+      auto point = index;
+      for (std::uint64_t i = 0; i < length && !cursor.hasError(); ++i) {
+        points.push_back(
+            std::make_pair(point, T(cursor.get<std::int16_t>() / valueScale)));
+        ++point[0];
+      }
+    }
+    if (cursor.hasError())
+      return nullptr;
+
+    auto levelSet = LSPtrType::New(typename viennals::Domain<T, D>::GridType(
+        minIndex, maxIndex, gridDelta, boundaryCons));
+    levelSet->insertPoints(points);
+    levelSet->getDomain().segment();
+    levelSet->finalize(width);
+    return levelSet;
+  }
+};
+
+/// Appends runs of a parameter campaign to a single archive file: the
+/// recipe of each run, its scalar metrics and its final geometry. If the
+/// file exists, the runs are added to the runs already in it. The index
+/// is written by close(), which is also called by the destructor.
+template <class T, int D> class BoschArchiveWriter {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  std::string fileName;
+  std::fstream file;
+  BoschArchiveIndex index;
+  std::uint64_t endOfRecords = BoschArchiveIndex::headerSize;
+  bool isOpen = false;
+  bool isChanged = false;
+
+public:
+  BoschArchiveWriter(std::string passedFileName) : fileName(passedFileName) {
+    if (std::filesystem::exists(fileName)) {
+      BoschMappedFile existing;
+      std::uint32_t dimension = 0;
+      std::uint64_t indexOffset = 0, indexSize = 0;
+      if (!existing.open(fileName) ||
+          !BoschArchiveIndex::decodeHeader(existing.getData(),
+                                           existing.getSize(), dimension,
+                                           indexOffset, indexSize) ||
+          dimension != D ||
+          !index.decode(BoschArchiveCoding::Cursor(
+              existing.getData() + indexOffset,
+              existing.getData() + indexOffset + indexSize))) {
+        viennacore::Logger::getInstance().addError(
+            "BoschArchiveWriter: " + fileName +
+            " is not an archive of this dimension!");
+        return;
+      }
+      endOfRecords = existing.getSize();
+      file.open(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    } else {
+      file.open(fileName, std::ios::binary | std::ios::out);
+      const auto header = BoschArchiveIndex::encodeHeader(D, 0, 0);
+      file.write(header.data(), header.size());
+    }
+    isOpen = bool(file);
+  }
+
+  ~BoschArchiveWriter() { close(); }
+
+  /// The recipe fields stored for every run: the parameters of the process
+  /// data, with the widths as full widths and the lateral etch ratio as
+  /// passed to BoschProcess::setLateralEtchRatio, and the ratio r_e of the
+  /// bottom and the start width.
+  static std::vector<std::pair<std::string, double>>
+  getRecipeFields(const BoschProcessDataType<T> &data) {
+    return {{"numCycles", data.numCycles},
+            {"isotropicRate", data.isoRate},
+            {"cycleEtchDepth", data.depthPerCycle},
+            {"startWidth", 2 * data.startWidth},
+            {"bottomWidth", 2 * data.bottomWidth},
+            {"r_e", data.bottomWidth / data.startWidth},
+            {"startOfTapering", data.taperStart},
+            {"topOffset", data.topOffset},
+            {"numTaperCycles", data.numTaperCycles},
+            {"taperRatio", data.taperRatio},
+            {"trenchBottom", data.trenchBottom},
+            {"gridDelta", data.gridDelta},
+            {"sausageCycling", data.sausageCycle},
+            {"sausageCycleDepth", data.sausageEtchRate},
+            {"lateralEtchRatio", 1. - data.lateralRatio},
+            {"numScheduledCycles", data.cycles.size()}};
+  }
+
+  /// Append a run. The name should be unique within the archive; if it is
+  /// not, queries by name return the last run of that name.
+  void addRun(const std::string &name, const BoschProcessDataType<T> &data,
+              const std::map<std::string, double> &metrics,
+              LSPtrType geometry) {
+    if (!isOpen)
+      return;
+    BoschArchiveIndex::Run run;
+    run.name = name;
+    run.values.assign(index.fields.size(),
+                      std::numeric_limits<double>::quiet_NaN());
+    for (auto &field : getRecipeFields(data)) {
+      const auto column = index.getColumn(field.first);
+      run.values.resize(index.fields.size(),
+                        std::numeric_limits<double>::quiet_NaN());
+      run.values[column] = field.second;
+    }
+    for (auto &metric : metrics) {
+      const auto column = index.getColumn(metric.first);
+      run.values.resize(index.fields.size(),
+                        std::numeric_limits<double>::quiet_NaN());
+      run.values[column] = metric.second;
+    }
+
+    const auto record =
+        BoschArchiveGeometry<T, D>::encode(geometry, run.numPoints);
+    run.geometryOffset = endOfRecords;
+    run.geometrySize = record.size();
+    file.seekp(endOfRecords);
+    file.write(record.data(), record.size());
+    endOfRecords += record.size();
+    index.runs.push_back(run);
+    isChanged = true;
+  }
+
+  /// Write the index after the last record and point the header to it.
+  void close() {
+    if (!isOpen || !isChanged)
+      return;
+    const auto encodedIndex = index.encode();
+    file.seekp(endOfRecords);
+    file.write(encodedIndex.data(), encodedIndex.size());
+    file.flush();
+    const auto header = BoschArchiveIndex::encodeHeader(
+        D, endOfRecords, encodedIndex.size());
+    file.seekp(0);
+    file.write(header.data(), header.size());
+    file.flush();
+    endOfRecords += encodedIndex.size();
+    isChanged = false;
+  }
+};
+
+/// Memory-mapped read access to an archive written by BoschArchiveWriter.
+/// Opening only reads the header and the index, so queries over the
+/// recipes and metrics of all runs do not touch the geometries, and
+/// loading a geometry only reads its own record.
+template <class T, int D> class BoschArchiveReader {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  std::string fileName;
+  BoschMappedFile mappedFile;
+  BoschArchiveIndex index;
+
+public:
+  BoschArchiveReader(std::string passedFileName) : fileName(passedFileName) {}
+
+  /// Map the file and read its index. Returns false if it is not an
+  /// archive of this dimension.
+  bool apply() {
+    std::uint32_t dimension = 0;
+    std::uint64_t indexOffset = 0, indexSize = 0;
+    if (!mappedFile.open(fileName) ||
+        !BoschArchiveIndex::decodeHeader(mappedFile.getData(),
+                                         mappedFile.getSize(), dimension,
+                                         indexOffset, indexSize) ||
+        dimension != D ||
+        !index.decode(BoschArchiveCoding::Cursor(
+            mappedFile.getData() + indexOffset,
+            mappedFile.getData() + indexOffset + indexSize))) {
+      viennacore::Logger::getInstance().addError(
+          "BoschArchiveReader: Cannot read " + fileName + "!");
+      return false;
+    }
+    return true;
+  }
+
+  /// Dimension of the archive, or 0 if the file is not an archive.
+  static unsigned readDimension(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    char header[BoschArchiveIndex::headerSize];
+    if (!file.read(header, sizeof(header)))
+      return 0;
+    std::uint32_t dimension = 0;
+    std::uint64_t indexOffset = 0, indexSize = 0;
+    // the index location is checked against the real size when opened
+    if (!BoschArchiveIndex::decodeHeader(
+            header, std::numeric_limits<std::size_t>::max(), dimension,
+            indexOffset, indexSize))
+      return 0;
+    return dimension;
+  }
+
+  std::size_t getNumberOfRuns() const { return index.runs.size(); }
+
+  const std::string &getName(std::size_t run) const {
+    return index.runs[run].name;
+  }
+
+  /// Names of the recipe fields and metrics of all runs.
+  const std::vector<std::string> &getFields() const { return index.fields; }
+
+  /// Value of a recipe field or metric of the run, NaN if it has none.
+  double getValue(std::size_t run, const std::string &field) const {
+    auto it = index.fieldColumns.find(field);
+    if (it == index.fieldColumns.end())
+      return std::numeric_limits<double>::quiet_NaN();
+    return index.runs[run].values[it->second];
+  }
+
+  std::uint64_t getNumberOfPoints(std::size_t run) const {
+    return index.runs[run].numPoints;
+  }
+
+  /// Index of the last run with this name, or getNumberOfRuns() if there
+  /// is none.
+  std::size_t findRun(const std::string &name) const {
+    for (std::size_t run = index.runs.size(); run > 0; --run) {
+      if (index.runs[run - 1].name == name)
+        return run - 1;
+    }
+    return index.runs.size();
+  }
+
+  /// Indices of all runs whose field lies within [minimum, maximum].
+  std::vector<std::size_t> findRuns(const std::string &field, double minimum,
+                                    double maximum) const {
+    std::vector<std::size_t> result;
+    auto it = index.fieldColumns.find(field);
+    if (it == index.fieldColumns.end())
+      return result;
+    for (std::size_t run = 0; run < index.runs.size(); ++run) {
+      const double value = index.runs[run].values[it->second];
+      if (value >= minimum && value <= maximum)
+        result.push_back(run);
+    }
+    return result;
+  }
+
+  /// Decode the geometry of the run. Returns nullptr if its record is
+  /// damaged.
+  LSPtrType getGeometry(std::size_t run) const {
+    const auto &entry = index.runs[run];
+    if (!BoschArchiveIndex::isWithin(entry.geometryOffset, entry.geometrySize,
+                                     mappedFile.getSize()))
+      return nullptr;
+    const char *begin = mappedFile.getData() + entry.geometryOffset;
+    return BoschArchiveGeometry<T, D>::decode(
+        BoschArchiveCoding::Cursor(begin, begin + entry.geometrySize));
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschArchiveGeometry);
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschArchiveWriter);
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschArchiveReader);
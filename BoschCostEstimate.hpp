@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "BoschMemory.hpp"
+#include "BoschProcess.hpp"
+#include "DRIEPreCompileMacros.hpp"
+#include "LayoutMask.hpp"
+
+/// Coefficients of the cost model of BoschCostEstimator. The defaults are
+/// rough values for a current x86 node; use BoschCostCalibration to fit
+/// them to measured runs on the target machine.
+struct BoschCostCoefficients {
+  // level set points per grid cell of surface
+  double pointsPerSurfaceCell = 2.5;
+  // resident bytes per level set point, including the temporary copies
+  double bytesPerPoint = 48.;
+  // resident bytes of the process before any level set exists
+  double baseBytes = 32. * 1024. * 1024.;
+  // seconds per level set point of building the mask
+  double maskSecondsPerPoint = 2e-6;
+  // seconds per candidate test of the via and the scallop stage
+  double viaSecondsPerCandidate = 2e-8;
+  double scallopSecondsPerCandidate = 1e-8;
+  // seconds per level set point of rebuilding the level set after a stage
+  double secondsPerPoint = 1e-6;
+
+  /// Write the coefficients as "key value" lines.
+  void write(std::ostream &out) const {
+    const auto precision = out.precision(10);
+    out << "pointsPerSurfaceCell " << pointsPerSurfaceCell << "\n"
+        << "bytesPerPoint " << bytesPerPoint << "\n"
+        << "baseBytes " << baseBytes << "\n"
+        << "maskSecondsPerPoint " << maskSecondsPerPoint << "\n"
+        << "viaSecondsPerCandidate " << viaSecondsPerCandidate << "\n"
+        << "scallopSecondsPerCandidate " << scallopSecondsPerCandidate
+        << "\n"
+        << "secondsPerPoint " << secondsPerPoint << "\n";
+    out.precision(precision);
+  }
+
+  bool write(const std::string &fileName) const {
+    std::ofstream file(fileName);
+    write(file);
+    return file.good();
+  }
+
+  /// Read coefficients written by write(). Keys which are missing keep
+  /// their value. Returns false if the file cannot be read or contains an
+  /// unknown key.
+  bool read(const std::string &fileName) {
+    std::ifstream file(fileName);
+    if (!file)
+      return false;
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream stream(line);
+      std::string key;
+      double value;
+      if (!(stream >> key) || key[0] == '#')
+        continue;
+      if (!(stream >> value))
+        return false;
+      if (key == "pointsPerSurfaceCell")
+        pointsPerSurfaceCell = value;
+      else if (key == "bytesPerPoint")
+        bytesPerPoint = value;
+      else if (key == "baseBytes")
+        baseBytes = value;
+      else if (key == "maskSecondsPerPoint")
+        maskSecondsPerPoint = value;
+      else if (key == "viaSecondsPerCandidate")
+        viaSecondsPerCandidate = value;
+      else if (key == "scallopSecondsPerCandidate")
+        scallopSecondsPerCandidate = value;
+      else if (key == "secondsPerPoint")
+        secondsPerPoint = value;
+      else
+        return false;
+    }
+    return true;
+  }
+};
+
+/// Predicted size and cost of a run. The work measures only depend on the
+/// recipe and the geometry; the predictions follow from them and the
+/// coefficients.
+struct BoschCostEstimate {
+  unsigned numThreads = 1;
+
+  // surface of the level sets in grid cells
+  double maskSurfaceCells = 0.;
+  double initialSurfaceCells = 0.;
+  double viaSurfaceCells = 0.;
+  double finalSurfaceCells = 0.;
+  // candidate tests of the two stages
+  double viaCandidates = 0.;
+  double scallopCandidates = 0.;
+
+  std::uint64_t numMaskPoints = 0;
+  std::uint64_t numInitialPoints = 0;
+  std::uint64_t numViaPoints = 0;
+  std::uint64_t numFinalPoints = 0;
+  // largest number of points held at once: the mask, and the old and the
+  // new substrate while a stage rebuilds it
+  std::uint64_t numPeakPoints = 0;
+  std::uint64_t peakBytes = 0;
+
+  double maskSeconds = 0.;
+  double viaSeconds = 0.;
+  double scallopSeconds = 0.;
+
+  double getSeconds() const {
+    return maskSeconds + viaSeconds + scallopSeconds;
+  }
+
+  void print(std::ostream &out = std::cout) const {
+    const double MiB = 1024. * 1024.;
+    out << "LS points: " << numInitialPoints << " initial, " << numViaPoints
+        << " after via, " << numFinalPoints << " final, " << numMaskPoints
+        << " mask" << std::endl;
+    out << "Peak memory: " << peakBytes / MiB << " MiB" << std::endl;
+    out << "Runtime on " << numThreads << " threads: mask " << maskSeconds
+        << " s, via " << viaSeconds << " s, scallops " << scallopSeconds
+        << " s" << std::endl;
+  }
+};
+
+/// Predicts the level set sizes, the peak memory and the runtime of the
+/// stages of a BoschProcess from the recipe, the domain and the mask
+/// openings, without creating any level set. The surface of each level
+/// set is estimated from the mask top, the mask walls, the sidewalls of
+/// the via (lengthened by the scallops) and the trench bottom; the
+/// candidate tests of a stage are the initial points times the grid
+/// points within the bounds of its distribution. The coefficients
+/// converting these into points, bytes and seconds are fitted by
+/// BoschCostCalibration.
+template <class T, int D> class BoschCostEstimator {
+  // a copy, since the grid delta is set on it and its data derived
+  BoschProcess<T, D> process;
+  BoschCostCoefficients coefficients;
+  BoschCostEstimate estimate;
+
+  double gridDelta = 0.;
+  std::array<double, 2 * D> bounds = {};
+  T openingArea = 0.;
+  T openingPerimeter = 0.;
+  T maskHeight = 2.;
+  unsigned numThreads = 0;
+
+public:
+  /// The estimator works on a copy of the process, which is not changed.
+  BoschCostEstimator(const BoschProcess<T, D> &passedProcess)
+      : process(passedProcess) {}
+
+  void setGridDelta(double passedGridDelta) { gridDelta = passedGridDelta; }
+
+  /// Bounds of the simulated domain, e.g. FitDomainBounds::getBounds().
+  void setDomainBounds(const std::array<double, 2 * D> &domainBounds) {
+    bounds = domainBounds;
+  }
+
+  /// Total area and perimeter of the mask openings inside the domain. In
+  /// 2D, the area is the width of the openings and the perimeter the
+  /// number of their edges.
+  void setOpening(T area, T perimeter) {
+    openingArea = area;
+    openingPerimeter = perimeter;
+  }
+
+  /// Opening of MakeMask with the given radius. fraction is the part of
+  /// the opening inside the domain, e.g. 1/4 for a mirror symmetric 3D
+  /// domain.
+  void setCircularOpening(T radius, T fraction = 1.) {
+    const double pi = std::acos(-1.);
+    if constexpr (D == 2)
+      setOpening(2 * radius * fraction, 2 * fraction);
+    else
+      setOpening(pi * radius * radius * fraction,
+                 2 * pi * radius * fraction);
+  }
+
+  /// Openings of a LayoutMask, which are assumed not to overlap. Only
+  /// used in 3D.
+  void setLayout(const PolygonLayout<T> &layout) {
+    if constexpr (D == 2) {
+      viennacore::Logger::getInstance().addError(
+          "BoschCostEstimator: Layouts are only supported in 3D!");
+      return;
+    }
+    openingArea = 0.;
+    openingPerimeter = 0.;
+    for (auto &polygon : layout.getPolygons()) {
+      T area = 0.;
+      for (std::size_t i = 0; i < polygon.size(); ++i) {
+        auto &a = polygon[i];
+        auto &b = polygon[(i + 1) % polygon.size()];
+        area += a[0] * b[1] - b[0] * a[1];
+        openingPerimeter += std::hypot(b[0] - a[0], b[1] - a[1]);
+      }
+      openingArea += std::abs(area) / 2;
+    }
+  }
+
+  /// Height of the mask above the substrate. Defaults to 2, as in
+  /// MakeMask.
+  void setMaskHeight(T height) { maskHeight = height; }
+
+  /// Number of threads of the run. Defaults to omp_get_max_threads().
+  void setNumThreads(unsigned threads) { numThreads = threads; }
+
+  void setCoefficients(const BoschCostCoefficients &passedCoefficients) {
+    coefficients = passedCoefficients;
+  }
+
+  const BoschCostCoefficients &getCoefficients() const {
+    return coefficients;
+  }
+
+  const BoschCostEstimate &getEstimate() const { return estimate; }
+
+  void apply() {
+    estimate = BoschCostEstimate();
+    if (gridDelta <= 0.) {
+      viennacore::Logger::getInstance().addError(
+          "BoschCostEstimator: Grid delta must be positive!");
+      return;
+    }
+    estimate.numThreads =
+        (numThreads > 0) ? numThreads : omp_get_max_threads();
+
+    process.setGridDelta(gridDelta);
+    process.deriveProcessData();
+    auto &data = process.getProcessData();
+
+    // lateral area of the domain and the opening, clipped to it
+    double domainArea = 1.;
+    for (unsigned i = 0; i < D - 1; ++i)
+      domainArea *= bounds[2 * i + 1] - bounds[2 * i];
+    const double area = std::clamp(double(openingArea), 0., domainArea);
+    const double perimeter = std::max(double(openingPerimeter), 0.);
+    const double depth = std::max(-data.etchBottom, 0.);
+
+    // the bottom of a tapered via narrows to bottomWidth
+    double bottomArea = area;
+    if (data.numTaperCycles > 0 && data.startWidth > 0)
+      bottomArea *= std::pow(data.bottomWidth / data.startWidth, D - 1);
+
+    // scallops of sagitta s on a period of one cycle depth d lengthen the
+    // sidewall like a parabolic arc, at most to a half circle
+    const double reach = process.getMaximumLateralReach();
+    const double period = std::abs(data.depthPerCycle);
+    double scallopFactor = 1.;
+    if (period > 0.)
+      scallopFactor = std::min(1. + 8. / 3. * std::pow(reach / period, 2),
+                               std::acos(-1.) / 2.);
+
+    const double cellArea = std::pow(gridDelta, D - 1);
+    const double top = domainArea - area + perimeter * maskHeight;
+    estimate.maskSurfaceCells = (2 * (domainArea - area) +
+                                 perimeter * maskHeight) /
+                                cellArea;
+    estimate.initialSurfaceCells = (top + area) / cellArea;
+    estimate.viaSurfaceCells =
+        (top + perimeter * depth + bottomArea) / cellArea;
+    estimate.finalSurfaceCells =
+        (top + perimeter * depth * scallopFactor + bottomArea) / cellArea;
+
+    const double k = coefficients.pointsPerSurfaceCell;
+    estimate.numMaskPoints = k * estimate.maskSurfaceCells;
+    estimate.numInitialPoints = k * estimate.initialSurfaceCells;
+    estimate.numViaPoints = k * estimate.viaSurfaceCells;
+    estimate.numFinalPoints = k * estimate.finalSurfaceCells;
+    estimate.numPeakPoints =
+        estimate.numMaskPoints +
+        2 * std::max(estimate.numViaPoints, estimate.numFinalPoints);
+    estimate.peakBytes = coefficients.baseBytes +
+                         coefficients.bytesPerPoint * estimate.numPeakPoints;
+
+    // the via distribution spans one cell laterally and the etch depth
+    // above and below each point, the scallop distribution the largest
+    // isotropic rate in every direction
+    double maxRate = (data.cycles.empty()) ? std::abs(data.isoRate) : 0.;
+    for (auto &cycle : data.cycles)
+      maxRate = std::max(maxRate, std::abs(double(cycle.isoRate)));
+    estimate.viaCandidates = estimate.numInitialPoints *
+                             std::pow(3., D - 1) *
+                             (2 * depth / gridDelta + 1);
+    estimate.scallopCandidates = estimate.numViaPoints *
+                                 std::pow(2 * maxRate / gridDelta + 1, D);
+
+    const double threads = estimate.numThreads;
+    estimate.maskSeconds =
+        coefficients.maskSecondsPerPoint *
+        (estimate.numMaskPoints + estimate.numInitialPoints);
+    estimate.viaSeconds =
+        coefficients.viaSecondsPerCandidate * estimate.viaCandidates /
+            threads +
+        coefficients.secondsPerPoint * estimate.numViaPoints;
+    estimate.scallopSeconds =
+        coefficients.scallopSecondsPerCandidate *
+            estimate.scallopCandidates / threads +
+        coefficients.secondsPerPoint * estimate.numFinalPoints;
+  }
+};
+
+/// Fits BoschCostCoefficients to runs whose stage statistics were
+/// measured, e.g. by MakeMask and BoschProcess. Each run is added with
+/// the estimate of BoschCostEstimator for its recipe and geometry; the
+/// point counts and seconds per candidate are fitted by least squares,
+/// the bytes per point together with the base memory. With a single run,
+/// only the proportional coefficients are fitted. The memory is only
+/// fitted to runs whose stages ran alone in their process, since the
+/// peak resident set size includes everything else the process does.
+class BoschCostCalibration {
+  struct Sample {
+    double x1, x2, y;
+  };
+
+  std::vector<Sample> points, memory, mask, via, scallops;
+
+  // least squares fit of y = a x1 + b x2 with a, b >= 0; if b is fixed or
+  // both cannot be determined, b is kept and only a is fitted
+  static void fit(const std::vector<Sample> &samples, double &a, double &b,
+                  bool isFixedB = false) {
+    double s11 = 0., s12 = 0., s22 = 0., s1y = 0., s2y = 0.;
+    for (auto &sample : samples) {
+      s11 += sample.x1 * sample.x1;
+      s12 += sample.x1 * sample.x2;
+      s22 += sample.x2 * sample.x2;
+      s1y += sample.x1 * sample.y;
+      s2y += sample.x2 * sample.y;
+    }
+    if (s11 <= 0.)
+      return;
+    const double det = s11 * s22 - s12 * s12;
+    if (!isFixedB && det > 1e-9 * s11 * s22) {
+      const double fittedA = (s1y * s22 - s2y * s12) / det;
+      const double fittedB = (s2y * s11 - s1y * s12) / det;
+      if (fittedA > 0. && fittedB >= 0.) {
+        a = fittedA;
+        b = fittedB;
+        return;
+      }
+    }
+    a = std::max((s1y - b * s12) / s11, 0.);
+  }
+
+  static const BoschStageStatistics *
+  findStage(const std::vector<BoschStageStatistics> &stages,
+            const std::string &name) {
+    for (auto &stage : stages)
+      if (stage.stage == name)
+        return &stage;
+    return nullptr;
+  }
+
+public:
+  /// Add a run with the estimate for its recipe and its measured stages.
+  /// Stages named "mask", "via" and "scallops" are used; a run whose
+  /// stages were loaded from a cache should not be added. The peak memory
+  /// is only used if it was measured for every stage on its own, see
+  /// BoschStageStatistics::isPeakOfStage.
+  void addRun(const BoschCostEstimate &estimate,
+              const std::vector<BoschStageStatistics> &stages) {
+    const double threads = std::max(estimate.numThreads, 1u);
+    const bool isPeakOfStages =
+        std::all_of(stages.begin(), stages.end(),
+                    [](auto &stage) { return stage.isPeakOfStage; });
+    const auto peak = BoschMemoryTracker::getPeakResidentBytes(stages);
+    if (peak > 0 && isPeakOfStages)
+      memory.push_back({double(estimate.numPeakPoints), 1., double(peak)});
+    if (auto stage = findStage(stages, "mask")) {
+      points.push_back({estimate.maskSurfaceCells, 0.,
+                        double(stage->numMaskPoints)});
+      mask.push_back({double(estimate.numMaskPoints +
+                             estimate.numInitialPoints),
+                      0., stage->seconds});
+    }
+    if (auto stage = findStage(stages, "via")) {
+      points.push_back({estimate.viaSurfaceCells, 0.,
+                        double(stage->numSubstratePoints)});
+      via.push_back({estimate.viaCandidates / threads,
+                     double(estimate.numViaPoints), stage->seconds});
+    }
+    if (auto stage = findStage(stages, "scallops")) {
+      points.push_back({estimate.finalSurfaceCells, 0.,
+                        double(stage->numSubstratePoints)});
+      scallops.push_back({estimate.scallopCandidates / threads,
+                          double(estimate.numFinalPoints), stage->seconds});
+    }
+  }
+
+  std::size_t getNumberOfRuns() const {
+    return std::max(memory.size(), std::max(via.size(), scallops.size()));
+  }
+
+  /// Fit the coefficients to the runs added so far, starting from the
+  /// given ones. The point counts of the estimates depend on
+  /// pointsPerSurfaceCell, so the estimates should be recomputed with the
+  /// result and the calibration repeated if it changed much.
+  BoschCostCoefficients
+  fit(BoschCostCoefficients coefficients = BoschCostCoefficients()) const {
+    double unused = 0.;
+    fit(points, coefficients.pointsPerSurfaceCell, unused);
+    fit(memory, coefficients.bytesPerPoint, coefficients.baseBytes);
+    fit(mask, coefficients.maskSecondsPerPoint, unused);
+    // both stages rebuild the level set, so secondsPerPoint is shared; it
+    // is fitted on the scallop stage, which rebuilds more points
+    fit(scallops, coefficients.scallopSecondsPerCandidate,
+        coefficients.secondsPerPoint);
+    fit(via, coefficients.viaSecondsPerCandidate,
+        coefficients.secondsPerPoint, true);
+    return coefficients;
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschCostEstimator);
@@ -4,6 +4,9 @@
 #include <lsGeometricAdvectDistributions.hpp>
 
 #include "BoschProcessData.hpp"
+#include "BoschProgress.hpp"
+#include "DRIEPreCompileMacros.hpp"
+#include "DistributionCounters.hpp"
 
 template <class T, int D>
 class BoschDistribution : public viennals::GeometricAdvectDistribution<T, D> {
@@ -20,6 +23,12 @@ public:
   const T zPrefactor;
   const T isoRate;
 
+  const BoschCancellationToken *cancellation = nullptr;
+  BoschStageProgress *stageProgress = nullptr;
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  DistributionCounters *counters = nullptr;
+#endif
+
   double calcZ(double n) const {
     const double &x = data.taperRatio;
     const double frac = (1 - x) / (1 + x);
@@ -27,13 +36,85 @@ public:
            (1 - frac);
   }
 
+  // maximum absolute isotropic rate, used for the bounds of the distribution
+  static T maxIsoRate(const BoschProcessDataType<T> &processData) {
+    if (processData.cycles.empty())
+      return (processData.sausageCycle > 0) ? processData.sausageEtchRate
+                                            : processData.isoRate;
+
+    T rate = (processData.sausageCycle > 0) ? processData.sausageEtchRate : 0;
+    for (auto &cycle : processData.cycles) {
+      if (std::abs(cycle.isoRate) > std::abs(rate))
+        rate = cycle.isoRate;
+    }
+    return rate;
+  }
+
+  // find the scheduled cycles next to depth |z - scallopTop| using the
+  // precomputed lookup table; returns false if z is below the last cycle
+  bool getCycleRange(double depth, unsigned &first, unsigned &last) const {
+    const unsigned bin = depth / deltaO2;
+    if (bin >= data.cycleLookup.size())
+      return false;
+
+    const unsigned nearest = data.cycleLookup[bin];
+    first = (nearest > 0) ? nearest - 1 : 0;
+    last = std::min<unsigned>(nearest + 1, data.cycles.size() - 1);
+    return true;
+  }
+
+  // returns the scheduled cycle whose centre is within gridDelta/2 of z,
+  // or -1 if there is none
+  int getScheduledCycle(double z) const {
+    const double depth = std::abs(z - scallopTop);
+    unsigned first, last;
+    if (!getCycleRange(depth, first, last))
+      return -1;
+
+    for (unsigned i = first; i <= last; ++i) {
+      const double centre = std::abs(data.cycleTop[i] - scallopTop) +
+                            std::abs(data.cycles[i].depthPerCycle) / 2;
+      if (std::abs(depth - centre) < deltaO2 + numericEps)
+        return i;
+    }
+    return -1;
+  }
+
+  double getScheduledRadius(double z) const {
+    if (z > scallopTop)
+      return 0.0;
+    if (std::abs(z + data.gridDelta - data.etchBottom) < deltaO2)
+      return data.cycles.back().isoRate;
+
+    // the sausage etch happens at the top of every sausageCycle-th cycle
+    if (data.sausageCycle > 0) {
+      const double depth = std::abs(z - scallopTop);
+      unsigned first, last;
+      if (getCycleRange(depth, first, last)) {
+        for (unsigned i = first; i <= last; ++i) {
+          if (i % data.sausageCycle == data.sausageCycle - 1 &&
+              std::abs(depth - std::abs(data.cycleTop[i] - scallopTop)) <
+                  deltaO2 + numericEps)
+            return data.sausageEtchRate;
+        }
+      }
+    }
+
+    const int cycle = getScheduledCycle(z);
+    return (cycle < 0) ? 0 : data.cycles[cycle].isoRate;
+  }
+
   double getRadius(double z) const {
+    if (!data.cycles.empty())
+      return getScheduledRadius(z);
+
     const T linearFactor = std::min(1 - gradient * (data.taperStart - z), 1.0);
 
     if (z > scallopTop)
       return 0.0;
-    // if z is at the bottom of the trench, always use the maximum radius
-    if (std::abs(z + data.gridDelta - data.trenchBottom) < deltaO2)
+    // if z is at the bottom of the etched trench, always use the maximum
+    // radius
+    if (std::abs(z + data.gridDelta - data.etchBottom) < deltaO2)
       return data.isoRate * linearFactor;
 
     // check if within isotropic cycle of sausage sequence
@@ -87,46 +168,81 @@ public:
         taperPerCycle((1 - data.taperRatio) / (1 + data.taperRatio)),
         logDenom(std::log(taperPerCycle)), deltaO2(data.gridDelta / 2.),
         zPrefactor(std::abs(2 * data.taperRatio / data.depthPerCycle)),
-        isoRate((data.sausageCycle > 0) ? data.sausageEtchRate : data.isoRate) {
+        isoRate(maxIsoRate(data)) {}
+
+  /// If the token is cancelled, no candidate is inside the distribution
+  /// anymore, so the advection finishes quickly.
+  void setCancellationToken(const BoschCancellationToken *token) {
+    cancellation = token;
+  }
+
+  /// Records every candidate point, to report the progress of the
+  /// advection.
+  void setStageProgress(BoschStageProgress *progress) {
+    stageProgress = progress;
+  }
+
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  void setCounters(DistributionCounters *passedCounters) {
+    counters = passedCounters;
   }
+#endif
 
   bool isInside(const std::array<viennahrle::CoordType, 3> &initial,
                 const std::array<viennahrle::CoordType, 3> &candidate,
                 double eps = 0.) const override {
+    if (cancellation != nullptr && cancellation->isCancelled())
+      return false;
+    if (stageProgress != nullptr)
+      stageProgress->recordCandidate(candidate[D - 1]);
+    DRIE_COUNT(counters, IS_INSIDE);
+
     viennahrle::CoordType dot = 0.;
     for (unsigned i = 0; i < D; ++i) {
       double tmp = candidate[i] - initial[i];
       dot += tmp * tmp;
     }
 
-    if (std::sqrt(dot) <= std::abs(isoRate) + eps)
+    if (std::sqrt(dot) <= std::abs(isoRate) + eps) {
+      DRIE_COUNT(counters, IS_INSIDE_ACCEPTED);
       return true;
-    else
+    } else
       return false;
   }
 
   T getSignedDistance(const std::array<viennahrle::CoordType, 3> &initial,
                       const std::array<viennahrle::CoordType, 3> &candidate,
                       unsigned long initialPointId) const override {
+    DRIE_COUNT(counters, SIGNED_DISTANCE);
     T currentRadius = getRadius(initial[D - 1]);
     T currentRadius2 = currentRadius * currentRadius;
+    if (currentRadius == 0.)
+      DRIE_COUNT(counters, ZERO_RADIUS);
+
+    double lateralRatio = data.lateralRatio;
+    if (!data.cycles.empty()) {
+      const int cycle = getScheduledCycle(initial[D - 1]);
+      if (cycle >= 0)
+        lateralRatio = data.cycles[cycle].lateralRatio;
+    }
 
     std::array<viennahrle::CoordType, 3> v = {};
     for (unsigned i = 0; i < D; ++i) {
       v[i] = std::abs(candidate[i] - initial[i]);
       // subtract half of the length in x,y to generate "lens" distribution
       if (i < D - 1)
-        v[i] +=
-            data.lateralRatio * currentRadius * ((data.isoRate < 0) ? -1 : 1);
+        v[i] += lateralRatio * currentRadius * ((data.isoRate < 0) ? -1 : 1);
     }
 
     if (std::abs(currentRadius) <= data.gridDelta) {
+      DRIE_COUNT(counters, BOX_BRANCH);
       T distance =
           std::max(std::max(std::abs(v[0]), std::abs(v[1])), std::abs(v[2])) -
           std::abs(currentRadius);
       return (currentRadius > 0) ? distance : -distance;
     }
 
+    DRIE_COUNT(counters, SPHERE_BRANCH);
     T distance = std::numeric_limits<T>::max();
     for (unsigned i = 0; i < D; ++i) {
       T y = (v[(i + 1) % D]);
@@ -153,4 +269,6 @@ public:
     bounds[2 * D - 1] = isoRate;
     return bounds;
   }
-};
\ No newline at end of file
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschDistribution);
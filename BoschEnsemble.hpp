@@ -0,0 +1,384 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <vcLogger.hpp>
+
+#include "BoschProcess.hpp"
+#include "DRIEPreCompileMacros.hpp"
+#include "GeometryComparison.hpp"
+
+/// Mean, variance and range of a stream of values, updated with Welford's
+/// algorithm so that the values themselves are never stored.
+class BoschRunningStatistics {
+  std::uint64_t count = 0;
+  double mean = 0.;
+  double sumOfSquares = 0.;
+  double minimum = std::numeric_limits<double>::max();
+  double maximum = std::numeric_limits<double>::lowest();
+
+public:
+  void add(double value) {
+    ++count;
+    const double delta = value - mean;
+    mean += delta / count;
+    sumOfSquares += delta * (value - mean);
+    minimum = std::min(minimum, value);
+    maximum = std::max(maximum, value);
+  }
+
+  std::uint64_t getCount() const { return count; }
+
+  double getMean() const { return mean; }
+
+  /// Sample variance; 0 for less than two values.
+  double getVariance() const {
+    return (count > 1) ? sumOfSquares / (count - 1) : 0.;
+  }
+
+  double getStandardDeviation() const { return std::sqrt(getVariance()); }
+
+  double getMinimum() const { return minimum; }
+
+  double getMaximum() const { return maximum; }
+};
+
+/// Histogram of non-negative values with bins of fixed width, which grows
+/// to the largest value added.
+class BoschHistogram {
+  double binWidth = 1.;
+  std::vector<std::uint64_t> counts;
+
+public:
+  BoschHistogram() {}
+
+  BoschHistogram(double passedBinWidth) : binWidth(passedBinWidth) {}
+
+  void add(double value) {
+    const std::size_t bin = std::max(value, 0.) / binWidth;
+    if (bin >= counts.size())
+      counts.resize(bin + 1, 0);
+    ++counts[bin];
+  }
+
+  double getBinWidth() const { return binWidth; }
+
+  const std::vector<std::uint64_t> &getCounts() const { return counts; }
+};
+
+/// Runs many realizations of a Bosch process whose cycles vary randomly
+/// around the nominal recipe. For every realization and cycle, the
+/// isotropic rate, the cycle etch depth and the lateral etch ratio are
+/// multiplied by (1 + sigma * n) with n drawn from a standard normal
+/// distribution seeded with the seed and the index of the realization, so
+/// the results do not depend on the number of threads.
+///
+/// The realizations run in parallel, one per thread, silently and without
+/// resetting the peak resident set size of the process. Only their
+/// statistics are kept: the etch depth, the mean and variance of the CD
+/// per depth, the distribution of the scallop heights and the deviation
+/// from the nominal geometry. Memory therefore does not grow with the
+/// number of realizations. The via stage only depends on the total depth,
+/// so it is computed once and shared through the cache if the cycle etch
+/// depths do not vary; otherwise every realization computes its own.
+///
+/// The perturbations are applied to the recipe schedule. A constant recipe
+/// is expanded into a schedule of identical cycles, for which the taper law
+/// is not applied.
+template <class T, int D> class BoschEnsemble {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+  using RecipeType = std::function<void(BoschProcess<T, D> &)>;
+
+  LSPtrType substrate;
+  LSPtrType mask;
+  RecipeType recipe;
+  viennals::SmartPointer<BoschProcessCache<T, D>> cache = nullptr;
+  unsigned numRealizations = 1;
+  std::uint64_t seed = 0;
+  double isoRateVariation = 0.;
+  double depthVariation = 0.;
+  double lateralRatioVariation = 0.;
+  double histogramBinWidth = 0.;
+
+  LSPtrType nominalSubstrate;
+  double gridDelta = 0.;
+  // CD statistics per row of grid points, keyed by z / gridDelta
+  std::map<int, BoschRunningStatistics> cdStatistics;
+  BoschRunningStatistics depthStatistics;
+  BoschRunningStatistics scallopHeightStatistics;
+  BoschHistogram scallopHeightHistogram;
+  BoschRunningStatistics symmetricDifferenceStatistics;
+  BoschRunningStatistics maxDeviationStatistics;
+
+  // the nominal cycles; lateralRatio holds the ratio passed to the setters
+  std::vector<BoschCycleParameters<T>>
+  getNominalCycles(const BoschProcess<T, D> &process) const {
+    auto cycles = process.getRecipe();
+    if (cycles.empty()) {
+      const auto &data = process.getProcessData();
+      BoschCycleParameters<T> cycle;
+      cycle.isoRate = data.isoRate;
+      cycle.depthPerCycle = data.depthPerCycle;
+      cycle.lateralRatio = data.lateralRatio;
+      cycles.assign(data.numCycles, cycle);
+
+      const bool isTapered =
+          std::abs(data.bottomWidth / data.startWidth - 1.) >= 1e-3 &&
+          std::abs(data.taperStart) <
+              std::abs(data.depthPerCycle * data.numCycles);
+      if (isTapered) {
+        viennacore::Logger::getInstance()
+            .addWarning("BoschEnsemble: The taper law is not applied to the "
+                        "realizations.")
+            .print();
+      }
+    }
+    for (auto &cycle : cycles)
+      cycle.lateralRatio = 1. - cycle.lateralRatio;
+    return cycles;
+  }
+
+  // run one realization of the process with the given cycles on a copy of
+  // the substrate
+  LSPtrType run(const std::vector<BoschCycleParameters<T>> &cycles,
+                BoschProcess<T, D> &process, bool isCached) {
+    auto result = LSPtrType::New(substrate);
+    process.setSubstrate(result);
+    process.setMask(mask);
+    recipe(process);
+    process.setVerbose(false);
+    process.clearRecipe();
+    for (auto &cycle : cycles)
+      process.addRecipeStep(1, cycle.isoRate, cycle.depthPerCycle,
+                            cycle.lateralRatio);
+    process.setCache(isCached ? cache : nullptr);
+    process.setCacheFinalStage(false);
+    process.apply();
+    return result;
+  }
+
+  std::vector<BoschCycleParameters<T>>
+  perturb(const std::vector<BoschCycleParameters<T>> &nominal,
+          unsigned realization) const {
+    std::seed_seq sequence{std::uint32_t(seed), std::uint32_t(seed >> 32),
+                           std::uint32_t(realization)};
+    std::mt19937_64 generator(sequence);
+    std::normal_distribution<double> normal(0., 1.);
+
+    auto cycles = nominal;
+    for (auto &cycle : cycles) {
+      cycle.isoRate *= 1. + isoRateVariation * normal(generator);
+      cycle.depthPerCycle *= 1. + depthVariation * normal(generator);
+      cycle.lateralRatio *= 1. + lateralRatioVariation * normal(generator);
+    }
+    return cycles;
+  }
+
+  // CD along the profile and scallop heights of one realization
+  void addRealization(const GeometryComparison<T, D> &comparison,
+                      const BoschProcessDataType<T> &data) {
+    const auto &depths = comparison.getCDDepths();
+    const auto &cds = comparison.getLevelSetCD();
+
+    depthStatistics.add(std::abs(data.etchBottom));
+    symmetricDifferenceStatistics.add(comparison.getSymmetricDifference());
+    maxDeviationStatistics.add(comparison.getMaxSurfaceDeviation());
+    for (unsigned i = 0; i < depths.size(); ++i)
+      cdStatistics[std::lround(depths[i] / gridDelta)].add(cds[i]);
+
+    // the scallop height is the lateral peak-to-valley distance of the
+    // sidewall within one cycle; the last cycle contains the trench bottom
+    for (unsigned c = 0; c + 1 < data.cycles.size(); ++c) {
+      const double top = data.cycleTop[c] + data.topOffset;
+      const double bottom = top - std::abs(data.cycles[c].depthPerCycle);
+      double minCD = std::numeric_limits<double>::max();
+      double maxCD = std::numeric_limits<double>::lowest();
+      unsigned numRows = 0;
+      for (unsigned i = 0; i < depths.size(); ++i) {
+        if (depths[i] > bottom && depths[i] <= top) {
+          minCD = std::min(minCD, double(cds[i]));
+          maxCD = std::max(maxCD, double(cds[i]));
+          ++numRows;
+        }
+      }
+      if (numRows < 2)
+        continue;
+      const double height = (maxCD - minCD) / 2.;
+      scallopHeightStatistics.add(height);
+      scallopHeightHistogram.add(height);
+    }
+  }
+
+public:
+  BoschEnsemble() {}
+
+  BoschEnsemble(LSPtrType passedSubstrate, LSPtrType passedMask)
+      : substrate(passedSubstrate), mask(passedMask) {}
+
+  /// Initial substrate of all realizations. It is not modified.
+  void setSubstrate(LSPtrType levelSet) { substrate = levelSet; }
+
+  void setMask(LSPtrType levelSet) { mask = levelSet; }
+
+  /// Sets the nominal recipe on a BoschProcess.
+  void setRecipe(RecipeType passedRecipe) { recipe = passedRecipe; }
+
+  void setNumberOfRealizations(unsigned number) { numRealizations = number; }
+
+  void setSeed(std::uint64_t passedSeed) { seed = passedSeed; }
+
+  /// Relative standard deviation of the isotropic rate of each cycle.
+  void setIsotropicRateVariation(double sigma) { isoRateVariation = sigma; }
+
+  /// Relative standard deviation of the etch depth of each cycle.
+  void setCycleEtchDepthVariation(double sigma) { depthVariation = sigma; }
+
+  /// Relative standard deviation of the lateral etch ratio of each cycle.
+  void setLateralEtchRatioVariation(double sigma) {
+    lateralRatioVariation = sigma;
+  }
+
+  /// Width of the bins of the scallop height histogram. Defaults to
+  /// gridDelta / 10.
+  void setHistogramBinWidth(double width) { histogramBinWidth = width; }
+
+  /// Cache in which the via stage is shared. If none is set, a new one is
+  /// kept in memory during apply().
+  void setCache(viennals::SmartPointer<BoschProcessCache<T, D>> passedCache) {
+    cache = passedCache;
+  }
+
+  /// Result of the unperturbed recipe, which the realizations are
+  /// compared to.
+  LSPtrType getNominalSubstrate() const { return nominalSubstrate; }
+
+  /// Depths at which the CD was measured in at least one realization.
+  std::vector<T> getCDDepths() const {
+    std::vector<T> depths;
+    for (auto &row : cdStatistics)
+      depths.push_back(row.first * gridDelta);
+    return depths;
+  }
+
+  /// CD statistics in the order of getCDDepths().
+  std::vector<BoschRunningStatistics> getCDStatistics() const {
+    std::vector<BoschRunningStatistics> statistics;
+    for (auto &row : cdStatistics)
+      statistics.push_back(row.second);
+    return statistics;
+  }
+
+  /// Etch depth of the realizations, which varies with the cycle etch
+  /// depths.
+  const BoschRunningStatistics &getDepthStatistics() const {
+    return depthStatistics;
+  }
+
+  const BoschRunningStatistics &getScallopHeightStatistics() const {
+    return scallopHeightStatistics;
+  }
+
+  const BoschHistogram &getScallopHeightHistogram() const {
+    return scallopHeightHistogram;
+  }
+
+  /// Volume of the symmetric difference to the nominal geometry.
+  const BoschRunningStatistics &getSymmetricDifferenceStatistics() const {
+    return symmetricDifferenceStatistics;
+  }
+
+  /// Maximum surface deviation from the nominal geometry.
+  const BoschRunningStatistics &getMaxDeviationStatistics() const {
+    return maxDeviationStatistics;
+  }
+
+  void apply() {
+    if (substrate == nullptr || mask == nullptr || !recipe) {
+      viennacore::Logger::getInstance().addError(
+          "BoschEnsemble: Substrate, mask and recipe must be set!");
+      return;
+    }
+    gridDelta = substrate->getGrid().getGridDelta();
+    cdStatistics.clear();
+    depthStatistics = BoschRunningStatistics();
+    scallopHeightStatistics = BoschRunningStatistics();
+    scallopHeightHistogram = BoschHistogram(
+        (histogramBinWidth > 0.) ? histogramBinWidth : gridDelta / 10.);
+    symmetricDifferenceStatistics = BoschRunningStatistics();
+    maxDeviationStatistics = BoschRunningStatistics();
+    if (cache == nullptr)
+      cache = viennals::SmartPointer<BoschProcessCache<T, D>>::New();
+
+    // the nominal run computes the shared via stage with all threads
+    std::vector<BoschCycleParameters<T>> nominalCycles;
+    std::array<T, 3> maskOrigin;
+    {
+      BoschProcess<T, D> process;
+      recipe(process);
+      nominalCycles = getNominalCycles(process);
+      nominalSubstrate = run(nominalCycles, process, true);
+      maskOrigin = process.getProcessData().maskOrigin;
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int realization = 0; realization < int(numRealizations);
+         ++realization) {
+      BoschProcess<T, D> process;
+      process.setConcurrent(true);
+      auto result = run(perturb(nominalCycles, realization), process,
+                        depthVariation == 0.);
+
+      GeometryComparison<T, D> comparison(nominalSubstrate, result);
+      comparison.setCDOrigin(maskOrigin);
+      comparison.apply();
+
+#pragma omp critical(BoschEnsembleStatistics)
+      addRealization(comparison, process.getProcessData());
+    }
+  }
+
+  /// Write the CD statistics per depth and the scallop heights as CSV.
+  void print(std::ostream &out = std::cout) const {
+    const auto precision = out.precision();
+    out << std::setprecision(6);
+    out << "depth,count,meanCD,stdCD,minCD,maxCD" << std::endl;
+    for (auto &row : cdStatistics) {
+      out << row.first * gridDelta << "," << row.second.getCount() << ","
+          << row.second.getMean() << "," << row.second.getStandardDeviation()
+          << "," << row.second.getMinimum() << "," << row.second.getMaximum()
+          << std::endl;
+    }
+    out << std::endl << "scallopHeight,count" << std::endl;
+    const auto &counts = scallopHeightHistogram.getCounts();
+    for (unsigned bin = 0; bin < counts.size(); ++bin) {
+      out << (bin + 0.5) * scallopHeightHistogram.getBinWidth() << ","
+          << counts[bin] << std::endl;
+    }
+    out << std::endl
+        << "Etch depth: " << depthStatistics.getMean() << " +- "
+        << depthStatistics.getStandardDeviation() << " ("
+        << depthStatistics.getMinimum() << " to "
+        << depthStatistics.getMaximum() << ")" << std::endl;
+    out << "Scallop height: " << scallopHeightStatistics.getMean() << " +- "
+        << scallopHeightStatistics.getStandardDeviation() << " ("
+        << scallopHeightStatistics.getCount() << " scallops)" << std::endl;
+    out << "Symmetric difference to nominal: "
+        << symmetricDifferenceStatistics.getMean() << " +- "
+        << symmetricDifferenceStatistics.getStandardDeviation() << std::endl;
+    out << "Max deviation from nominal: " << maxDeviationStatistics.getMean()
+        << " +- " << maxDeviationStatistics.getStandardDeviation()
+        << std::endl;
+    out.precision(precision);
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschEnsemble);
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <vcLogger.hpp>
+
+#include "BoschProcess.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Header of a frame file written by BoschFrameWriter. The file starts
+/// with the header, followed by the frames:
+///
+///   header  "DRIEFRM1", dimension, gridDelta, minimum and maximum grid
+///           index and boundary condition of every axis
+///   frame   cycle, key frame flag, level set width, number of set and
+///           removed points, the set points (grid index and value) and
+///           the removed points (grid index)
+///
+/// A key frame sets all defined points of the level set. Every other frame
+/// only sets the points whose value changed since the previous frame and
+/// removes the points which are no longer defined.
+struct BoschFrameHeader {
+  static constexpr char magic[9] = "DRIEFRM1";
+
+  std::uint32_t dimension = 0;
+  double gridDelta = 0.;
+  std::int32_t minIndex[3] = {};
+  std::int32_t maxIndex[3] = {};
+  std::uint32_t boundaryConditions[3] = {};
+
+  template <class ValueType>
+  static void write(std::ostream &stream, const ValueType &value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <class ValueType>
+  static bool read(std::istream &stream, ValueType &value) {
+    return bool(
+        stream.read(reinterpret_cast<char *>(&value), sizeof(value)));
+  }
+
+  void write(std::ostream &stream) const {
+    stream.write(magic, 8);
+    write(stream, dimension);
+    write(stream, gridDelta);
+    for (unsigned i = 0; i < dimension; ++i) {
+      write(stream, minIndex[i]);
+      write(stream, maxIndex[i]);
+      write(stream, boundaryConditions[i]);
+    }
+  }
+
+  bool read(std::istream &stream) {
+    char fileMagic[8];
+    if (!stream.read(fileMagic, 8) || std::memcmp(fileMagic, magic, 8) != 0)
+      return false;
+    if (!read(stream, dimension) || dimension < 2 || dimension > 3 ||
+        !read(stream, gridDelta))
+      return false;
+    for (unsigned i = 0; i < dimension; ++i) {
+      if (!read(stream, minIndex[i]) || !read(stream, maxIndex[i]) ||
+          !read(stream, boundaryConditions[i]))
+        return false;
+    }
+    return true;
+  }
+
+  /// Dimension of the level sets in the frame file, or 0 if it cannot be
+  /// read.
+  static unsigned readDimension(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    BoschFrameHeader header;
+    return header.read(file) ? header.dimension : 0;
+  }
+};
+
+/// Writes the states of a level set, e.g. after every few cycles of a
+/// process, to a frame file (see BoschFrameHeader). Only the difference to
+/// the previous frame is stored, so the size of a frame grows with the
+/// region which changed and not with the size of the domain. Every
+/// keyFrameInterval-th frame is stored completely, so a frame can be
+/// rebuilt without reading all frames before it.
+template <class T, int D> class BoschFrameWriter {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+  using PointVectorType =
+      typename viennals::Domain<T, D>::PointValueVectorType;
+
+  std::string fileName;
+  std::ofstream file;
+  BoschFrameHeader header;
+  unsigned keyFrameInterval = 10;
+  unsigned maxFrames = 20;
+  unsigned numFrames = 0;
+  PointVectorType previous;
+
+  static PointVectorType getPoints(LSPtrType levelSet) {
+    PointVectorType points;
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, D>::DomainType>
+             it(levelSet->getDomain());
+         !it.isFinished(); ++it) {
+      if (it.isDefined())
+        points.push_back(std::make_pair(it.getStartIndices(), it.getValue()));
+    }
+    std::sort(points.begin(), points.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+    return points;
+  }
+
+  void writeIndex(const viennahrle::Index<D> &index) {
+    for (unsigned i = 0; i < D; ++i)
+      BoschFrameHeader::write(file, std::int32_t(index[i]));
+  }
+
+public:
+  BoschFrameWriter(std::string passedFileName) : fileName(passedFileName) {}
+
+  /// Every keyFrameInterval-th frame stores the whole level set. Defaults
+  /// to 10; 0 only stores the first frame completely.
+  void setKeyFrameInterval(unsigned interval) { keyFrameInterval = interval; }
+
+  unsigned getNumberOfFrames() const { return numFrames; }
+
+  /// Append the current state of the level set as the frame of the given
+  /// cycle. All frames must have the same grid.
+  void addFrame(unsigned cycle, LSPtrType levelSet) {
+    const auto &grid = levelSet->getGrid();
+    if (numFrames == 0) {
+      header.dimension = D;
+      header.gridDelta = grid.getGridDelta();
+      for (unsigned i = 0; i < D; ++i) {
+        header.minIndex[i] = grid.getMinGridPoint(i);
+        header.maxIndex[i] = grid.getMaxGridPoint(i);
+        header.boundaryConditions[i] =
+            static_cast<std::uint32_t>(grid.getBoundaryConditions(i));
+      }
+      file.open(fileName, std::ios::binary | std::ios::trunc);
+      header.write(file);
+    } else {
+      bool isSameGrid = grid.getGridDelta() == header.gridDelta;
+      for (unsigned i = 0; i < D; ++i) {
+        isSameGrid &= grid.getMinGridPoint(i) == header.minIndex[i] &&
+                      grid.getMaxGridPoint(i) == header.maxIndex[i];
+      }
+      if (!isSameGrid) {
+        viennacore::Logger::getInstance().addError(
+            "BoschFrameWriter: All frames must have the same grid!");
+        return;
+      }
+    }
+
+    auto current = getPoints(levelSet);
+    const bool isKeyFrame =
+        numFrames == 0 ||
+        (keyFrameInterval > 0 && numFrames % keyFrameInterval == 0);
+
+    PointVectorType changed;
+    std::vector<viennahrle::Index<D>> removed;
+    if (isKeyFrame) {
+      changed = current;
+    } else {
+      // both point lists are sorted, so they are merged in one pass
+      auto it = previous.begin();
+      for (auto &point : current) {
+        while (it != previous.end() && it->first < point.first)
+          removed.push_back((it++)->first);
+        if (it != previous.end() && it->first == point.first) {
+          if (it->second != point.second)
+            changed.push_back(point);
+          ++it;
+        } else {
+          changed.push_back(point);
+        }
+      }
+      for (; it != previous.end(); ++it)
+        removed.push_back(it->first);
+    }
+
+    BoschFrameHeader::write(file, std::uint32_t(cycle));
+    BoschFrameHeader::write(file, std::uint8_t(isKeyFrame));
+    BoschFrameHeader::write(file, std::int32_t(levelSet->getLevelSetWidth()));
+    BoschFrameHeader::write(file, std::uint64_t(changed.size()));
+    BoschFrameHeader::write(file, std::uint64_t(removed.size()));
+    for (auto &point : changed) {
+      writeIndex(point.first);
+      BoschFrameHeader::write(file, double(point.second));
+    }
+    for (auto &index : removed)
+      writeIndex(index);
+    file.flush();
+
+    previous = std::move(current);
+    ++numFrames;
+  }
+};
+
+/// Reads a frame file written by BoschFrameWriter and rebuilds the level
+/// set of any frame from the key frame before it and the differences
+/// since.
+template <class T, int D> class BoschFrameReader {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  struct FrameInfo {
+    unsigned cycle = 0;
+    bool isKeyFrame = false;
+    int levelSetWidth = 1;
+    std::uint64_t numChanged = 0;
+    std::uint64_t numRemoved = 0;
+    std::streamoff offset = 0;
+  };
+
+  std::string fileName;
+  BoschFrameHeader header;
+  std::vector<FrameInfo> frames;
+
+  static constexpr std::streamoff indexSize = D * sizeof(std::int32_t);
+  static constexpr std::streamoff pointSize = indexSize + sizeof(double);
+
+  static bool readIndex(std::istream &stream, viennahrle::Index<D> &index) {
+    for (unsigned i = 0; i < D; ++i) {
+      std::int32_t value;
+      if (!BoschFrameHeader::read(stream, value))
+        return false;
+      index[i] = value;
+    }
+    return true;
+  }
+
+public:
+  BoschFrameReader(std::string passedFileName) : fileName(passedFileName) {}
+
+  /// Read the header and the table of frames. Returns false if the file
+  /// cannot be read or was written for another dimension.
+  bool apply() {
+    frames.clear();
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+    if (!header.read(file) || header.dimension != D) {
+      viennacore::Logger::getInstance().addError(
+          "BoschFrameReader: Cannot read " + fileName + "!");
+      return false;
+    }
+    while (true) {
+      FrameInfo frame;
+      std::uint32_t cycle;
+      std::uint8_t isKeyFrame;
+      std::int32_t width;
+      if (!BoschFrameHeader::read(file, cycle) ||
+          !BoschFrameHeader::read(file, isKeyFrame) ||
+          !BoschFrameHeader::read(file, width) ||
+          !BoschFrameHeader::read(file, frame.numChanged) ||
+          !BoschFrameHeader::read(file, frame.numRemoved))
+        break;
+      frame.cycle = cycle;
+      frame.isKeyFrame = isKeyFrame;
+      frame.levelSetWidth = width;
+      frame.offset = file.tellg();
+      const std::streamoff size =
+          frame.numChanged * pointSize + frame.numRemoved * indexSize;
+      // a frame which was not completely written is ignored
+      if (frame.offset + size > fileSize)
+        break;
+      frames.push_back(frame);
+      file.seekg(size, std::ios::cur);
+    }
+    return true;
+  }
+
+  std::size_t getNumberOfFrames() const { return frames.size(); }
+
+  unsigned getCycle(std::size_t frame) const { return frames[frame].cycle; }
+
+  /// Grid of all frames.
+  typename viennals::Domain<T, D>::GridType getGrid() const {
+    viennahrle::IndexType minIndex[D], maxIndex[D];
+    typename viennals::Domain<T, D>::BoundaryType boundaryCons[D];
+    for (unsigned i = 0; i < D; ++i) {
+      minIndex[i] = header.minIndex[i];
+      maxIndex[i] = header.maxIndex[i];
+      boundaryCons[i] =
+          static_cast<typename viennals::Domain<T, D>::BoundaryType>(
+              header.boundaryConditions[i]);
+    }
+    return typename viennals::Domain<T, D>::GridType(
+        minIndex, maxIndex, header.gridDelta, boundaryCons);
+  }
+
+  /// Rebuild the level set of the frame.
+  LSPtrType getFrame(std::size_t frame) const {
+    std::size_t keyFrame = frame;
+    while (!frames[keyFrame].isKeyFrame)
+      --keyFrame;
+
+    std::ifstream file(fileName, std::ios::binary);
+    std::map<viennahrle::Index<D>, T> points;
+    for (std::size_t f = keyFrame; f <= frame; ++f) {
+      file.seekg(frames[f].offset);
+      viennahrle::Index<D> index;
+      for (std::uint64_t i = 0; i < frames[f].numChanged; ++i) {
+        double value = 0.;
+        readIndex(file, index);
+        BoschFrameHeader::read(file, value);
+        points[index] = value;
+      }
+      for (std::uint64_t i = 0; i < frames[f].numRemoved; ++i) {
+        readIndex(file, index);
+        points.erase(index);
+      }
+    }
+
+    auto levelSet = LSPtrType::New(getGrid());
+    typename viennals::Domain<T, D>::PointValueVectorType pointData(
+        points.begin(), points.end());
+    levelSet->insertPoints(pointData);
+    levelSet->getDomain().segment();
+    levelSet->finalize(frames[frame].levelSetWidth);
+    return levelSet;
+  }
+};
+
+/// Runs a BoschProcess and writes the substrate after every
+/// frameInterval-th cycle and after the last cycle to a frame file. The
+/// geometric model computes the final state in one step, so every frame
+/// runs the process from the initial substrate up to its cycle (see
+/// BoschProcess::setLastCycle): N frames cost up to N full runs. A frame
+/// cannot continue from the previous one, since the distributions place
+/// the scallops of all cycles around the initial surface. apply()
+/// therefore rejects intervals which give more than setMaxFrames()
+/// frames. The first frame is the initial substrate. After apply(), the
+/// substrate of the process holds the final state.
+template <class T, int D> class BoschCycleFrames {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  BoschProcess<T, D> &process;
+  std::string fileName = "frames.drf";
+  unsigned frameInterval = 1;
+  unsigned keyFrameInterval = 10;
+  unsigned maxFrames = 20;
+
+public:
+  BoschCycleFrames(BoschProcess<T, D> &passedProcess)
+      : process(passedProcess) {}
+
+  void setFileName(std::string passedFileName) { fileName = passedFileName; }
+
+  /// Number of cycles between two frames. Defaults to 1.
+  void setFrameInterval(unsigned interval) {
+    frameInterval = std::max(interval, 1u);
+  }
+
+  /// Largest number of computed frames, each of which costs up to one
+  /// full run of the process. Defaults to 20.
+  void setMaxFrames(unsigned frames) { maxFrames = std::max(frames, 1u); }
+
+  /// See BoschFrameWriter::setKeyFrameInterval.
+  void setKeyFrameInterval(unsigned interval) { keyFrameInterval = interval; }
+
+  void apply() {
+    auto substrate = process.getSubstrate();
+    if (substrate == nullptr) {
+      viennacore::Logger::getInstance().addError(
+          "BoschCycleFrames: The substrate of the process must be set!");
+      return;
+    }
+
+    process.setLastCycle(0);
+    process.deriveProcessData();
+    const unsigned numCycles = process.getProcessData().numCycles;
+    const unsigned numFrames =
+        (numCycles + frameInterval - 1) / frameInterval;
+    if (numFrames > maxFrames) {
+      viennacore::Logger::getInstance().addError(
+          "BoschCycleFrames: " + std::to_string(numFrames) +
+          " frames would cost up to as many full runs; increase the frame "
+          "interval to at least " +
+          std::to_string((numCycles + maxFrames - 1) / maxFrames) + "!");
+      return;
+    }
+
+    BoschFrameWriter<T, D> writer(fileName);
+    writer.setKeyFrameInterval(keyFrameInterval);
+    writer.addFrame(0, substrate);
+    if (numCycles == 0)
+      return;
+
+    auto initial = LSPtrType::New(substrate);
+    for (unsigned cycle = frameInterval;; cycle += frameInterval) {
+      cycle = std::min(cycle, numCycles);
+      substrate->deepCopy(initial);
+      process.setLastCycle(cycle);
+      process.apply();
+      if (process.isCancelled())
+        break;
+      writer.addFrame(cycle, substrate);
+      if (cycle == numCycles)
+        break;
+    }
+    process.setLastCycle(0);
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschFrameWriter);
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschFrameReader);
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschCycleFrames);
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "BoschProcessCache.hpp"
+
+/// One line of the job manifest: a unique name followed by key=value
+/// parameters.
+class BoschJob {
+  std::string name;
+  std::map<std::string, std::string> parameters;
+
+public:
+  BoschJob() {}
+
+  /// Parse a manifest line. Returns false and sets error if the line is
+  /// malformed.
+  bool parse(const std::string &line, std::string &error) {
+    std::istringstream stream(line);
+    stream >> name;
+    if (name.empty() || !std::all_of(name.begin(), name.end(), [](char c) {
+          return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+                 c == '-' || c == '.';
+        })) {
+      error = "Invalid job name '" + name + "'";
+      return false;
+    }
+    std::string token;
+    while (stream >> token) {
+      const auto split = token.find('=');
+      if (split == std::string::npos || split == 0) {
+        error =
+            "Expected key=value instead of '" + token + "' in job " + name;
+        return false;
+      }
+      parameters[token.substr(0, split)] = token.substr(split + 1);
+    }
+    return true;
+  }
+
+  const std::string &getName() const { return name; }
+
+  const std::map<std::string, std::string> &getParameters() const {
+    return parameters;
+  }
+
+  bool hasParameter(const std::string &key) const {
+    return parameters.count(key) > 0;
+  }
+
+  /// Value of the parameter, or defaultValue if it is not set. Throws
+  /// std::invalid_argument if the value is not a number.
+  double getDouble(const std::string &key, double defaultValue) const {
+    auto it = parameters.find(key);
+    if (it == parameters.end())
+      return defaultValue;
+    std::size_t end = 0;
+    const double value = std::stod(it->second, &end);
+    if (end != it->second.size())
+      throw std::invalid_argument("Parameter " + key + " of job " + name +
+                                  " is not a number");
+    return value;
+  }
+
+  int getInt(const std::string &key, int defaultValue) const {
+    return std::lround(getDouble(key, defaultValue));
+  }
+
+  bool getBool(const std::string &key, bool defaultValue) const {
+    auto it = parameters.find(key);
+    if (it == parameters.end())
+      return defaultValue;
+    return it->second == "1" || it->second == "true" || it->second == "on";
+  }
+};
+
+/// Claim on a job of a BoschJobQueue. The claim is an exclusive lock on a
+/// file in the queue directory which the operating system releases when
+/// the worker process exits, so the job of a crashed worker can be claimed
+/// again. Destroying the claim without completing the job releases it.
+class BoschJobClaim {
+  int fileDescriptor = -1;
+
+public:
+  BoschJobClaim(int passedFileDescriptor)
+      : fileDescriptor(passedFileDescriptor) {}
+
+  BoschJobClaim(const BoschJobClaim &) = delete;
+  BoschJobClaim &operator=(const BoschJobClaim &) = delete;
+
+  /// Close the lock file in a child process which inherited the claim,
+  /// without releasing the lock of the worker. Otherwise the child would
+  /// keep the job locked after a crash of the worker until it exits.
+  void closeInherited() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (fileDescriptor >= 0)
+      close(fileDescriptor);
+#endif
+    fileDescriptor = -1;
+  }
+
+  ~BoschJobClaim() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (fileDescriptor >= 0) {
+      flock(fileDescriptor, LOCK_UN);
+      close(fileDescriptor);
+    }
+#endif
+  }
+};
+
+/// File based queue of jobs which several worker processes on one machine
+/// work on concurrently. The queue directory contains
+///
+///   jobs.txt        the manifest, one job per line: name key=value ...
+///   locks/<name>    lock files; a locked file means the job is running
+///   done/<name>     completion records with the hashes of the outputs
+///   failed/<name>   error messages of failed jobs
+///   output/<name>/  the outputs of the job
+///
+/// Completion records are written to a temporary file and renamed, so a
+/// job either has a complete record or is run again. Failed jobs are not
+/// retried until their record is removed.
+class BoschJobQueue {
+  std::filesystem::path directory;
+  std::vector<BoschJob> jobs;
+
+  std::filesystem::path getLockFile(const std::string &name) const {
+    return directory / "locks" / name;
+  }
+
+  std::filesystem::path getDoneFile(const std::string &name) const {
+    return directory / "done" / name;
+  }
+
+  std::filesystem::path getFailedFile(const std::string &name) const {
+    return directory / "failed" / name;
+  }
+
+  static void writeAtomically(const std::filesystem::path &fileName,
+                              const std::string &content) {
+    auto tmpFileName = fileName;
+    tmpFileName += ".partial";
+    {
+      std::ofstream file(tmpFileName);
+      file << content;
+    }
+    std::filesystem::rename(tmpFileName, fileName);
+  }
+
+public:
+  BoschJobQueue(std::filesystem::path passedDirectory)
+      : directory(passedDirectory) {}
+
+  /// Read the manifest and create the directories of the queue. Returns
+  /// false and sets error if the manifest cannot be read or is malformed.
+  bool load(std::string &error) {
+    jobs.clear();
+    std::ifstream manifest((directory / "jobs.txt").string());
+    if (!manifest) {
+      error = "Cannot read " + (directory / "jobs.txt").string();
+      return false;
+    }
+    std::string line;
+    std::map<std::string, unsigned> names;
+    while (std::getline(manifest, line)) {
+      const auto first = line.find_first_not_of(" \t\r");
+      if (first == std::string::npos || line[first] == '#')
+        continue;
+      BoschJob job;
+      if (!job.parse(line, error))
+        return false;
+      if (names[job.getName()]++ > 0) {
+        error = "Duplicate job name " + job.getName();
+        return false;
+      }
+      jobs.push_back(job);
+    }
+    for (auto sub : {"locks", "done", "failed", "output"})
+      std::filesystem::create_directories(directory / sub);
+    return true;
+  }
+
+  const std::vector<BoschJob> &getJobs() const { return jobs; }
+
+  std::filesystem::path getOutputDirectory(const std::string &name) const {
+    return directory / "output" / name;
+  }
+
+  bool isDone(const std::string &name) const {
+    return std::filesystem::exists(getDoneFile(name));
+  }
+
+  bool isFailed(const std::string &name) const {
+    return std::filesystem::exists(getFailedFile(name));
+  }
+
+  /// Try to claim the job. Returns nullptr if it is finished or claimed by
+  /// another worker.
+  std::unique_ptr<BoschJobClaim> claim(const std::string &name) const {
+#if defined(__unix__) || defined(__APPLE__)
+    if (isDone(name) || isFailed(name))
+      return nullptr;
+    const int fileDescriptor =
+        open(getLockFile(name).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fileDescriptor < 0)
+      return nullptr;
+    if (flock(fileDescriptor, LOCK_EX | LOCK_NB) != 0) {
+      close(fileDescriptor);
+      return nullptr;
+    }
+    auto claim = std::make_unique<BoschJobClaim>(fileDescriptor);
+    // the job may have finished between the check and the lock
+    if (isDone(name) || isFailed(name))
+      return nullptr;
+    return claim;
+#else
+    return nullptr;
+#endif
+  }
+
+  /// Whether a worker currently holds the claim on the job.
+  bool isRunning(const std::string &name) const {
+    if (!std::filesystem::exists(getLockFile(name)))
+      return false;
+#if defined(__unix__) || defined(__APPLE__)
+    const int fileDescriptor = open(getLockFile(name).c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+      return false;
+    const bool isLocked = flock(fileDescriptor, LOCK_SH | LOCK_NB) != 0;
+    close(fileDescriptor);
+    return isLocked;
+#else
+    return false;
+#endif
+  }
+
+  /// Hash of the content of a file, as stored in the completion records.
+  static std::string hashFile(const std::filesystem::path &fileName) {
+    std::ifstream file(fileName.string(), std::ios::binary);
+    if (!file)
+      return "missing";
+    std::ostringstream content;
+    content << file.rdbuf();
+    BoschHasher hasher;
+    hasher.add(content.str());
+    std::ostringstream hash;
+    hash << std::hex << std::setw(16) << std::setfill('0')
+         << hasher.getHash();
+    return hash.str();
+  }
+
+  /// Record the completion of a claimed job with the hashes of its output
+  /// files and release the claim.
+  void complete(const std::string &name,
+                const std::vector<std::filesystem::path> &outputs,
+                double seconds, std::unique_ptr<BoschJobClaim> claim) const {
+    std::ostringstream record;
+    record << "seconds " << seconds << "\n";
+    for (auto &output : outputs)
+      record << hashFile(output) << " "
+             << std::filesystem::relative(output, directory).string() << "\n";
+    writeAtomically(getDoneFile(name), record.str());
+    claim.reset();
+  }
+
+  /// Record that a claimed job failed and release the claim.
+  void fail(const std::string &name, const std::string &message,
+            std::unique_ptr<BoschJobClaim> claim) const {
+    writeAtomically(getFailedFile(name), message + "\n");
+    claim.reset();
+  }
+
+  /// Number of jobs which are done, failed, running and pending.
+  void printStatus(std::ostream &out = std::cout) const {
+    unsigned numDone = 0, numFailed = 0, numRunning = 0, numPending = 0;
+    for (auto &job : jobs) {
+      if (isDone(job.getName()))
+        ++numDone;
+      else if (isFailed(job.getName()))
+        ++numFailed;
+      else if (isRunning(job.getName()))
+        ++numRunning;
+      else
+        ++numPending;
+    }
+    out << jobs.size() << " jobs: " << numDone << " done, " << numFailed
+        << " failed, " << numRunning << " running, " << numPending
+        << " pending" << std::endl;
+    for (auto &job : jobs) {
+      if (isFailed(job.getName())) {
+        std::ifstream file(getFailedFile(job.getName()).string());
+        std::string message;
+        std::getline(file, message);
+        out << "  " << job.getName() << " failed: " << message << std::endl;
+      }
+    }
+  }
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/// Global allocation counters. They are only incremented if the
+/// executable is linked with DRIECountAllocations.cpp, which replaces the
+/// global operator new, see the CMake option DRIE_COUNT_ALLOCATIONS.
+/// Otherwise they stay zero.
+struct BoschAllocationCounters {
+  alignas(64) std::atomic<std::uint64_t> numAllocations{0};
+  alignas(64) std::atomic<std::uint64_t> allocatedBytes{0};
+  // set by DRIECountAllocations.cpp
+  std::atomic<bool> isCounting{false};
+
+  static BoschAllocationCounters &get() {
+    static BoschAllocationCounters counters;
+    return counters;
+  }
+
+  static bool isEnabled() {
+    return get().isCounting.load(std::memory_order_relaxed);
+  }
+};
+
+/// Resource usage of one stage of a process.
+struct BoschStageStatistics {
+  std::string stage;
+  double seconds = 0.;
+  // peak resident set size during the stage, in bytes; if the peak
+  // could not be reset at the start of the stage, this is the peak of the
+  // whole process up to the end of the stage
+  std::uint64_t peakResidentBytes = 0;
+  bool isPeakOfStage = false;
+  std::uint64_t numAllocations = 0;
+  std::uint64_t allocatedBytes = 0;
+  // number of defined points of the level sets after the stage
+  std::uint64_t numSubstratePoints = 0;
+  std::uint64_t numMaskPoints = 0;
+};
+
+/// Records time, peak resident memory and allocations of consecutive
+/// stages. The overhead per stage is reading /proc/self/status twice, so
+/// it is always enabled.
+class BoschMemoryTracker {
+  std::vector<BoschStageStatistics> statistics;
+  BoschStageStatistics current;
+  std::chrono::steady_clock::time_point start;
+  std::uint64_t startAllocations = 0;
+  std::uint64_t startBytes = 0;
+  bool isConcurrent = false;
+
+  static std::atomic<bool> &getResetPeakResident() {
+    static std::atomic<bool> isReset{false};
+    return isReset;
+  }
+
+  // reset the peak resident set size of the process if enabled; only
+  // possible on Linux
+  static bool resetPeakResident() {
+    if (!getResetPeakResident().load(std::memory_order_relaxed))
+      return false;
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (!clearRefs)
+      return false;
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+#else
+    return false;
+#endif
+  }
+
+public:
+  /// Whether beginStage resets the peak resident set size of the process,
+  /// so that the peak of each stage is measured. The reset affects the
+  /// whole process, including other trackers and the host program of a
+  /// library, so it is off by default and only enabled by executables
+  /// which run one stage at a time. Without it, the peak of a stage is
+  /// the peak of the process up to its end.
+  static void setResetPeakResident(bool isReset) {
+    getResetPeakResident().store(isReset, std::memory_order_relaxed);
+  }
+
+  static bool isResetPeakResident() {
+    return getResetPeakResident().load(std::memory_order_relaxed);
+  }
+
+  /// Whether the stages of this tracker run concurrently with other work
+  /// in the same process, e.g. on one of several threads. beginStage then
+  /// never resets the peak resident set size, since that would disturb
+  /// the measurements of the others. Defaults to false.
+  void setConcurrent(bool passedIsConcurrent) {
+    isConcurrent = passedIsConcurrent;
+  }
+
+  /// Peak resident set size of the process in bytes.
+  static std::uint64_t readPeakResidentBytes() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+      if (line.compare(0, 6, "VmHWM:") == 0)
+        return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+      return usage.ru_maxrss;
+#else
+      return usage.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return 0;
+  }
+
+  void beginStage(const std::string &stage) {
+    current = BoschStageStatistics();
+    current.stage = stage;
+    current.isPeakOfStage = !isConcurrent && resetPeakResident();
+    auto &counters = BoschAllocationCounters::get();
+    startAllocations = counters.numAllocations.load(std::memory_order_relaxed);
+    startBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+    start = std::chrono::steady_clock::now();
+  }
+
+  /// End the current stage and record the sizes of the level sets.
+  template <class LSPtrType>
+  void endStage(LSPtrType substrate, LSPtrType mask = nullptr) {
+    current.seconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    current.peakResidentBytes = readPeakResidentBytes();
+    auto &counters = BoschAllocationCounters::get();
+    current.numAllocations =
+        counters.numAllocations.load(std::memory_order_relaxed) -
+        startAllocations;
+    current.allocatedBytes =
+        counters.allocatedBytes.load(std::memory_order_relaxed) - startBytes;
+    if (substrate != nullptr)
+      current.numSubstratePoints = substrate->getNumberOfPoints();
+    if (mask != nullptr)
+      current.numMaskPoints = mask->getNumberOfPoints();
+    statistics.push_back(current);
+  }
+
+  void clear() { statistics.clear(); }
+
+  const std::vector<BoschStageStatistics> &getStatistics() const {
+    return statistics;
+  }
+
+  /// Largest peak resident set size of all stages.
+  static std::uint64_t
+  getPeakResidentBytes(const std::vector<BoschStageStatistics> &statistics) {
+    std::uint64_t peak = 0;
+    for (auto &stage : statistics)
+      peak = std::max(peak, stage.peakResidentBytes);
+    return peak;
+  }
+
+  std::uint64_t getPeakResidentBytes() const {
+    return getPeakResidentBytes(statistics);
+  }
+
+  static void print(const std::vector<BoschStageStatistics> &statistics,
+                    std::ostream &out = std::cout) {
+    const double MiB = 1024. * 1024.;
+    const auto precision = out.precision();
+    out << std::left << std::setw(12) << "stage" << std::right
+        << std::setw(10) << "time [s]" << std::setw(16) << "peak RSS [MiB]"
+        << std::setw(14) << "allocations" << std::setw(12) << "alloc [MiB]"
+        << std::setw(14) << "substrate pts" << std::setw(12) << "mask pts"
+        << std::endl;
+    for (auto &stage : statistics) {
+      out << std::left << std::setw(12) << stage.stage << std::right
+          << std::fixed << std::setprecision(2) << std::setw(10)
+          << stage.seconds << std::setw(15) << stage.peakResidentBytes / MiB
+          << (stage.isPeakOfStage ? " " : "*");
+      if (BoschAllocationCounters::isEnabled()) {
+        out << std::setw(14) << stage.numAllocations << std::setw(12)
+            << stage.allocatedBytes / MiB;
+      } else {
+        out << std::setw(14) << "-" << std::setw(12) << "-";
+      }
+      out << std::setw(14) << stage.numSubstratePoints << std::setw(12)
+          << stage.numMaskPoints << std::endl;
+      out.unsetf(std::ios::floatfield);
+    }
+    bool isProcessPeak = false;
+    for (auto &stage : statistics)
+      isProcessPeak |= !stage.isPeakOfStage;
+    if (isProcessPeak)
+      out << "* peak of the whole process up to the end of this stage"
+          << std::endl;
+    out.precision(precision);
+  }
+
+  void print(std::ostream &out = std::cout) const { print(statistics, out); }
+
+  /// Write the statistics in a form read by read(), one stage per line.
+  static void write(const std::vector<BoschStageStatistics> &statistics,
+                    std::ostream &out) {
+    const auto precision = out.precision(10);
+    for (auto &stage : statistics)
+      out << stage.stage << " " << stage.seconds << " "
+          << stage.peakResidentBytes << " " << stage.isPeakOfStage << " "
+          << stage.numAllocations << " " << stage.allocatedBytes << " "
+          << stage.numSubstratePoints << " " << stage.numMaskPoints << "\n";
+    out.precision(precision);
+  }
+
+  /// Append the stages written by write(). Returns false if a line is
+  /// malformed.
+  static bool read(std::istream &in,
+                   std::vector<BoschStageStatistics> &statistics) {
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty())
+        continue;
+      std::istringstream stream(line);
+      BoschStageStatistics stage;
+      if (!(stream >> stage.stage >> stage.seconds >>
+            stage.peakResidentBytes >> stage.isPeakOfStage >>
+            stage.numAllocations >> stage.allocatedBytes >>
+            stage.numSubstratePoints >> stage.numMaskPoints))
+        return false;
+      statistics.push_back(stage);
+    }
+    return true;
+  }
+};
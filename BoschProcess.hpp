@@ -1,14 +1,21 @@
 #pragma once
 
 #include <array>
+#include <memory>
 
 #include <lsDomain.hpp>
+#include <lsGeometricAdvect.hpp>
 #include <lsToMesh.hpp>
 #include <lsToSurfaceMesh.hpp>
 #include <lsWriteVisualizationMesh.hpp>
 
 #include "BoschDistribution.hpp"
+#include "BoschMemory.hpp"
+#include "BoschProcessCache.hpp"
 #include "BoschProcessData.hpp"
+#include "BoschProgress.hpp"
+#include "BoschResolution.hpp"
+#include "DRIEPreCompileMacros.hpp"
 #include "ViaDistribution.hpp"
 #include "lsBisect.hpp"
 
@@ -19,6 +26,96 @@ template <class T, int D> class BoschProcess {
   LSPtrType mask;
 
   BoschProcessDataType<T> processData;
+  std::vector<BoschCycleParameters<T>> cycleSchedule;
+  T startOfTapering = std::numeric_limits<T>::max();
+  unsigned lastCycle = 0;
+  viennals::SmartPointer<BoschProcessCache<T, D>> cache = nullptr;
+  bool cacheFinalStage = true;
+  double resolutionTolerance = BoschGridResolution<T>::defaultTolerance;
+  BoschProgressCallback progressCallback;
+  viennals::SmartPointer<BoschCancellationToken> cancellation = nullptr;
+  bool restoreOnCancel = true;
+  bool cancelled = false;
+  bool verbose = true;
+  BoschMemoryTracker memoryTracker;
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  DistributionCounters viaCounters;
+  DistributionCounters scallopCounters;
+#endif
+
+  // relative runtime of the stages, used for the progress estimate; set
+  // to the measured runtimes after each apply() which ran both stages,
+  // unless given by setStageWeights
+  double viaStageWeight = 1.;
+  double scallopStageWeight = 3.;
+  bool isStageWeightsSet = false;
+
+  // if cancellation was requested, restore the substrate from backup, or
+  // from the cache entry with backupKey if there is no backup, and mark
+  // the process as cancelled
+  bool checkCancelled(LSPtrType backup, std::uint64_t backupKey = 0) {
+    if (cancellation == nullptr || !cancellation->isCancelled())
+      return false;
+    if (backup != nullptr)
+      substrate->deepCopy(backup);
+    else if (backupKey != 0 && cache != nullptr)
+      cache->load(backupKey, substrate);
+    cancelled = true;
+    if (verbose)
+      std::cout << "BoschProcess cancelled" << std::endl;
+    return true;
+  }
+
+  // use the runtimes of the stages of the last apply() as their weights
+  void updateStageWeights() {
+    if (isStageWeightsSet)
+      return;
+    const auto &statistics = memoryTracker.getStatistics();
+    double viaSeconds = 0., scallopSeconds = 0.;
+    for (auto &stage : statistics) {
+      if (stage.stage == "via")
+        viaSeconds = stage.seconds;
+      else if (stage.stage == "scallops")
+        scallopSeconds = stage.seconds;
+    }
+    if (viaSeconds > 0. && scallopSeconds > 0.) {
+      viaStageWeight = viaSeconds;
+      scallopStageWeight = scallopSeconds;
+    }
+  }
+
+  // progress of the advection of the substrate with dist, reported
+  // within the stage with the given weight; none without a callback
+  std::unique_ptr<BoschStageProgress>
+  makeStageProgress(const BoschProgressReporter &progress,
+                    const std::string &stage, double weight,
+                    const viennals::GeometricAdvectDistribution<T, D> &dist) {
+    if (!progressCallback)
+      return nullptr;
+    auto minZ = std::numeric_limits<viennahrle::IndexType>::max();
+    auto maxZ = std::numeric_limits<viennahrle::IndexType>::lowest();
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, D>::DomainType>
+             it(substrate->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined())
+        continue;
+      minZ = std::min(minZ, it.getStartIndices()[D - 1]);
+      maxZ = std::max(maxZ, it.getStartIndices()[D - 1]);
+    }
+    if (minZ > maxZ)
+      return nullptr;
+    // the advected region reaches beyond the surface by the bounds of dist
+    const auto bounds = dist.getBounds();
+    const double lower = std::min(bounds[2 * D - 2], bounds[2 * D - 1]);
+    const double upper = std::max(bounds[2 * D - 2], bounds[2 * D - 1]);
+    const double gridDelta = processData.gridDelta;
+    return std::make_unique<BoschStageProgress>(
+        [&progress, stage, weight](double fraction) {
+          progress.reportWithin(stage, weight, fraction);
+        },
+        gridDelta, minZ * gridDelta + lower, maxZ * gridDelta + upper);
+  }
 
   double taperRatioFromRe(double r_e) {
     auto lambda = [r_e, N_t = processData.numTaperCycles](double x) {
@@ -31,11 +128,111 @@ template <class T, int D> class BoschProcess {
     return bisect.getRoot();
   }
 
-  double zFromTaperRatio() {
+  // depth below the start of tapering after numCycles tapered cycles
+  double zFromTaperRatio(unsigned numCycles) const {
     const double &x = processData.taperRatio;
     const double frac = (1 - x) / (1 + x);
     return processData.depthPerCycle / (1 + x) *
-           (1 - std::pow(frac, processData.numTaperCycles - 1)) / (1 - frac);
+           (1 - std::pow(frac, numCycles - 1)) / (1 - frac);
+  }
+
+  double zFromTaperRatio() const {
+    return zFromTaperRatio(processData.numTaperCycles);
+  }
+
+  // trench bottom after the first numCycles cycles of a constant recipe
+  double getCycleBottom(unsigned numCycles) const {
+    const unsigned numStraightCycles =
+        processData.numCycles - processData.numTaperCycles;
+    const bool isTapered = std::abs(processData.taperStart) <
+                           std::abs(processData.trenchBottom);
+    if (!isTapered || numCycles <= numStraightCycles)
+      return processData.depthPerCycle * numCycles + processData.topOffset -
+             processData.gridDelta / 2.;
+    return processData.taperStart +
+           zFromTaperRatio(numCycles - numStraightCycles);
+  }
+
+  // fill the per-cycle tables of processData from the recipe schedule and
+  // precompute the lookup from z to the nearest cycle centre; the cycles
+  // after lastCycle are dropped, since they do not change the earlier ones
+  void buildCycleTables() {
+    processData.cycles = cycleSchedule;
+    if (lastCycle > 0 && lastCycle < cycleSchedule.size())
+      processData.cycles.resize(lastCycle);
+    processData.cycleTop.clear();
+    processData.cycleLookup.clear();
+    processData.numCycles = processData.cycles.size();
+
+    processData.isoRate = processData.cycles.front().isoRate;
+    double top = 0.;
+    std::vector<double> centres;
+    for (auto &cycle : processData.cycles) {
+      processData.cycleTop.push_back(top);
+      centres.push_back(std::abs(top) + std::abs(cycle.depthPerCycle) / 2.);
+      top -= std::abs(cycle.depthPerCycle);
+      if (std::abs(cycle.isoRate) > std::abs(processData.isoRate))
+        processData.isoRate = cycle.isoRate;
+    }
+    processData.depthPerCycle = processData.cycles.front().depthPerCycle;
+    processData.lateralRatio = processData.cycles.front().lateralRatio;
+
+    // bins of gridDelta/2 down to one cycle below the trench bottom
+    const double binSize = processData.gridDelta / 2.;
+    const unsigned numBins =
+        std::ceil((std::abs(top) +
+                   std::abs(processData.cycles.back().depthPerCycle)) /
+                  binSize) +
+        1;
+    processData.cycleLookup.resize(numBins);
+    unsigned nearest = 0;
+    for (unsigned bin = 0; bin < numBins; ++bin) {
+      const double depth = (bin + 0.5) * binSize;
+      while (nearest + 1 < centres.size() &&
+             std::abs(centres[nearest + 1] - depth) <
+                 std::abs(centres[nearest] - depth))
+        ++nearest;
+      processData.cycleLookup[bin] = nearest;
+    }
+  }
+
+  // key of the substrate after the via pass; only contains the fields
+  // read by ViaDistribution
+  std::uint64_t getViaStageKey() const {
+    BoschHasher hasher(BoschProcessCache<T, D>::hashLevelSet(substrate));
+    hasher.add(BoschProcessCache<T, D>::hashLevelSet(mask));
+    hasher.setResolution(processData.gridDelta * 1e-6);
+    hasher.add(std::uint64_t(D));
+    hasher.add(processData.gridDelta);
+    hasher.add(processData.trenchBottom);
+    hasher.add(processData.etchBottom);
+    hasher.add(processData.taperStart);
+    hasher.add(processData.startWidth);
+    hasher.add(processData.bottomWidth);
+    for (auto &coordinate : processData.maskOrigin)
+      hasher.add(coordinate);
+    hasher.add(std::uint64_t(processData.sidewallTapering));
+    hasher.add(std::uint64_t(processData.isLineTrench));
+    return hasher.getHash();
+  }
+
+  // key of the final substrate: the via stage and all scallop parameters
+  std::uint64_t getFinalStageKey(std::uint64_t viaStageKey) const {
+    BoschHasher hasher(viaStageKey);
+    hasher.setResolution(processData.gridDelta * 1e-6);
+    hasher.add(processData.isoRate);
+    hasher.add(processData.depthPerCycle);
+    hasher.add(processData.lateralRatio);
+    hasher.add(std::uint64_t(processData.numTaperCycles));
+    hasher.add(processData.taperRatio);
+    hasher.add(std::uint64_t(processData.sausageCycle));
+    hasher.add(processData.sausageEtchRate);
+    for (auto &cycle : processData.cycles) {
+      hasher.add(cycle.isoRate);
+      hasher.add(cycle.depthPerCycle);
+      hasher.add(cycle.lateralRatio);
+    }
+    return hasher.getHash();
   }
 
 public:
@@ -53,6 +250,10 @@ public:
 
   void setMask(LSPtrType levelSet) { mask = levelSet; }
 
+  /// Grid delta used by deriveProcessData() before a substrate is set,
+  /// e.g. to estimate the cost of a recipe. setSubstrate() overrides it.
+  void setGridDelta(double gridDelta) { processData.gridDelta = gridDelta; }
+
   void setNumCycles(unsigned numberOfCycles) {
     processData.numCycles = numberOfCycles;
   }
@@ -69,8 +270,9 @@ public:
     processData.bottomWidth = widthOfTrenchBottom / 2.;
   }
 
-  void setStartOfTapering(T startOfTapering) {
-    processData.taperStart = startOfTapering;
+  void setStartOfTapering(T passedStartOfTapering) {
+    startOfTapering = passedStartOfTapering;
+    processData.taperStart = passedStartOfTapering;
   }
 
   void setTopOffset(T offsetAtTopScallop) {
@@ -101,6 +303,14 @@ public:
     processData.sausageEtchRate = sausageCycleEtchRate;
   }
 
+  /// Whether the mask opening is a line trench along y, as cut by
+  /// MakeMask with MaskShapeEnum::LINE_TRENCH, instead of a hole. The
+  /// taper of the via then only depends on x. Has no effect in 2D.
+  /// Defaults to false.
+  void setLineTrench(bool isLineTrench) {
+    processData.isLineTrench = isLineTrench;
+  }
+
   void setSidewallTapering(bool isSidewallTapering) {
     processData.isWallTapering = isSidewallTapering;
   }
@@ -109,12 +319,213 @@ public:
     processData.lateralRatio = std::max(std::min(1.0 - ratioLateral, 1.0), 0.0);
   }
 
-  void apply() {
-    // calculate all required values
+  /// Append numberOfCycles identical cycles to the recipe schedule.
+  /// Once a schedule is defined, it replaces the number of cycles,
+  /// isotropic rate, cycle etch depth and lateral etch ratio set above
+  /// and the taper law is not applied.
+  void addRecipeStep(unsigned numberOfCycles, T isotropicRate,
+                     double cycleEtchDepth, double ratioLateral) {
+    addRecipeRamp(numberOfCycles, isotropicRate, isotropicRate,
+                  cycleEtchDepth, cycleEtchDepth, ratioLateral, ratioLateral);
+  }
+
+  /// Append numberOfCycles cycles to the recipe schedule, with all
+  /// parameters ramped linearly from the start to the end values.
+  void addRecipeRamp(unsigned numberOfCycles, T startIsotropicRate,
+                     T endIsotropicRate, double startCycleEtchDepth,
+                     double endCycleEtchDepth, double startRatioLateral,
+                     double endRatioLateral) {
+    for (unsigned i = 0; i < numberOfCycles; ++i) {
+      const double s =
+          (numberOfCycles > 1) ? double(i) / (numberOfCycles - 1) : 0.;
+      BoschCycleParameters<T> cycle;
+      cycle.isoRate =
+          startIsotropicRate + s * (endIsotropicRate - startIsotropicRate);
+      cycle.depthPerCycle =
+          startCycleEtchDepth + s * (endCycleEtchDepth - startCycleEtchDepth);
+      const double ratio =
+          startRatioLateral + s * (endRatioLateral - startRatioLateral);
+      cycle.lateralRatio = std::max(std::min(1.0 - ratio, 1.0), 0.0);
+      cycleSchedule.push_back(cycle);
+    }
+  }
+
+  /// Only etch the first numberOfCycles cycles of the recipe. The taper
+  /// law and the schedule of the whole recipe are kept, so the result is
+  /// the intermediate state of the whole process after these cycles. With
+  /// the default of 0, all cycles are etched.
+  void setLastCycle(unsigned numberOfCycles) { lastCycle = numberOfCycles; }
+
+  /// Remove all steps of the recipe schedule.
+  void clearRecipe() { cycleSchedule.clear(); }
+
+  /// Cycles of the recipe schedule; empty for a constant recipe. The
+  /// lateral ratio is stored as 1 - ratioLateral.
+  const std::vector<BoschCycleParameters<T>> &getRecipe() const {
+    return cycleSchedule;
+  }
+
+  /// Cache for the substrates after the via pass and after the whole
+  /// process. Stages whose result is found in the cache are skipped.
+  void setCache(viennals::SmartPointer<BoschProcessCache<T, D>> passedCache) {
+    cache = passedCache;
+  }
+
+  /// Whether the final substrate is looked up in and stored to the cache.
+  /// Defaults to true. Disable it if the cache is only used to share the
+  /// via stage between runs with different scallop parameters, so that
+  /// the cache does not grow with the number of runs.
+  void setCacheFinalStage(bool isCacheFinalStage) {
+    cacheFinalStage = isCacheFinalStage;
+  }
+
+
+  /// Tolerance of the resolution check at the start of apply(), which
+  /// warns if the grid delta is larger than this fraction of the scallop
+  /// height or period (see BoschGridResolution). Like
+  /// getResolvedGridDelta, the check leaves out the scallops shrunk by the
+  /// taper, so a grid delta from getResolvedGridDelta with the same
+  /// tolerance never warns. Defaults to
+  /// BoschGridResolution::defaultTolerance; 0 disables the check.
+  void setResolutionTolerance(double tolerance) {
+    resolutionTolerance = tolerance;
+  }
+
+  /// Coarsest grid delta which resolves the scallops of the recipe to the
+  /// tolerance, see BoschGridResolution. Does not need a substrate, so it
+  /// can be used to set up the domain.
+  double getResolvedGridDelta(
+      double tolerance = BoschGridResolution<T>::defaultTolerance) const {
+    BoschGridResolution<T> resolution(processData, cycleSchedule);
+    resolution.setTolerance(tolerance);
+    resolution.apply();
+    return resolution.getGridDelta();
+  }
+
+  /// Called at the start and end of each stage with the stage name, the
+  /// fraction of the process which is done and the estimated remaining
+  /// time in seconds, and about once per second during the advection of
+  /// a stage, from one of the advecting threads.
+  void setProgressCallback(BoschProgressCallback callback) {
+    progressCallback = callback;
+  }
+
+  /// Relative runtimes of the via and scallop stages, used to estimate
+  /// the progress. By default 1 and 3, replaced by the measured runtimes
+  /// once apply() has run both stages.
+  void setStageWeights(double viaWeight, double scallopWeight) {
+    viaStageWeight = viaWeight;
+    scallopStageWeight = scallopWeight;
+    isStageWeightsSet = true;
+  }
+
+  /// Token which can be cancelled from another thread to stop apply()
+  /// early. A cancelled apply() does not store anything in the cache and,
+  /// see setRestoreOnCancel, leaves the substrate in the state after the
+  /// last completed stage.
+  void setCancellationToken(
+      viennals::SmartPointer<BoschCancellationToken> token) {
+    cancellation = token;
+  }
+
+  /// Whether a cancelled apply() restores the substrate to the state after
+  /// the last completed stage. This keeps a copy of the substrate while a
+  /// cancellation token is set, unless the cache can provide it, which
+  /// doubles the memory of the substrate. Without it, a cancelled
+  /// substrate is partially etched. Defaults to true.
+  void setRestoreOnCancel(bool isRestoreOnCancel) {
+    restoreOnCancel = isRestoreOnCancel;
+  }
+
+  /// Whether apply() prints the derived process data, cache hits and
+  /// cancellation to stdout and warns if the grid does not resolve the
+  /// recipe. Defaults to true.
+  void setVerbose(bool isVerbose) { verbose = isVerbose; }
+
+  /// Whether apply() runs concurrently with other work in the same
+  /// process. Its stages then do not reset the peak resident set size,
+  /// see BoschMemoryTracker::setConcurrent. Defaults to false.
+  void setConcurrent(bool isConcurrent) {
+    memoryTracker.setConcurrent(isConcurrent);
+  }
+
+  /// Whether the last call to apply() was cancelled.
+  bool isCancelled() const { return cancelled; }
+
+  /// Time, peak memory, allocations and level set sizes of the stages of
+  /// the last call to apply().
+  const std::vector<BoschStageStatistics> &getStageStatistics() const {
+    return memoryTracker.getStatistics();
+  }
+
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  /// Calls of the via distribution during the last apply().
+  const DistributionCounters &getViaCounters() const { return viaCounters; }
+
+  /// Calls of the scallop distribution during the last apply().
+  const DistributionCounters &getScallopCounters() const {
+    return scallopCounters;
+  }
+#endif
+
+  /// Largest lateral distance from the sidewall of the via which is
+  /// etched by the scallops, over all cycles including sausage cycles.
+  /// Only depends on the parameters, so it can be used to size the domain
+  /// before the level sets exist.
+  T getMaximumLateralReach() const {
+    // a scheduled recipe replaces the constant rate and ratio
+    double maxRate = 0.;
+    double minRatio = processData.lateralRatio;
+    double maxRatio = processData.lateralRatio;
+    if (cycleSchedule.empty()) {
+      maxRate = std::abs(processData.isoRate);
+    } else {
+      minRatio = maxRatio = cycleSchedule.front().lateralRatio;
+      for (auto &cycle : cycleSchedule) {
+        maxRate = std::max(maxRate, std::abs(double(cycle.isoRate)));
+        minRatio = std::min(minRatio, cycle.lateralRatio);
+        maxRatio = std::max(maxRatio, cycle.lateralRatio);
+      }
+    }
+    // candidates are shifted inwards by lateralRatio * radius
+    double reach = maxRate * (1. - minRatio);
+
+    // the shift is outwards if the sausage rate has the opposite sign
+    if (processData.sausageCycle > 0) {
+      const double rate = processData.sausageEtchRate;
+      const double isoRate = (cycleSchedule.empty())
+                                 ? processData.isoRate
+                                 : cycleSchedule.front().isoRate;
+      const double ratio = (rate * isoRate < 0) ? -maxRatio : minRatio;
+      reach = std::max(reach, std::abs(rate) * (1. - ratio));
+    }
+    return reach;
+  }
+
+  /// Process data including the values derived during the last apply().
+  const BoschProcessDataType<T> &getProcessData() const { return processData; }
+
+  LSPtrType getSubstrate() const { return substrate; }
+
+  /// Derive the trench bottom, the taper and the cycle tables from the
+  /// parameters, as done at the start of apply().
+  void deriveProcessData() {
     const double r_e = processData.bottomWidth / processData.startWidth;
-    processData.trenchBottom =
-        processData.depthPerCycle * processData.numCycles +
-        processData.topOffset - processData.gridDelta / 2.;
+    processData.taperStart = startOfTapering;
+
+    if (!cycleSchedule.empty()) {
+      buildCycleTables();
+      processData.trenchBottom =
+          processData.cycleTop.back() -
+          std::abs(processData.cycles.back().depthPerCycle) +
+          processData.topOffset - processData.gridDelta / 2.;
+      processData.taperStart = std::numeric_limits<T>::lowest();
+    } else {
+      processData.cycles.clear();
+      processData.trenchBottom =
+          processData.depthPerCycle * processData.numCycles +
+          processData.topOffset - processData.gridDelta / 2.;
+    }
 
     if (std::abs(r_e - 1.0) < 1e-3) {
       processData.taperStart = std::numeric_limits<T>::lowest();
@@ -133,18 +544,113 @@ public:
       processData.taperRatio = taperRatioFromRe(r_e);
 
       processData.trenchBottom = processData.taperStart + zFromTaperRatio();
+    } else {
+      // clear the taper of a previous apply(), since it is part of the
+      // cache key and of the archived recipe
+      processData.numTaperCycles = 0;
+      processData.taperRatio = 0.;
     }
 
-    std::cout << "d_c: " << processData.depthPerCycle << std::endl;
-    std::cout << "N_t: " << processData.numTaperCycles << std::endl;
-    std::cout << "L_t: " << processData.taperStart << std::endl;
-    std::cout << "r_e: " << r_e << std::endl;
-    std::cout << "x:   " << processData.taperRatio << std::endl;
-    std::cout << "L_b: " << processData.trenchBottom << std::endl;
+    processData.etchBottom = processData.trenchBottom;
+    if (lastCycle > 0 && lastCycle < processData.numCycles)
+      processData.etchBottom = getCycleBottom(lastCycle);
+  }
+
+  void apply() {
+    cancelled = false;
+    memoryTracker.clear();
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+    viaCounters.clear();
+    scallopCounters.clear();
+#endif
+    if (checkCancelled(nullptr))
+      return;
+
+    deriveProcessData();
+    const double r_e = processData.bottomWidth / processData.startWidth;
 
-    auto dist = viennals::SmartPointer<ViaDistribution<T, D>>::New(processData);
+    if (verbose && resolutionTolerance > 0.) {
+      BoschGridResolution<T> resolution(processData);
+      resolution.setTolerance(resolutionTolerance);
+      resolution.setTaperIncluded(false);
+      resolution.apply();
+      resolution.check(processData.gridDelta);
+    }
 
-    viennals::GeometricAdvect<T, D>(substrate, dist, mask).apply();
+    if (verbose) {
+      if (!cycleSchedule.empty())
+        std::cout << "N_c: " << processData.numCycles << " (scheduled)"
+                  << std::endl;
+      std::cout << "d_c: " << processData.depthPerCycle << std::endl;
+      std::cout << "N_t: " << processData.numTaperCycles << std::endl;
+      std::cout << "L_t: " << processData.taperStart << std::endl;
+      std::cout << "r_e: " << r_e << std::endl;
+      std::cout << "x:   " << processData.taperRatio << std::endl;
+      std::cout << "L_b: " << processData.trenchBottom << std::endl;
+    }
+
+    BoschProgressReporter progress(progressCallback,
+                                   viaStageWeight + scallopStageWeight);
+
+    std::uint64_t viaStageKey = 0, finalStageKey = 0;
+    if (cache != nullptr) {
+      viaStageKey = getViaStageKey();
+      finalStageKey = getFinalStageKey(viaStageKey);
+      memoryTracker.beginStage("cache");
+      if (cacheFinalStage && cache->load(finalStageKey, substrate)) {
+        memoryTracker.endStage(substrate, mask);
+        if (verbose)
+          std::cout << "Final substrate loaded from cache" << std::endl;
+        progress.endStage("cache", viaStageWeight + scallopStageWeight);
+        return;
+      }
+    }
+
+    // keep the last completed state to restore it on cancellation
+    LSPtrType backup = nullptr;
+    const bool isBackup = cancellation != nullptr && restoreOnCancel;
+    if (isBackup)
+      backup = LSPtrType::New(substrate);
+
+    progress.beginStage("via");
+    memoryTracker.beginStage("via");
+    const bool isViaCached =
+        cache != nullptr && cache->load(viaStageKey, substrate);
+    if (isViaCached) {
+      if (verbose)
+        std::cout << "Via substrate loaded from cache" << std::endl;
+    } else {
+      auto dist =
+          viennals::SmartPointer<ViaDistribution<T, D>>::New(processData);
+      dist->setCancellationToken(cancellation.get());
+      auto viaProgress =
+          makeStageProgress(progress, "via", viaStageWeight, *dist);
+      dist->setStageProgress(viaProgress.get());
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+      dist->setCounters(&viaCounters);
+#endif
+
+      viennals::GeometricAdvect<T, D>(substrate, dist, mask).apply();
+
+      if (checkCancelled(backup))
+        return;
+
+      if (cache != nullptr)
+        cache->store(viaStageKey, substrate);
+    }
+    memoryTracker.endStage(substrate, mask);
+    progress.endStage("via", viaStageWeight);
+
+    if (checkCancelled(nullptr))
+      return;
+    // the cache holds the via substrate, so it needs no second copy
+    std::uint64_t backupKey = 0;
+    if (isBackup && cache != nullptr && cache->isStoringEntries()) {
+      backup = nullptr;
+      backupKey = viaStageKey;
+    } else if (backup != nullptr) {
+      backup->deepCopy(substrate);
+    }
 
 #ifndef NDEBUG
     {
@@ -163,14 +669,30 @@ public:
 #endif
 
     // Now make scallops on the sidewalls
+    memoryTracker.beginStage("scallops");
     auto boschDist =
         viennals::SmartPointer<BoschDistribution<T, D>>::New(processData);
+    boschDist->setCancellationToken(cancellation.get());
+    auto scallopProgress = makeStageProgress(progress, "scallops",
+                                             scallopStageWeight, *boschDist);
+    boschDist->setStageProgress(scallopProgress.get());
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+    boschDist->setCounters(&scallopCounters);
+#endif
 
     // perform geometric advection
-    viennals::GeometricAdvect<T, D> fastAdvectKernel(substrate, boschDist,
-                                                     mask);
+    progress.beginStage("scallops");
+    viennals::GeometricAdvect<T, D>(substrate, boschDist, mask).apply();
 
-    fastAdvectKernel.apply();
+    if (checkCancelled(backup, backupKey))
+      return;
+
+    if (cache != nullptr && cacheFinalStage)
+      cache->store(finalStageKey, substrate);
+    memoryTracker.endStage(substrate, mask);
+    progress.endStage("scallops", scallopStageWeight);
+    if (!isViaCached)
+      updateStageWeights();
 
 #ifndef NDEBUG
     {
@@ -188,4 +710,6 @@ public:
     }
 #endif
   }
-};
\ No newline at end of file
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschProcess);
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include <lsDomain.hpp>
+#include <lsReader.hpp>
+#include <lsWriter.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// 64-bit FNV-1a hash used to build the content-addressed cache keys.
+class BoschHasher {
+  std::uint64_t hash = 14695981039346656037ull;
+  double resolution = 1e-9;
+
+public:
+  BoschHasher() {}
+
+  BoschHasher(std::uint64_t seed) { add(seed); }
+
+  /// Floating point values are rounded to multiples of this value before
+  /// hashing, so that round-off does not change the key.
+  void setResolution(double passedResolution) {
+    resolution = passedResolution;
+  }
+
+  void addBytes(const char *bytes, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+      hash ^= static_cast<unsigned char>(bytes[i]);
+      hash *= 1099511628211ull;
+    }
+  }
+
+  void add(std::uint64_t value) {
+    addBytes(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void add(double value) {
+    const double scaled = value / resolution;
+    if (std::abs(scaled) < 9e18) {
+      add(static_cast<std::uint64_t>(std::llround(scaled)));
+    } else {
+      // values such as std::numeric_limits<T>::max() used as markers
+      addBytes(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+  }
+
+  void add(const std::string &bytes) { addBytes(bytes.data(), bytes.size()); }
+
+  std::uint64_t getHash() const { return hash; }
+};
+
+/// Content-addressed store of intermediate and final substrates of
+/// BoschProcess. Entries are kept in memory and, if a cache directory is
+/// set, written to disk so they can be reused by later runs.
+template <class T, int D> class BoschProcessCache {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  std::unordered_map<std::uint64_t, LSPtrType> entries;
+  std::string cacheDirectory;
+  bool keepInMemory = true;
+  unsigned numHits = 0;
+  unsigned numMisses = 0;
+  std::mutex entriesMutex;
+
+  std::string getFileName(std::uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".lvst";
+    return (std::filesystem::path(cacheDirectory) / name.str()).string();
+  }
+
+  // name of the temporary file an entry is written to before it is
+  // renamed; unique, so that processes storing the same key concurrently
+  // never write to the same file
+  std::string getTemporaryFileName(std::uint64_t key) const {
+    std::random_device device;
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << "."
+         << std::setw(8) << device() << std::setw(8) << device()
+         << ".partial.lvst";
+    return (std::filesystem::path(cacheDirectory) / name.str()).string();
+  }
+
+public:
+  BoschProcessCache() {}
+
+  BoschProcessCache(std::string directory) { setCacheDirectory(directory); }
+
+  /// Directory in which cached level sets are stored. If it is empty,
+  /// entries are only kept in memory.
+  void setCacheDirectory(std::string directory) {
+    cacheDirectory = directory;
+    if (!cacheDirectory.empty())
+      std::filesystem::create_directories(cacheDirectory);
+  }
+
+  /// Whether to keep copies of all entries in memory. Defaults to true.
+  void setKeepInMemory(bool isKeepInMemory) { keepInMemory = isKeepInMemory; }
+
+  /// Whether stored entries can be loaded again, i.e. they are kept in
+  /// memory or written to the cache directory.
+  bool isStoringEntries() const {
+    return keepInMemory || !cacheDirectory.empty();
+  }
+
+  /// Hash of the level set, including its grid.
+  static std::uint64_t hashLevelSet(LSPtrType levelSet) {
+    std::ostringstream stream;
+    levelSet->serialize(stream);
+    BoschHasher hasher;
+    hasher.add(stream.str());
+    return hasher.getHash();
+  }
+
+  /// Copy the entry with this key into levelSet. Returns false if there
+  /// is no such entry.
+  bool load(std::uint64_t key, LSPtrType levelSet) {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      levelSet->deepCopy(it->second);
+      ++numHits;
+      return true;
+    }
+
+    if (!cacheDirectory.empty() && std::filesystem::exists(getFileName(key))) {
+      viennals::Reader<T, D>(levelSet, getFileName(key)).apply();
+      if (keepInMemory)
+        entries[key] = LSPtrType::New(levelSet);
+      ++numHits;
+      return true;
+    }
+
+    ++numMisses;
+    return false;
+  }
+
+  /// Store a copy of levelSet under this key.
+  void store(std::uint64_t key, LSPtrType levelSet) {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    if (keepInMemory)
+      entries[key] = LSPtrType::New(levelSet);
+    if (!cacheDirectory.empty()) {
+      // write to a temporary file first, so that other processes sharing
+      // the directory never read partially written entries
+      const std::string fileName = getFileName(key);
+      const std::string tmpFileName = getTemporaryFileName(key);
+      viennals::Writer<T, D>(levelSet, tmpFileName).apply();
+      std::filesystem::rename(tmpFileName, fileName);
+    }
+  }
+
+  /// Remove all entries kept in memory.
+  void clear() {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    entries.clear();
+  }
+
+  unsigned getNumberOfHits() const { return numHits; }
+
+  unsigned getNumberOfMisses() const { return numMisses; }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(BoschProcessCache);
@@ -2,24 +2,44 @@
 
 #include <array>
 #include <limits>
+#include <vector>
+
+/// Parameters of a single cycle of a scheduled (ramped) recipe.
+template <class T> struct BoschCycleParameters {
+  T isoRate = 0;
+  double depthPerCycle = 0;
+  double lateralRatio = 0.0;
+};
 
 template <class T> struct BoschProcessDataType {
-  unsigned numCycles;
-  T isoRate;
-  T startWidth;
-  T bottomWidth;
+  unsigned numCycles = 0;
+  T isoRate = 0;
+  T startWidth = 0;
+  T bottomWidth = 0;
   T taperStart = std::numeric_limits<T>::max();
   T topOffset = 0;
   std::array<T, 3> maskOrigin = {};
   bool sidewallTapering = true;
+  // the opening is a line trench along y instead of a hole
+  bool isLineTrench = false;
   bool scallopDecrease = true;
   double depthPerCycle = 0;
   unsigned numTaperCycles = 0;
   double taperRatio = 0.;
   double trenchBottom = 0.;
+  // bottom of the last etched cycle; differs from trenchBottom only if
+  // the process stops before the last cycle of the recipe
+  double etchBottom = 0.;
   double gridDelta = 0.;
   unsigned sausageCycle = 0;
   double sausageEtchRate = 0.;
   bool isWallTapering = true;
   double lateralRatio = 0.0;
-};
\ No newline at end of file
+
+  // per-cycle schedule, empty if the recipe is constant
+  std::vector<BoschCycleParameters<T>> cycles;
+  // z of the top of each scheduled cycle
+  std::vector<double> cycleTop;
+  // index of the nearest cycle centre for each gridDelta/2 bin in |z|
+  std::vector<unsigned> cycleLookup;
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <omp.h>
+
+/// Cooperative cancellation flag shared between the caller and
+/// BoschProcess. It is checked between stages and for every candidate
+/// point tested by the distributions, so cancelling stops a running
+/// advection within a short time.
+class BoschCancellationToken {
+  std::atomic<bool> cancelled{false};
+
+public:
+  void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+  void reset() { cancelled.store(false, std::memory_order_relaxed); }
+
+  bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
+
+/// Called with the name of the current stage, the fraction of the whole
+/// process which is done and the estimated remaining time in seconds
+/// (negative if there is no estimate yet).
+using BoschProgressCallback =
+    std::function<void(const std::string &, double, double)>;
+
+/// BoschProgressCallback which prints the progress to stdout.
+inline void printBoschProgress(const std::string &stage, double fraction,
+                               double eta) {
+  std::cout << "Stage " << stage << ": " << int(100 * fraction) << "% done";
+  if (eta >= 0.)
+    std::cout << ", about " << int(eta) << " s remaining";
+  std::cout << std::endl;
+}
+
+/// Keeps track of the elapsed time and reports the progress of weighted
+/// stages to a BoschProgressCallback.
+class BoschProgressReporter {
+  BoschProgressCallback callback;
+  std::chrono::steady_clock::time_point start;
+  double doneWeight = 0.;
+  double totalWeight = 1.;
+
+public:
+  BoschProgressReporter(BoschProgressCallback passedCallback,
+                        double passedTotalWeight)
+      : callback(passedCallback), start(std::chrono::steady_clock::now()),
+        totalWeight(passedTotalWeight) {}
+
+  /// Report that a stage starts.
+  void beginStage(const std::string &stage) { report(stage); }
+
+  /// Report that a stage with the given weight has finished.
+  void endStage(const std::string &stage, double weight) {
+    doneWeight += weight;
+    report(stage);
+  }
+
+  /// Report that the given fraction of a running stage with the given
+  /// weight is done.
+  void reportWithin(const std::string &stage, double weight,
+                    double stageFraction) const {
+    report(stage, weight * std::min(std::max(stageFraction, 0.), 1.));
+  }
+
+  void report(const std::string &stage, double runningWeight = 0.) const {
+    if (!callback)
+      return;
+    const double fraction =
+        std::min((doneWeight + runningWeight) / totalWeight, 1.0);
+    const double elapsed = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    const double eta =
+        (fraction > 0.) ? elapsed * (1. - fraction) / fraction : -1.;
+    callback(stage, fraction, eta);
+  }
+};
+
+/// Progress within a geometric advection, recorded by the distributions
+/// for every candidate point. GeometricAdvect splits the advected region
+/// between its threads along z and each thread works through its part
+/// row by row, so the rows passed by all threads out of the rows of the
+/// region give the done fraction of the advection. It is passed to the
+/// callback at most once per interval, from the thread which has just
+/// started a new row.
+class BoschStageProgress {
+  // each thread writes to its own cache line
+  struct alignas(64) ThreadRows {
+    std::atomic<bool> isStarted{false};
+    std::atomic<long> first{0};
+    std::atomic<long> current{0};
+  };
+
+  std::function<void(double)> callback;
+  double gridDelta = 1.;
+  long numRows = 1;
+  unsigned numThreads = 0;
+  std::unique_ptr<ThreadRows[]> threads;
+  std::chrono::steady_clock::time_point start;
+  std::int64_t interval = 0;
+  std::atomic<std::int64_t> nextReport{0};
+  std::mutex reportMutex;
+  double lastFraction = 0.;
+
+  void report(std::int64_t now) {
+    std::unique_lock<std::mutex> lock(reportMutex, std::try_to_lock);
+    if (!lock.owns_lock() ||
+        now < nextReport.load(std::memory_order_relaxed))
+      return;
+    nextReport.store(now + interval, std::memory_order_relaxed);
+
+    long passedRows = 0;
+    for (unsigned i = 0; i < numThreads; ++i) {
+      const auto &rows = threads[i];
+      if (rows.isStarted.load(std::memory_order_acquire))
+        passedRows += std::abs(rows.current.load(std::memory_order_relaxed) -
+                               rows.first.load(std::memory_order_relaxed));
+    }
+    // rows of threads beyond numThreads are missing, so never go back
+    lastFraction =
+        std::max(lastFraction, std::min(double(passedRows) / numRows, 1.));
+    callback(lastFraction);
+  }
+
+public:
+  /// The callback is called with the done fraction of the advection of
+  /// the region between minZ and maxZ, at most once per interval seconds.
+  BoschStageProgress(std::function<void(double)> passedCallback,
+                     double passedGridDelta, double minZ, double maxZ,
+                     double intervalSeconds = 1.)
+      : callback(passedCallback), gridDelta(passedGridDelta),
+        numRows(std::max(std::lround((maxZ - minZ) / passedGridDelta), 1l)),
+        numThreads(omp_get_max_threads()),
+        threads(new ThreadRows[numThreads]),
+        start(std::chrono::steady_clock::now()),
+        interval(std::int64_t(intervalSeconds * 1e9)), nextReport(interval) {}
+
+  /// Record a candidate point with the given z coordinate, tested by the
+  /// calling thread.
+  void recordCandidate(double z) {
+    const unsigned thread = omp_get_thread_num();
+    if (thread >= numThreads)
+      return;
+    auto &rows = threads[thread];
+    const long row = std::lround(z / gridDelta);
+    if (rows.isStarted.load(std::memory_order_relaxed) &&
+        rows.current.load(std::memory_order_relaxed) == row)
+      return;
+    rows.current.store(row, std::memory_order_relaxed);
+    if (!rows.isStarted.load(std::memory_order_relaxed)) {
+      rows.first.store(row, std::memory_order_relaxed);
+      rows.isStarted.store(true, std::memory_order_release);
+    }
+
+    const std::int64_t now =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    if (now >= nextReport.load(std::memory_order_relaxed))
+      report(now);
+  }
+};
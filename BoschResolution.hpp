@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <vcLogger.hpp>
+
+#include "BoschProcessData.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Derives the coarsest grid delta which still resolves the scallops of a
+/// recipe. A scallop is the lens etched by BoschDistribution: a sphere of
+/// the isotropic rate r whose centre lies lateralRatio * r behind the
+/// via sidewall, repeated every cycle etch depth d. Its height is the
+/// lateral distance between the deepest point of the scallop and the
+/// cusp to the next one. The grid delta is at most tolerance times the
+/// smallest scallop height and period, and at most half the smallest
+/// radius, since BoschDistribution replaces radii below one grid delta by
+/// a box. For constant recipes it is rounded down so that the cycle etch
+/// depth is a multiple of it, so that every scallop is sampled in the
+/// same way.
+///
+/// The cycles of a taper are only included if the process data was
+/// derived (see BoschProcess::deriveProcessData), since the taper law
+/// depends on the grid delta, and if setTaperIncluded is not disabled.
+template <class T> class BoschGridResolution {
+public:
+  /// Default tolerance of the grid resolution: five grid cells per
+  /// scallop height and period.
+  static constexpr double defaultTolerance = 0.2;
+
+private:
+  const BoschProcessDataType<T> &data;
+  std::vector<BoschCycleParameters<T>> recipe;
+  double tolerance = defaultTolerance;
+  bool isTaperIncluded = true;
+
+  double gridDelta = 0.;
+  double scallopHeight = 0.;
+  double scallopPeriod = 0.;
+  double radius = 0.;
+
+  // lateral ratio as stored in the process data, i.e. 1 - ratioLateral
+  static double getScallopHeight(double rate, double period,
+                                 double lateralRatio) {
+    const double reach = rate * (1. - lateralRatio);
+    if (reach <= 0.)
+      return 0.;
+    if (period >= 2 * rate)
+      return reach;
+    const double cusp =
+        std::sqrt(rate * rate - period * period / 4.) - lateralRatio * rate;
+    return reach - std::max(cusp, 0.);
+  }
+
+  void addScallop(double rate, double period, double lateralRatio) {
+    rate = std::abs(rate);
+    period = std::abs(period);
+    if (rate == 0.)
+      return;
+    radius = std::min(radius, rate);
+    if (period > 0.) {
+      scallopPeriod = std::min(scallopPeriod, period);
+      const double height = getScallopHeight(rate, period, lateralRatio);
+      if (height > 0.)
+        scallopHeight = std::min(scallopHeight, height);
+    }
+  }
+
+public:
+  /// The recipe schedule of the process (BoschProcess::getRecipe()); if
+  /// it is empty, the scheduled cycles of the process data are used.
+  BoschGridResolution(
+      const BoschProcessDataType<T> &processData,
+      const std::vector<BoschCycleParameters<T>> &passedRecipe = {})
+      : data(processData), recipe(passedRecipe) {
+    if (recipe.empty())
+      recipe = data.cycles;
+  }
+
+  /// Largest grid delta relative to the scallop height and period.
+  /// Defaults to defaultTolerance.
+  void setTolerance(double passedTolerance) { tolerance = passedTolerance; }
+
+  /// Whether the shrinking cycles of a derived taper are resolved as well.
+  /// Defaults to true.
+  void setTaperIncluded(bool isIncluded) { isTaperIncluded = isIncluded; }
+
+  /// Coarsest grid delta found by the last call to apply().
+  double getGridDelta() const { return gridDelta; }
+
+  /// Smallest scallop height of the recipe, or the largest double if no
+  /// cycle etches laterally.
+  double getScallopHeight() const { return scallopHeight; }
+
+  /// Smallest cycle etch depth of the recipe.
+  double getScallopPeriod() const { return scallopPeriod; }
+
+  /// Smallest isotropic rate of the recipe.
+  double getRadius() const { return radius; }
+
+  void apply() {
+    scallopHeight = std::numeric_limits<double>::max();
+    scallopPeriod = std::numeric_limits<double>::max();
+    radius = std::numeric_limits<double>::max();
+
+    if (recipe.empty()) {
+      addScallop(data.isoRate, data.depthPerCycle, data.lateralRatio);
+      // the radius shrinks to bottomWidth / startWidth at the bottom of a
+      // taper and the cycles get shorter by a constant factor
+      if (isTaperIncluded && data.numTaperCycles > 0 &&
+          data.startWidth > 0) {
+        const double factor = (1 - data.taperRatio) / (1 + data.taperRatio);
+        addScallop(data.isoRate * data.bottomWidth / data.startWidth,
+                   data.depthPerCycle / (1 + data.taperRatio) *
+                       std::pow(factor, data.numTaperCycles - 1),
+                   data.lateralRatio);
+      }
+    } else {
+      for (auto &cycle : recipe)
+        addScallop(cycle.isoRate, cycle.depthPerCycle, cycle.lateralRatio);
+    }
+    // a sausage cycle bulges out of the sidewall on its own
+    if (data.sausageCycle > 0) {
+      const double lateralRatio =
+          recipe.empty() ? data.lateralRatio : recipe.front().lateralRatio;
+      addScallop(data.sausageEtchRate, 0., lateralRatio);
+      const double height =
+          std::abs(data.sausageEtchRate) * (1. - lateralRatio);
+      if (height > 0.)
+        scallopHeight = std::min(scallopHeight, height);
+    }
+
+    gridDelta = std::numeric_limits<double>::max();
+    if (scallopHeight < std::numeric_limits<double>::max())
+      gridDelta = std::min(gridDelta, tolerance * scallopHeight);
+    if (scallopPeriod < std::numeric_limits<double>::max())
+      gridDelta = std::min(gridDelta, tolerance * scallopPeriod);
+    if (radius < std::numeric_limits<double>::max())
+      gridDelta = std::min(gridDelta, radius / 2.);
+    if (gridDelta == std::numeric_limits<double>::max()) {
+      viennacore::Logger::getInstance().addError(
+          "BoschGridResolution: Recipe has no isotropic etch!");
+      gridDelta = 0.;
+      return;
+    }
+
+    const double period = std::abs(data.depthPerCycle);
+    if (recipe.empty() && period > 0.)
+      gridDelta = period / std::ceil(period / gridDelta - 1e-9);
+  }
+
+  /// Whether the grid delta resolves the scallops found by apply() to the
+  /// tolerance. Prints a warning naming the unresolved features if not.
+  bool check(double passedGridDelta) const {
+    std::ostringstream message;
+    if (scallopHeight < std::numeric_limits<double>::max() &&
+        passedGridDelta > tolerance * scallopHeight)
+      message << " scallop height " << scallopHeight << " ("
+              << scallopHeight / passedGridDelta << " cells)";
+    if (scallopPeriod < std::numeric_limits<double>::max() &&
+        passedGridDelta > tolerance * scallopPeriod)
+      message << " scallop period " << scallopPeriod << " ("
+              << scallopPeriod / passedGridDelta << " cells)";
+    if (radius < std::numeric_limits<double>::max() &&
+        passedGridDelta > radius / 2.)
+      message << " isotropic rate " << radius << " ("
+              << radius / passedGridDelta << " cells)";
+    if (message.str().empty())
+      return true;
+    viennacore::Logger::getInstance()
+        .addWarning("BoschGridResolution: Grid delta " +
+                    std::to_string(passedGridDelta) + " does not resolve" +
+                    message.str() + "; use at most " +
+                    std::to_string(gridDelta) + ".")
+        .print();
+    return false;
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(BoschGridResolution);
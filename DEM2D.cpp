@@ -11,73 +11,93 @@
 #include <lsVTKWriter.hpp>
 #include <lsWriteVisualizationMesh.hpp>
 
+#include "BoschFrames.hpp"
 #include "BoschProcess.hpp"
+#include "FitDomainBounds.hpp"
 #include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
 
 using namespace viennals;
 
 int main() {
   omp_set_num_threads(1);
 
+  // one stage runs at a time, so the peak memory of each is measured
+  BoschMemoryTracker::setResetPeakResident(true);
+
   constexpr int D = 2;
   typedef double NumericType;
-  double gridDelta = 0.05; // 0.125;
-
-  double extent = 4;
-  double bounds[2 * D] = {-extent, extent, -extent, extent};
-  if constexpr (D == 3) {
-    bounds[4] = -extent;
-    bounds[5] = extent;
-  }
-
-  BoundaryConditionEnum boundaryCons[D];
-  for (unsigned i = 0; i < D - 1; ++i) {
-    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
-  }
-  boundaryCons[D - 1] = BoundaryConditionEnum::INFINITE_BOUNDARY;
-
-  auto mask = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
-                                                        gridDelta);
-
-  auto levelSet = SmartPointer<Domain<NumericType, D>>::New(
-      bounds, boundaryCons, gridDelta);
+  double extent = DEM2DRecipe::extent;
 
   std::array<NumericType, 3> maskOrigin = {};
-  NumericType maskRadius = 0.6;
+  NumericType maskRadius = DEM2DRecipe::maskRadius;
+
+  BoschProcess<NumericType, D> processKernel;
+  DEM2DRecipe::apply(processKernel);
+
+  // coarsest grid which resolves the scallops of the recipe
+  double gridDelta = DEM2DRecipe::getGridDelta<NumericType, D>();
+  std::cout << "Grid delta: " << gridDelta << std::endl;
+
+  // with fitDomain, only the lateral region which is reached by the etch
+  // is simulated instead of the whole extent. The structure is symmetric
+  // about the mask origin, so with mirrorSymmetric only the half (2D) or
+  // quarter (3D) domain is simulated and mirrored for output. Both are off
+  // until GoldenGeometry shows that the fitted and mirrored modes
+  // reproduce the full domain.
+  bool fitDomain = false;
+  bool mirrorSymmetric = false;
+  FitDomainBounds<NumericType, D> domainFit(
+      gridDelta, maskRadius, processKernel.getMaximumLateralReach());
+  domainFit.setMaskOrigin(maskOrigin);
+  domainFit.setFitted(fitDomain);
+  domainFit.setLateralExtent(extent);
+  domainFit.setMirrorSymmetric(mirrorSymmetric);
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
 
   MakeMask<NumericType, D> maskCreator(levelSet, mask);
   maskCreator.setMaskOrigin(maskOrigin);
   maskCreator.setMaskRadius(maskRadius);
   maskCreator.apply();
+  BoschMemoryTracker::print(maskCreator.getStageStatistics());
+
+  auto fullMask = domainFit.makeFullLevelSet(mask);
+  auto fullLevelSet = domainFit.makeFullLevelSet(levelSet);
 
   std::cout << "Output initial" << std::endl;
   auto mesh = SmartPointer<Mesh<NumericType>>::New();
 
   //   lsToMesh<NumericType, D>(levelSet, mesh).apply();
   //   lsVTKWriter(mesh, "Surface_i_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullLevelSet, mesh).apply();
   VTKWriter(mesh, "Surface_i.vtp").apply();
   //   lsToMesh<NumericType, D>(mask, mesh).apply();
   //   lsVTKWriter(mesh, "Surface_m_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullMask, mesh).apply();
   VTKWriter(mesh, "Surface_m.vtp").apply();
 
-  NumericType bottomFraction = 0.3;
-  NumericType etchRate = -0.98;
+  processKernel.setSubstrate(levelSet);
+  processKernel.setMask(mask);
 
-  BoschProcess<NumericType, D> processKernel(levelSet, mask);
-  processKernel.setNumCycles(50);
-  processKernel.setIsotropicRate(etchRate * 0.6);
-  processKernel.setCycleEtchDepth(etchRate);
-  processKernel.setStartWidth(2 * maskRadius);
-  processKernel.setBottomWidth(2 * maskRadius * bottomFraction);
-  processKernel.setStartOfTapering(0);
-  processKernel.setSidewallTapering(false);
-  processKernel.setTapering(false);
-  processKernel.setLateralEtchRatio(0.75);
+  // write the substrate after every frameInterval-th cycle to frames.drf,
+  // see ExtractFrames; 0 only computes the final state. Every frame reruns
+  // the process up to its cycle, so 50 / frameInterval frames cost up to
+  // as many full runs; BoschCycleFrames rejects more than 20 frames.
+  unsigned frameInterval = 0;
 
   auto start = std::chrono::high_resolution_clock::now();
-  processKernel.apply();
+  if (frameInterval > 0) {
+    BoschCycleFrames<NumericType, D> frames(processKernel);
+    frames.setFrameInterval(frameInterval);
+    frames.setFileName("frames.drf");
+    frames.apply();
+  } else {
+    processKernel.apply();
+  }
   auto stop = std::chrono::high_resolution_clock::now();
   std::cout << "Geometric advect took: "
             << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
@@ -86,9 +106,16 @@ int main() {
             << " ms" << std::endl;
   std::cout << "Final structure has " << levelSet->getNumberOfPoints()
             << " LS points" << std::endl;
+  BoschMemoryTracker::print(processKernel.getStageStatistics());
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  processKernel.getViaCounters().print("ViaDistribution");
+  processKernel.getScallopCounters().print("BoschDistribution");
+#endif
+
+  fullLevelSet = domainFit.makeFullLevelSet(levelSet);
 
   // levelSet->print();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullLevelSet, mesh).apply();
   VTKWriter(mesh, "surface.vtp").apply();
   // lsToMesh<NumericType, D>(levelSet, mesh).apply();
   // lsVTKWriter(mesh, "points-1.vtp").apply();
@@ -100,8 +127,8 @@ int main() {
 
   auto volumeMeshing =
       SmartPointer<WriteVisualizationMesh<NumericType, D>>::New();
-  volumeMeshing->insertNextLevelSet(mask);
-  volumeMeshing->insertNextLevelSet(levelSet);
+  volumeMeshing->insertNextLevelSet(fullMask);
+  volumeMeshing->insertNextLevelSet(fullLevelSet);
   volumeMeshing->setFileName("bosch");
   volumeMeshing->apply();
 
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+
+#include "BoschEnsemble.hpp"
+#include "FitDomainBounds.hpp"
+#include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
+
+using namespace viennals;
+
+// DEM2D with random cycle-to-cycle variation of the recipe. Only the
+// statistics of the realizations are kept and written to ensemble.csv.
+int main() {
+  omp_set_num_threads(16);
+
+  constexpr int D = 2;
+  typedef double NumericType;
+  double gridDelta = DEM2DRecipe::getGridDelta<NumericType, D>();
+
+  double extent = DEM2DRecipe::extent;
+
+  std::array<NumericType, 3> maskOrigin = {};
+  NumericType maskRadius = DEM2DRecipe::maskRadius;
+
+  auto recipe = DEM2DRecipe::apply<NumericType, D>;
+
+  // the CD is measured across the whole opening, so the domain is not
+  // reduced to its mirror symmetric half; it is not fitted to the etched
+  // region either, like in DEM2D
+  BoschProcess<NumericType, D> nominal;
+  recipe(nominal);
+  FitDomainBounds<NumericType, D> domainFit(gridDelta, maskRadius,
+                                            nominal.getMaximumLateralReach());
+  domainFit.setMaskOrigin(maskOrigin);
+  domainFit.setFitted(false);
+  domainFit.setLateralExtent(extent);
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
+
+  MakeMask<NumericType, D> maskCreator(levelSet, mask);
+  maskCreator.setMaskOrigin(maskOrigin);
+  maskCreator.setMaskRadius(maskRadius);
+  maskCreator.apply();
+
+  BoschEnsemble<NumericType, D> ensemble(levelSet, mask);
+  ensemble.setRecipe(recipe);
+  ensemble.setNumberOfRealizations(200);
+  ensemble.setSeed(42);
+  ensemble.setIsotropicRateVariation(0.05);
+  ensemble.setCycleEtchDepthVariation(0.03);
+  ensemble.setLateralEtchRatioVariation(0.05);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  ensemble.apply();
+  auto stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Ensemble took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+
+  std::ofstream csv("ensemble.csv");
+  ensemble.print(csv);
+  const auto &depths = ensemble.getDepthStatistics();
+  std::cout << "Etch depth: " << depths.getMean() << " +- "
+            << depths.getStandardDeviation() << std::endl;
+  const auto &scallops = ensemble.getScallopHeightStatistics();
+  std::cout << "Scallop height: " << scallops.getMean() << " +- "
+            << scallops.getStandardDeviation() << std::endl;
+
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, D>(ensemble.getNominalSubstrate(), mesh).apply();
+  VTKWriter(mesh, "surface_nominal.vtp").apply();
+
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include <chrono>
 #include <iostream>
+#include <string>
 
 #include <lsBooleanOperation.hpp>
 #include <lsExpand.hpp>
@@ -12,67 +13,84 @@
 #include <lsWriteVisualizationMesh.hpp>
 
 #include "BoschProcess.hpp"
+#include "DecimateSurfaceMesh.hpp"
+#include "FitDomainBounds.hpp"
 #include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
+#include "SliceLevelSet.hpp"
 
 using namespace viennals;
 
-int main() {
-  omp_set_num_threads(16);
+// Pass "lod" as argument to also write decimated levels of detail of the
+// final surface to surface_lod1.vtp to surface_lod3.vtp. An optional
+// second argument bounds the distance of every vertex of the surface to
+// the decimated ones, in grid cells (default 0.5).
 
-  constexpr int D = 3;
-  typedef double NumericType;
-  double gridDelta = 0.125;
+int main(int argc, char **argv) {
+  const bool isLevelsOfDetail = argc > 1 && std::string(argv[1]) == "lod";
+  const double lodMaxDeviation = (argc > 2) ? std::stod(argv[2]) : 0.5;
 
-  double extent = 12;
-  double bounds[2 * D] = {-extent, extent, -extent, extent};
-  if constexpr (D == 3) {
-    bounds[4] = -extent;
-    bounds[5] = extent;
-  }
+  omp_set_num_threads(16);
 
-  BoundaryConditionEnum boundaryCons[D];
-  for (unsigned i = 0; i < D - 1; ++i) {
-    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
-  }
-  boundaryCons[D - 1] = BoundaryConditionEnum::INFINITE_BOUNDARY;
+  // one stage runs at a time, so the peak memory of each is measured
+  BoschMemoryTracker::setResetPeakResident(true);
 
-  auto mask = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
-                                                        gridDelta);
+  constexpr int D = 3;
+  typedef double NumericType;
+  double gridDelta = DEM3DRecipe::gridDelta;
 
-  auto levelSet = SmartPointer<Domain<NumericType, D>>::New(
-      bounds, boundaryCons, gridDelta);
+  double extent = DEM3DRecipe::extent;
 
   std::array<NumericType, 3> maskOrigin = {};
-  NumericType maskRadius = extent / 2.0;
+  NumericType maskRadius = DEM3DRecipe::maskRadius;
+
+  BoschProcess<NumericType, D> processKernel;
+  DEM3DRecipe::apply(processKernel);
+
+  // with fitDomain, only the lateral region which is reached by the etch
+  // is simulated instead of the whole extent. The structure is symmetric
+  // about the mask origin, so with mirrorSymmetric only the half (2D) or
+  // quarter (3D) domain is simulated and mirrored for output. Both are off
+  // until GoldenGeometry shows that the fitted and mirrored modes
+  // reproduce the full domain.
+  bool fitDomain = false;
+  bool mirrorSymmetric = false;
+  FitDomainBounds<NumericType, D> domainFit(
+      gridDelta, maskRadius, processKernel.getMaximumLateralReach());
+  domainFit.setMaskOrigin(maskOrigin);
+  domainFit.setFitted(fitDomain);
+  domainFit.setLateralExtent(extent);
+  domainFit.setMirrorSymmetric(mirrorSymmetric);
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
 
   MakeMask<NumericType, D> maskCreator(levelSet, mask);
   maskCreator.setMaskOrigin(maskOrigin);
   maskCreator.setMaskRadius(maskRadius);
   maskCreator.apply();
+  BoschMemoryTracker::print(maskCreator.getStageStatistics());
+
+  auto fullMask = domainFit.makeFullLevelSet(mask);
+  auto fullLevelSet = domainFit.makeFullLevelSet(levelSet);
 
   std::cout << "Output initial" << std::endl;
   auto mesh = SmartPointer<Mesh<NumericType>>::New();
 
   //   ToMesh<NumericType, D>(levelSet, mesh).apply();
   //   VTKWriter(mesh, "Surface_i_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullLevelSet, mesh).apply();
   VTKWriter(mesh, "Surface_i.vtp").apply();
   //   ToMesh<NumericType, D>(mask, mesh).apply();
   //   VTKWriter(mesh, "Surface_m_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullMask, mesh).apply();
   VTKWriter(mesh, "Surface_m.vtp").apply();
 
-  NumericType bottomFraction = 0.7;
-  NumericType etchRate = -1.86;
-
-  BoschProcess<NumericType, D> processKernel(levelSet, mask);
-  processKernel.setNumCycles(19);
-  processKernel.setIsotropicRate(etchRate * 1.15);
-  processKernel.setCycleEtchDepth(etchRate);
-  processKernel.setStartWidth(2 * maskRadius);
-  processKernel.setBottomWidth(2 * maskRadius * bottomFraction);
-  processKernel.setStartOfTapering(-10);
-  processKernel.setLateralEtchRatio(0.5);
+  processKernel.setSubstrate(levelSet);
+  processKernel.setMask(mask);
+  processKernel.setProgressCallback(printBoschProgress);
 
   auto start = std::chrono::high_resolution_clock::now();
   processKernel.apply();
@@ -84,19 +102,57 @@ int main() {
             << " ms" << std::endl;
   std::cout << "Final structure has " << levelSet->getNumberOfPoints()
             << " LS points" << std::endl;
+  BoschMemoryTracker::print(processKernel.getStageStatistics());
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  processKernel.getViaCounters().print("ViaDistribution");
+  processKernel.getScallopCounters().print("BoschDistribution");
+#endif
+
+  fullLevelSet = domainFit.makeFullLevelSet(levelSet);
 
   // levelSet->print();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullLevelSet, mesh).apply();
   VTKWriter(mesh, "surface.vtp").apply();
+
+  // decimated levels of detail, with the tolerance and the maximum
+  // deviation relative to the grid
+  if (isLevelsOfDetail) {
+    std::vector<NumericType> lodTolerances = {0.05, 0.2, 0.5};
+    for (unsigned i = 0; i < lodTolerances.size(); ++i) {
+      auto lodMesh = SmartPointer<Mesh<NumericType>>::New();
+      DecimateSurfaceMesh<NumericType> decimate(mesh, lodMesh,
+                                                lodTolerances[i] * gridDelta);
+      decimate.setMaximumDeviation(lodMaxDeviation * gridDelta);
+      decimate.apply();
+      VTKWriter(lodMesh, "surface_lod" + std::to_string(i + 1) + ".vtp")
+          .apply();
+    }
+  }
   // ToMesh<NumericType, D>(levelSet, mesh).apply();
   // VTKWriter(mesh, "points-1.vtp").apply();
 
+  // vertical profiles through the centre of the via, along x and along the
+  // diagonal, straight from the level set
+  std::array<std::array<NumericType, 2>, 2> sectionDirections = {
+      {{1., 0.}, {1., 1.}}};
+  std::array<std::string, 2> sectionNames = {"section_x.vtp",
+                                             "section_xy.vtp"};
+  for (unsigned i = 0; i < sectionDirections.size(); ++i) {
+    auto sectionMesh = SmartPointer<Mesh<NumericType>>::New();
+    SliceLevelSet<NumericType> section(fullLevelSet);
+    section.setPlaneOrigin(maskOrigin);
+    section.setPlaneDirection(sectionDirections[i]);
+    section.setContour(sectionMesh);
+    section.apply();
+    VTKWriter(sectionMesh, sectionNames[i]).apply();
+  }
+
   std::cout << "Making volume output...(this may take a while)" << std::endl;
 
   auto volumeMeshing =
       SmartPointer<WriteVisualizationMesh<NumericType, D>>::New();
-  volumeMeshing->insertNextLevelSet(mask);
-  volumeMeshing->insertNextLevelSet(levelSet);
+  volumeMeshing->insertNextLevelSet(fullMask);
+  volumeMeshing->insertNextLevelSet(fullLevelSet);
   volumeMeshing->setFileName("bosch");
   volumeMeshing->apply();
 
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <lsBooleanOperation.hpp>
+#include <lsExpand.hpp>
+#include <lsGeometricAdvect.hpp>
+#include <lsMakeGeometry.hpp>
+#include <lsToDiskMesh.hpp>
+#include <lsToMesh.hpp>
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+#include <lsWriteVisualizationMesh.hpp>
+
+#include "BoschProcess.hpp"
+#include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
+#include "RevolveLevelSet.hpp"
+
+using namespace viennals;
+
+// Same via as DEM3D, but simulated in 2D (r, z) and revolved into 3D.
+int main() {
+  omp_set_num_threads(16);
+
+  typedef double NumericType;
+  double gridDelta = DEM3DRecipe::gridDelta;
+
+  double extent = DEM3DRecipe::extent;
+  double bounds[2 * 3] = {-extent, extent, -extent, extent, -extent, extent};
+
+  // the profile has to reach the corners of the 3D domain
+  double profileExtent = std::ceil(extent * std::sqrt(2.) / gridDelta + 2) *
+                         gridDelta;
+  double profileBounds[2 * 2] = {-profileExtent, profileExtent, -extent,
+                                 extent};
+
+  BoundaryConditionEnum boundaryCons[3];
+  for (unsigned i = 0; i < 2; ++i) {
+    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+  }
+  boundaryCons[2] = BoundaryConditionEnum::INFINITE_BOUNDARY;
+  BoundaryConditionEnum profileBoundaryCons[2] = {
+      BoundaryConditionEnum::REFLECTIVE_BOUNDARY,
+      BoundaryConditionEnum::INFINITE_BOUNDARY};
+
+  auto profileMask = SmartPointer<Domain<NumericType, 2>>::New(
+      profileBounds, profileBoundaryCons, gridDelta);
+
+  auto profile = SmartPointer<Domain<NumericType, 2>>::New(
+      profileBounds, profileBoundaryCons, gridDelta);
+
+  std::array<NumericType, 3> maskOrigin = {};
+  NumericType maskRadius = DEM3DRecipe::maskRadius;
+
+  MakeMask<NumericType, 2> maskCreator(profile, profileMask);
+  maskCreator.setMaskOrigin(maskOrigin);
+  maskCreator.setMaskRadius(maskRadius);
+  maskCreator.apply();
+
+  BoschProcess<NumericType, 2> processKernel(profile, profileMask);
+  DEM3DRecipe::apply(processKernel);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  processKernel.apply();
+  auto stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Geometric advect took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "Final profile has " << profile->getNumberOfPoints()
+            << " LS points" << std::endl;
+
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, 2>(profile, mesh).apply();
+  VTKWriter(mesh, "profile.vtp").apply();
+
+  // revolve the profile into 3D for output only
+  auto mask = SmartPointer<Domain<NumericType, 3>>::New(bounds, boundaryCons,
+                                                        gridDelta);
+  auto levelSet =
+      SmartPointer<Domain<NumericType, 3>>::New(bounds, boundaryCons, gridDelta);
+
+  start = std::chrono::high_resolution_clock::now();
+  RevolveLevelSet<NumericType>(profileMask, mask).apply();
+  RevolveLevelSet<NumericType>(profile, levelSet).apply();
+  stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Revolving took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "Final structure has " << levelSet->getNumberOfPoints()
+            << " LS points" << std::endl;
+
+  ToSurfaceMesh<NumericType, 3>(levelSet, mesh).apply();
+  VTKWriter(mesh, "surface.vtp").apply();
+
+  std::cout << "Making volume output...(this may take a while)" << std::endl;
+
+  auto volumeMeshing =
+      SmartPointer<WriteVisualizationMesh<NumericType, 3>>::New();
+  volumeMeshing->insertNextLevelSet(mask);
+  volumeMeshing->insertNextLevelSet(levelSet);
+  volumeMeshing->setFileName("bosch");
+  volumeMeshing->apply();
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+#include <lsWriteVisualizationMesh.hpp>
+
+#include "BoschProcess.hpp"
+#include "ExtrudeLevelSet.hpp"
+#include "FitDomainBounds.hpp"
+#include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
+
+using namespace viennals;
+
+// Line trench with the recipe of DEM2D, simulated on its cross-section in
+// 2D and extruded along y:
+//
+//   DEM3DLine [length] [volume]
+//
+// The extruded surface of the given length (default 4) is written to
+// surface.vtp. Only with "volume" are the level sets extruded to 3D and
+// the volume mesh written.
+
+typedef double NumericType;
+
+int main(int argc, char **argv) {
+  omp_set_num_threads(1);
+
+  // one stage runs at a time, so the peak memory of each is measured
+  BoschMemoryTracker::setResetPeakResident(true);
+
+  const NumericType length = (argc > 1) ? std::stod(argv[1]) : 4.;
+  const bool isVolume = argc > 2 && std::string(argv[2]) == "volume";
+
+  double extent = DEM2DRecipe::extent;
+
+  std::array<NumericType, 3> maskOrigin = {};
+  NumericType maskRadius = DEM2DRecipe::maskRadius;
+
+  BoschProcess<NumericType, 2> processKernel;
+  DEM2DRecipe::apply(processKernel);
+
+  double gridDelta = DEM2DRecipe::getGridDelta<NumericType, 2>();
+  std::cout << "Grid delta: " << gridDelta << std::endl;
+
+  // with fitDomain, only the lateral region which is reached by the etch
+  // is simulated; the cross-section is symmetric about the trench centre,
+  // so with mirrorSymmetric only its half is simulated
+  bool fitDomain = false;
+  bool mirrorSymmetric = false;
+  FitDomainBounds<NumericType, 2> domainFit(
+      gridDelta, maskRadius, processKernel.getMaximumLateralReach());
+  domainFit.setMaskOrigin(maskOrigin);
+  domainFit.setFitted(fitDomain);
+  domainFit.setLateralExtent(extent);
+  domainFit.setMirrorSymmetric(mirrorSymmetric);
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
+
+  MakeMask<NumericType, 2> maskCreator(levelSet, mask);
+  maskCreator.setMaskOrigin(maskOrigin);
+  maskCreator.setMaskRadius(maskRadius);
+  maskCreator.setMaskShape(MaskShapeEnum::LINE_TRENCH);
+  maskCreator.apply();
+
+  processKernel.setSubstrate(levelSet);
+  processKernel.setMask(mask);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  processKernel.apply();
+  auto stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Geometric advect took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "Final profile has " << levelSet->getNumberOfPoints()
+            << " LS points" << std::endl;
+  BoschMemoryTracker::print(processKernel.getStageStatistics());
+
+  auto fullMask = domainFit.makeFullLevelSet(mask);
+  auto fullLevelSet = domainFit.makeFullLevelSet(levelSet);
+
+  auto profileMesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, 2>(fullLevelSet, profileMesh).apply();
+  VTKWriter(profileMesh, "profile.vtp").apply();
+
+  // the surface only needs the profile
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ExtrudeMesh<NumericType> surfaceExtrusion(profileMesh, mesh);
+  surfaceExtrusion.setExtent(0., length);
+  surfaceExtrusion.apply();
+  VTKWriter(mesh, "surface.vtp").apply();
+
+  if (!isVolume)
+    return 0;
+
+  omp_set_num_threads(16);
+
+  const auto &profileBounds = domainFit.getFullBounds();
+  double bounds[2 * 3] = {profileBounds[0], profileBounds[1], 0.,
+                          std::ceil(length / gridDelta) * gridDelta,
+                          profileBounds[2], profileBounds[3]};
+  BoundaryConditionEnum boundaryCons[3] = {
+      BoundaryConditionEnum::REFLECTIVE_BOUNDARY,
+      BoundaryConditionEnum::REFLECTIVE_BOUNDARY,
+      BoundaryConditionEnum::INFINITE_BOUNDARY};
+
+  auto mask3D = SmartPointer<Domain<NumericType, 3>>::New(bounds, boundaryCons,
+                                                          gridDelta);
+  auto levelSet3D = SmartPointer<Domain<NumericType, 3>>::New(
+      bounds, boundaryCons, gridDelta);
+
+  start = std::chrono::high_resolution_clock::now();
+  ExtrudeLevelSet<NumericType>(fullMask, mask3D).apply();
+  ExtrudeLevelSet<NumericType>(fullLevelSet, levelSet3D).apply();
+  stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Extruding took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "Final structure has " << levelSet3D->getNumberOfPoints()
+            << " LS points" << std::endl;
+
+  std::cout << "Making volume output...(this may take a while)" << std::endl;
+
+  auto volumeMeshing =
+      SmartPointer<WriteVisualizationMesh<NumericType, 3>>::New();
+  volumeMeshing->insertNextLevelSet(mask3D);
+  volumeMeshing->insertNextLevelSet(levelSet3D);
+  volumeMeshing->setFileName("bosch");
+  volumeMeshing->apply();
+
+  return 0;
+}
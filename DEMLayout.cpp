@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <omp.h>
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+#include <lsWriteVisualizationMesh.hpp>
+
+#include "BoschProcess.hpp"
+#include "LayoutMask.hpp"
+
+using namespace viennals;
+
+// Etches the openings of a polygon layout, see PolygonLayout for the file
+// formats:
+//
+//   DEMLayout <layout>
+//
+// Without a layout, an example of square and circular openings is written
+// to layout.txt and etched.
+
+typedef double NumericType;
+constexpr int D = 3;
+
+PolygonLayout<NumericType> makeExampleLayout() {
+  PolygonLayout<NumericType> layout;
+  const NumericType pitch = 2.5;
+  const NumericType halfWidth = 0.6;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      const NumericType x = i * pitch, y = j * pitch;
+      if ((i + j) % 2 == 0) {
+        layout.addPolygon({{x - halfWidth, y - halfWidth},
+                           {x + halfWidth, y - halfWidth},
+                           {x + halfWidth, y + halfWidth},
+                           {x - halfWidth, y + halfWidth}});
+      } else {
+        PolygonLayout<NumericType>::Polygon circle;
+        for (unsigned k = 0; k < 32; ++k) {
+          const NumericType angle = 2 * std::acos(-1.) * k / 32;
+          circle.push_back({x + halfWidth * std::cos(angle),
+                            y + halfWidth * std::sin(angle)});
+        }
+        layout.addPolygon(circle);
+      }
+    }
+  }
+  return layout;
+}
+
+int main(int argc, char **argv) {
+  // all available threads, which OMP_NUM_THREADS can limit
+  std::cout << "Threads: " << omp_get_max_threads() << std::endl;
+
+  // one stage runs at a time, so the peak memory of each is measured
+  BoschMemoryTracker::setResetPeakResident(true);
+
+  double gridDelta = 0.05;
+  NumericType etchRate = -0.25;
+
+  PolygonLayout<NumericType> layout;
+  if (argc > 1) {
+    if (!layout.readFile(argv[1]))
+      return 1;
+  } else {
+    layout = makeExampleLayout();
+    layout.writeText("layout.txt");
+  }
+  if (layout.getNumberOfPolygons() == 0) {
+    std::cout << "The layout has no openings" << std::endl;
+    return 1;
+  }
+  std::cout << "Layout has " << layout.getNumberOfPolygons() << " openings"
+            << std::endl;
+
+  BoschProcess<NumericType, D> processKernel;
+  processKernel.setNumCycles(40);
+  processKernel.setIsotropicRate(etchRate * 0.6);
+  processKernel.setCycleEtchDepth(etchRate);
+  processKernel.setStartWidth(1.);
+  processKernel.setBottomWidth(1.);
+  processKernel.setTapering(false);
+  processKernel.setSidewallTapering(false);
+  processKernel.setLateralEtchRatio(0.5);
+
+  // the domain covers the layout and the lateral reach of the etch
+  const auto layoutBounds = layout.getBounds();
+  const NumericType margin =
+      processKernel.getMaximumLateralReach() + 4 * gridDelta;
+  const NumericType depth = 40 * std::abs(etchRate) + 2.;
+  double bounds[2 * D] = {layoutBounds[0] - margin, layoutBounds[1] + margin,
+                          layoutBounds[2] - margin, layoutBounds[3] + margin,
+                          -depth, 3.};
+
+  BoundaryConditionEnum boundaryCons[D];
+  for (unsigned i = 0; i < D - 1; ++i)
+    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+  boundaryCons[D - 1] = BoundaryConditionEnum::INFINITE_BOUNDARY;
+
+  auto mask = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
+                                                        gridDelta);
+  auto levelSet = SmartPointer<Domain<NumericType, D>>::New(
+      bounds, boundaryCons, gridDelta);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  LayoutMask<NumericType, D> maskCreator(levelSet, mask);
+  maskCreator.setLayout(layout);
+  maskCreator.apply();
+  auto stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Rasterizing the layout took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  BoschMemoryTracker::print(maskCreator.getStageStatistics());
+
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
+  VTKWriter(mesh, "Surface_m.vtp").apply();
+
+  processKernel.setSubstrate(levelSet);
+  processKernel.setMask(mask);
+
+  start = std::chrono::high_resolution_clock::now();
+  processKernel.apply();
+  stop = std::chrono::high_resolution_clock::now();
+  std::cout << "Geometric advect took: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "Final structure has " << levelSet->getNumberOfPoints()
+            << " LS points" << std::endl;
+  BoschMemoryTracker::print(processKernel.getStageStatistics());
+
+  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  VTKWriter(mesh, "surface.vtp").apply();
+
+  auto volumeMeshing =
+      SmartPointer<WriteVisualizationMesh<NumericType, D>>::New();
+  volumeMeshing->insertNextLevelSet(mask);
+  volumeMeshing->insertNextLevelSet(levelSet);
+  volumeMeshing->setFileName("bosch");
+  volumeMeshing->apply();
+
+  return 0;
+}
@@ -11,104 +11,100 @@
 #include <lsVTKWriter.hpp>
 #include <lsWriteVisualizationMesh.hpp>
 
+#include "BoschArchive.hpp"
 #include "BoschProcess.hpp"
+#include "FitDomainBounds.hpp"
 #include "MakeMask.hpp"
-
-double reFromAt(double a_t) {
-  static constexpr double p0 = 1.17506441;
-  static constexpr double p1 = 0.61536308;
-  static constexpr double p2 = -0.42438527;
-  static constexpr double t0 = p1 / p0 - p2;
-  static constexpr double tm = p1 / (p0 - 1) - p2;
-
-  if (a_t <= t0) {
-    return 0.;
-  } else if (a_t >= tm) {
-    return 1.;
-  } else {
-    return p0 - p1 / (p2 + a_t);
-  }
-}
+#include "ModelRecipes.hpp"
 
 using namespace viennals;
 
 int main() {
   omp_set_num_threads(16);
 
+  // one stage runs at a time, so the peak memory of each is measured
+  BoschMemoryTracker::setResetPeakResident(true);
+
   constexpr int D = 2;
   typedef double NumericType;
-  double gridDelta = 0.025; // 0.125;
+  double gridDelta = DREAMRecipe::gridDelta;
 
-  double extent = 3;
-  double bounds[2 * D] = {-extent, extent, -extent, extent};
-  if constexpr (D == 3) {
-    bounds[4] = -extent;
-    bounds[5] = extent;
-  }
+  double extent = DREAMRecipe::extent;
 
-  BoundaryConditionEnum boundaryCons[D];
-  for (unsigned i = 0; i < D - 1; ++i) {
-    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
-  }
-  boundaryCons[D - 1] = BoundaryConditionEnum::INFINITE_BOUNDARY;
+  std::array<NumericType, 3> maskOrigin = {};
+  NumericType maskRadius = DREAMRecipe::maskRadius;
 
-  auto mask = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
-                                                        gridDelta);
+  // std::vector<NumericType> bottomFractions{
+  //     0.13948421397683908, 0.41944813667047265, 0.6400617331600338,
+  //     0.8183890372615938, 0.909870665101959};
 
-  auto levelSet = SmartPointer<Domain<NumericType, D>>::New(
-      bounds, boundaryCons, gridDelta);
+  // Calculate bottom fractions from model, based on ash times; last one is just
+  // maximum
+  std::vector<NumericType> ashTimes{0., 1.0, 1.2, 1.5, 2.0, 2.5, 4.0};
+  std::vector<NumericType> bottomFractions;
+  for (auto it : ashTimes) {
+    bottomFractions.push_back(DREAMRecipe::getBottomFraction(it));
+    std::cout << bottomFractions.back() << std::endl;
+  }
 
-  std::array<NumericType, 3> maskOrigin = {};
-  NumericType maskRadius = 0.4;
+  BoschProcess<NumericType, D> processKernel;
+  DREAMRecipe::apply(processKernel, bottomFractions.front());
+
+  // with fitDomain, only the lateral region which is reached by the etch
+  // is simulated instead of the whole extent. The structure is symmetric
+  // about the mask origin, so with mirrorSymmetric only the half (2D) or
+  // quarter (3D) domain is simulated and mirrored for output. Both are off
+  // until GoldenGeometry shows that the fitted and mirrored modes
+  // reproduce the full domain.
+  bool fitDomain = false;
+  bool mirrorSymmetric = false;
+  FitDomainBounds<NumericType, D> domainFit(
+      gridDelta, maskRadius, processKernel.getMaximumLateralReach());
+  domainFit.setMaskOrigin(maskOrigin);
+  domainFit.setFitted(fitDomain);
+  domainFit.setLateralExtent(extent);
+  domainFit.setMirrorSymmetric(mirrorSymmetric);
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
 
   MakeMask<NumericType, D> maskCreator(levelSet, mask);
   maskCreator.setMaskOrigin(maskOrigin);
   maskCreator.setMaskRadius(maskRadius);
   maskCreator.apply();
+  BoschMemoryTracker::print(maskCreator.getStageStatistics());
+
+  auto fullMask = domainFit.makeFullLevelSet(mask);
+  auto fullLevelSet = domainFit.makeFullLevelSet(levelSet);
 
   std::cout << "Output initial" << std::endl;
   auto mesh = SmartPointer<Mesh<NumericType>>::New();
 
   //   ToMesh<NumericType, D>(levelSet, mesh).apply();
   //   VTKWriter(mesh, "Surface_i_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullLevelSet, mesh).apply();
   VTKWriter(mesh, "Surface_i.vtp").apply();
   //   ToMesh<NumericType, D>(mask, mesh).apply();
   //   VTKWriter(mesh, "Surface_m_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
+  ToSurfaceMesh<NumericType, D>(fullMask, mesh).apply();
   VTKWriter(mesh, "Surface_m.vtp").apply();
 
-  // std::vector<NumericType> bottomFractions{
-  //     0.13948421397683908, 0.41944813667047265, 0.6400617331600338,
-  //     0.8183890372615938, 0.909870665101959};
-
-  // Take average from etch rate measurements in Fig3.11d from ChangThesis2018
-  NumericType etchRate =
-      -(46 + 42 + 44 * 2) / (4 * 119.); //-0.3697478991596639; // 0.39
-
-  // Calculate bottom fractions from model, based on ash times; last one is just
-  // maximum
-  std::vector<NumericType> ashTimes{0., 1.0, 1.2, 1.5, 2.0, 2.5, 4.0};
-  std::vector<NumericType> bottomFractions;
-  for (auto it : ashTimes) {
-    bottomFractions.push_back(reFromAt(it));
-    std::cout << bottomFractions.back() << std::endl;
-  }
-
-  BoschProcess<NumericType, D> processKernel;
   processKernel.setMask(mask);
-  processKernel.setNumCycles(100);
-  processKernel.setIsotropicRate(etchRate *
-                                 0.6); // * 1.2 / 2 because it is a radius
-  processKernel.setCycleEtchDepth(etchRate);
-  processKernel.setStartWidth(2 * maskRadius);
-  processKernel.setLateralEtchRatio(0.5);
+
+  // recipes, metrics and geometries of all runs in one file, see
+  // QueryArchive
+  std::filesystem::remove("dream.drarc");
+  BoschArchiveWriter<NumericType, D> archive("dream.drarc");
 
   for (auto it : bottomFractions) {
+    BoschMemoryTracker copyTracker;
+    copyTracker.beginStage("copy");
     auto substrate = SmartPointer<Domain<NumericType, D>>::New(levelSet);
+    copyTracker.endStage(substrate);
     processKernel.setSubstrate(substrate);
-    processKernel.setBottomWidth(2 * maskRadius * it);
-    processKernel.setStartOfTapering(-24.5);
+    DREAMRecipe::apply(processKernel, it);
 
     std::cout << "r_e: " << it << std::endl;
     auto start = std::chrono::high_resolution_clock::now();
@@ -121,12 +117,29 @@ int main() {
               << " ms" << std::endl;
     std::cout << "Final structure has " << substrate->getNumberOfPoints()
               << " LS points" << std::endl;
+    auto statistics = copyTracker.getStatistics();
+    for (auto &stage : processKernel.getStageStatistics())
+      statistics.push_back(stage);
+    BoschMemoryTracker::print(statistics);
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+    processKernel.getViaCounters().print("ViaDistribution");
+    processKernel.getScallopCounters().print("BoschDistribution");
+#endif
+
+    auto fullSubstrate = domainFit.makeFullLevelSet(substrate);
 
     // levelSet->print();
-    ToSurfaceMesh<NumericType, D>(substrate, mesh).apply();
+    ToSurfaceMesh<NumericType, D>(fullSubstrate, mesh).apply();
     std::ostringstream out;
     out.precision(2);
     out << std::fixed << it;
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    archive.addRun("r_e" + out.str(), processKernel.getProcessData(),
+                   {{"seconds", seconds},
+                    {"peakResidentMiB",
+                     BoschMemoryTracker::getPeakResidentBytes(statistics) /
+                         (1024. * 1024.)}},
+                   fullSubstrate);
     VTKWriter(mesh, "surface" + out.str() + ".vtp").apply();
     // ToMesh<NumericType, D>(levelSet, mesh).apply();
     // VTKWriter(mesh, "points-1.vtp").apply();
@@ -135,8 +148,8 @@ int main() {
 
     auto volumeMeshing =
         SmartPointer<WriteVisualizationMesh<NumericType, D>>::New();
-    volumeMeshing->insertNextLevelSet(mask);
-    volumeMeshing->insertNextLevelSet(substrate);
+    volumeMeshing->insertNextLevelSet(fullMask);
+    volumeMeshing->insertNextLevelSet(fullSubstrate);
     volumeMeshing->setFileName("bosch" + out.str());
     volumeMeshing->apply();
   }
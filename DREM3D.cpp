@@ -1,5 +1,6 @@
 #include <chrono>
 #include <iostream>
+#include <string>
 
 #include <lsBooleanOperation.hpp>
 #include <lsExpand.hpp>
@@ -12,22 +13,43 @@
 #include <lsWriteVisualizationMesh.hpp>
 
 #include "BoschProcess.hpp"
+#include "DecimateSurfaceMesh.hpp"
 #include "MakeMask.hpp"
+#include "ModelRecipes.hpp"
 #include "PillarMask.hpp"
+#include "SliceLevelSet.hpp"
+#include "TiledBoschProcess.hpp"
 
 using namespace viennals;
 
-int main() {
+// Pass "lod" as argument to also write decimated levels of detail of the
+// final surface to surface_lod1.vtp to surface_lod3.vtp. An optional
+// second argument bounds the distance of every vertex of the surface to
+// the decimated ones, in grid cells (default 0.5).
+
+int main(int argc, char **argv) {
+  const bool isLevelsOfDetail = argc > 1 && std::string(argv[1]) == "lod";
+  const double lodMaxDeviation = (argc > 2) ? std::stod(argv[2]) : 0.5;
+
   omp_set_num_threads(32);
 
   constexpr int D = 3;
   typedef double NumericType;
-  double gridDelta = 0.05; // 0.125;
-
-  NumericType maskRadius = 1.25 / 2.;
-  NumericType lineDistance = 0.51;
-  NumericType unitCellLength = (2 * maskRadius + lineDistance);
-  double extent = 2 * unitCellLength;
+  double gridDelta = DREM3DRecipe::gridDelta;
+
+  NumericType maskRadius = DREM3DRecipe::maskRadius;
+  NumericType lineDistance = DREM3DRecipe::lineDistance;
+  NumericType unitCellLength = DREM3DRecipe::unitCellLength;
+  double extent = DREM3DRecipe::extent;
+
+  // run the process tile by tile for pillar fields which do not fit into
+  // memory; a memory budget of 0 runs one tile after the other
+  bool tiled = false;
+  NumericType tileSize = 2 * unitCellLength;
+  std::uint64_t memoryBudget = 0;
+  // tiles may run at the same time, so the peak memory of the stages is
+  // only measured in the untiled mode
+  BoschMemoryTracker::setResetPeakResident(!tiled);
   double bounds[2 * D] = {-extent, extent, -extent, extent};
   if constexpr (D == 3) {
     bounds[4] = -extent;
@@ -48,53 +70,90 @@ int main() {
 
   std::array<NumericType, 3> maskOrigin = {};
 
-  if constexpr (D == 2) {
-    MakeMask<NumericType, D> maskCreator(levelSet, mask);
-    maskCreator.setMaskOrigin(maskOrigin);
-    maskCreator.setMaskRadius(maskRadius);
-    maskCreator.apply();
-  }
-
-  if constexpr (D == 3) {
-    PillarMask<NumericType, D> maskCreator(levelSet, mask);
-    maskCreator.setMaskOrigin(maskOrigin);
-    maskCreator.setMaskRadius(maskRadius);
-    maskCreator.setLineDistance(lineDistance);
-    maskCreator.apply();
-  }
-
-  std::cout << "Output initial" << std::endl;
   auto mesh = SmartPointer<Mesh<NumericType>>::New();
 
-  //   ToMesh<NumericType, D>(levelSet, mesh).apply();
-  //   VTKWriter(mesh, "Surface_i_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
-  VTKWriter(mesh, "Surface_i.vtp").apply();
-  //   ToMesh<NumericType, D>(mask, mesh).apply();
-  //   VTKWriter(mesh, "Surface_m_p.vtp").apply();
-  ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
-  VTKWriter(mesh, "Surface_m.vtp").apply();
-
-  // Take average from etch rate measurements in Fig6.c from Chang2018
-  NumericType etchRate = -0.25;
-
-  BoschProcess<NumericType, D> processKernel;
-  processKernel.setMask(mask);
-  processKernel.setNumCycles(80);
-  processKernel.setIsotropicRate(etchRate *
-                                 0.6); // * 1.2 / 2 because it is a radius
-  processKernel.setCycleEtchDepth(etchRate);
-  processKernel.setStartWidth(2 * maskRadius);
-
-  processKernel.setSubstrate(levelSet);
-  processKernel.setBottomWidth(2 * maskRadius);
-  // processKernel.setStartOfTapering(-24.5);
-  processKernel.setSausageCycling(10);
-  processKernel.setSausageCycleDepth(2 * etchRate);
-  processKernel.setLateralEtchRatio(0.5);
+  // in tiled mode, the mask is only built on the tiles
+  if (!tiled) {
+    if constexpr (D == 2) {
+      MakeMask<NumericType, D> maskCreator(levelSet, mask);
+      maskCreator.setMaskOrigin(maskOrigin);
+      maskCreator.setMaskRadius(maskRadius);
+      maskCreator.apply();
+      BoschMemoryTracker::print(maskCreator.getStageStatistics());
+    }
+
+    if constexpr (D == 3) {
+      PillarMask<NumericType, D> maskCreator(levelSet, mask);
+      maskCreator.setMaskOrigin(maskOrigin);
+      maskCreator.setMaskRadius(maskRadius);
+      maskCreator.setLineDistance(lineDistance);
+      maskCreator.apply();
+      BoschMemoryTracker::print(maskCreator.getStageStatistics());
+    }
+
+    std::cout << "Output initial" << std::endl;
+    //   ToMesh<NumericType, D>(levelSet, mesh).apply();
+    //   VTKWriter(mesh, "Surface_i_p.vtp").apply();
+    ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+    VTKWriter(mesh, "Surface_i.vtp").apply();
+    //   ToMesh<NumericType, D>(mask, mesh).apply();
+    //   VTKWriter(mesh, "Surface_m_p.vtp").apply();
+    ToSurfaceMesh<NumericType, D>(mask, mesh).apply();
+    VTKWriter(mesh, "Surface_m.vtp").apply();
+  }
 
   auto start = std::chrono::high_resolution_clock::now();
-  processKernel.apply();
+  if (tiled) {
+    // each tile builds its part of the pillar field, so the whole domain
+    // is only held in memory for the output
+    TiledBoschProcess<NumericType, D> tiledProcess;
+    std::array<double, 2 * D> domainBounds;
+    std::copy(bounds, bounds + 2 * D, domainBounds.begin());
+    tiledProcess.setBounds(domainBounds);
+    tiledProcess.setGridDelta(gridDelta);
+    tiledProcess.setTileSize(tileSize);
+    tiledProcess.setMemoryBudget(memoryBudget);
+    tiledProcess.setRecipe(DREM3DRecipe::apply<NumericType, D>);
+    // the pillar field of the whole domain starts at its first grid point
+    std::array<NumericType, 4> patternBounds;
+    for (unsigned i = 0; i < 2; ++i) {
+      patternBounds[2 * i] = std::floor(bounds[2 * i] / gridDelta) * gridDelta;
+      patternBounds[2 * i + 1] =
+          std::ceil(bounds[2 * i + 1] / gridDelta) * gridDelta;
+    }
+    tiledProcess.setMaskFunction([&](auto tileSubstrate, auto tileMask) {
+      PillarMask<NumericType, D> tileMaskCreator(tileSubstrate, tileMask);
+      tileMaskCreator.setMaskOrigin(maskOrigin);
+      tileMaskCreator.setMaskRadius(maskRadius);
+      tileMaskCreator.setLineDistance(lineDistance);
+      tileMaskCreator.setPatternBounds(patternBounds);
+      tileMaskCreator.apply();
+    });
+    tiledProcess.apply();
+    std::cout << tiledProcess.getNumberOfTiles() << " tiles, "
+              << tiledProcess.getNumberOfConcurrentTiles()
+              << " at once with "
+              << tiledProcess.getTileFootprint() / (1024 * 1024)
+              << " MiB each" << std::endl;
+
+    levelSet = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
+                                                         gridDelta);
+    mask = SmartPointer<Domain<NumericType, D>>::New(bounds, boundaryCons,
+                                                     gridDelta);
+    tiledProcess.stitch(levelSet, mask);
+  } else {
+    BoschProcess<NumericType, D> processKernel;
+    DREM3DRecipe::apply(processKernel);
+    processKernel.setMask(mask);
+    processKernel.setSubstrate(levelSet);
+    processKernel.setProgressCallback(printBoschProgress);
+    processKernel.apply();
+    BoschMemoryTracker::print(processKernel.getStageStatistics());
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+    processKernel.getViaCounters().print("ViaDistribution");
+    processKernel.getScallopCounters().print("BoschDistribution");
+#endif
+  }
   auto stop = std::chrono::high_resolution_clock::now();
   std::cout << "Geometric advect took: "
             << std::chrono::duration_cast<std::chrono::milliseconds>(stop -
@@ -107,9 +166,41 @@ int main() {
   // levelSet->print();
   ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
   VTKWriter(mesh, "surface.vtp").apply();
+
+  // decimated levels of detail, with the tolerance and the maximum
+  // deviation relative to the grid
+  if (isLevelsOfDetail) {
+    std::vector<NumericType> lodTolerances = {0.05, 0.2, 0.5};
+    for (unsigned i = 0; i < lodTolerances.size(); ++i) {
+      auto lodMesh = SmartPointer<Mesh<NumericType>>::New();
+      DecimateSurfaceMesh<NumericType> decimate(mesh, lodMesh,
+                                                lodTolerances[i] * gridDelta);
+      decimate.setMaximumDeviation(lodMaxDeviation * gridDelta);
+      decimate.apply();
+      VTKWriter(lodMesh, "surface_lod" + std::to_string(i + 1) + ".vtp")
+          .apply();
+    }
+  }
   ToMesh<NumericType, D>(levelSet, mesh).apply();
   VTKWriter(mesh, "points-1.vtp").apply();
 
+  // vertical profiles along x through a row of pillars and through the gap
+  // between two rows, straight from the level set
+  if constexpr (D == 3) {
+    std::array<NumericType, 2> sectionOffsets = {0.5 * unitCellLength, 0.};
+    std::array<std::string, 2> sectionNames = {"section_pillars.vtp",
+                                               "section_gap.vtp"};
+    for (unsigned i = 0; i < sectionOffsets.size(); ++i) {
+      auto sectionMesh = SmartPointer<Mesh<NumericType>>::New();
+      SliceLevelSet<NumericType> section(levelSet);
+      section.setPlaneOrigin({0., sectionOffsets[i], 0.});
+      section.setPlaneDirection({1., 0.});
+      section.setContour(sectionMesh);
+      section.apply();
+      VTKWriter(sectionMesh, sectionNames[i]).apply();
+    }
+  }
+
   std::cout << "Making volume output..." << std::endl;
 
   auto volumeMeshing =
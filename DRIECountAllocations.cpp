@@ -0,0 +1,45 @@
+// Replacement of the global allocation functions which counts all
+// allocations in BoschAllocationCounters. Linked into the executables by
+// the CMake option DRIE_COUNT_ALLOCATIONS. A program may only replace
+// these functions once, so this file must never be part of a library.
+
+#if defined(DRIE_BUILDING_PRECOMPILED) || defined(DRIE_BUILDING_LIBRARY)
+#error "DRIECountAllocations.cpp must only be linked into executables"
+#endif
+
+#include <cstdlib>
+#include <new>
+
+#include "BoschMemory.hpp"
+
+namespace {
+struct EnableAllocationCounting {
+  EnableAllocationCounting() {
+    BoschAllocationCounters::get().isCounting.store(
+        true, std::memory_order_relaxed);
+  }
+} enableAllocationCounting;
+} // namespace
+
+void *operator new(std::size_t size) {
+  auto &counters = BoschAllocationCounters::get();
+  counters.numAllocations.fetch_add(1, std::memory_order_relaxed);
+  counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size ? size : 1))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Explicit instantiations of the model templates for double precision,
+// following the scheme of ViennaLS' lsPreCompileMacros.hpp:
+// - in the driesequences_precompiled library (DRIE_BUILDING_PRECOMPILED)
+//   the macros instantiate the templates,
+// - in targets linking against it (DRIE_USE_PRECOMPILED) they declare the
+//   instantiations extern, so they are not compiled again,
+// - otherwise they expand to nothing.
+// Only double is instantiated, since the models mix T with double
+// literals and arrays in many places.
+
+#if defined(DRIE_BUILDING_PRECOMPILED)
+#define DRIE_TEMPLATE_INSTANTIATION template
+#elif defined(DRIE_USE_PRECOMPILED)
+#define DRIE_TEMPLATE_INSTANTIATION extern template
+#endif
+
+#ifdef DRIE_TEMPLATE_INSTANTIATION
+
+#define DRIE_PRECOMPILE_PRECISION_DIMENSION(className)                         \
+  DRIE_TEMPLATE_INSTANTIATION class className<double, 2>;                      \
+  DRIE_TEMPLATE_INSTANTIATION class className<double, 3>
+
+#define DRIE_PRECOMPILE_PRECISION(className)                                   \
+  DRIE_TEMPLATE_INSTANTIATION class className<double>
+
+#define DRIE_PRECOMPILE_SPECIALIZE(className, dimension)                       \
+  DRIE_TEMPLATE_INSTANTIATION class className<double, dimension>
+
+#else
+
+#define DRIE_PRECOMPILE_PRECISION_DIMENSION(className)
+#define DRIE_PRECOMPILE_PRECISION(className)
+#define DRIE_PRECOMPILE_SPECIALIZE(className, dimension)
+
+#endif
@@ -0,0 +1,25 @@
+// Explicit instantiations of all model templates for double precision,
+// see DRIEPreCompileMacros.hpp. Each header instantiates its own
+// templates when included here. The headers define no global functions,
+// e.g. the allocation counting of DRIECountAllocations.cpp, which would
+// clash with the executables linking this library.
+
+#define DRIE_BUILDING_PRECOMPILED
+
+#include "BoschArchive.hpp"
+#include "BoschCostEstimate.hpp"
+#include "BoschEnsemble.hpp"
+#include "BoschFrames.hpp"
+#include "BoschProcess.hpp"
+#include "BoschResolution.hpp"
+#include "DecimateSurfaceMesh.hpp"
+#include "ExtrudeLevelSet.hpp"
+#include "FitDomainBounds.hpp"
+#include "GeometryComparison.hpp"
+#include "LayoutMask.hpp"
+#include "MakeMask.hpp"
+#include "MirrorLevelSet.hpp"
+#include "PillarMask.hpp"
+#include "RevolveLevelSet.hpp"
+#include "SliceLevelSet.hpp"
+#include "TiledBoschProcess.hpp"
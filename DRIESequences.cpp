@@ -0,0 +1,504 @@
+// Implementation of the C interface declared in DRIESequences.h
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+
+#include <lsDomain.hpp>
+#include <lsReader.hpp>
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+#include <lsWriter.hpp>
+
+#include "BoschProcess.hpp"
+#include "DRIESequences.h"
+#include "MakeMask.hpp"
+#include "PillarMask.hpp"
+
+using NumericType = double;
+
+template <int D>
+using LSPtrType = viennals::SmartPointer<viennals::Domain<NumericType, D>>;
+
+struct drie_domain_s {
+  int dimension = 0;
+  LSPtrType<2> levelSet2D = nullptr;
+  LSPtrType<3> levelSet3D = nullptr;
+
+  template <int D> LSPtrType<D> get() const {
+    if constexpr (D == 2)
+      return levelSet2D;
+    else
+      return levelSet3D;
+  }
+
+  template <int D> void set(LSPtrType<D> levelSet) {
+    dimension = D;
+    if constexpr (D == 2)
+      levelSet2D = levelSet;
+    else
+      levelSet3D = levelSet;
+  }
+};
+
+struct drie_process_s {
+  // parameters are set on both kernels, the dimension of the domains
+  // passed to apply decides which one is used
+  BoschProcess<NumericType, 2> kernel2D;
+  BoschProcess<NumericType, 3> kernel3D;
+  viennals::SmartPointer<BoschCancellationToken> cancellation =
+      viennals::SmartPointer<BoschCancellationToken>::New();
+  int numThreads = 0;
+  drie_process_metrics metrics = {};
+
+  template <class F> void forEachKernel(F f) {
+    f(kernel2D);
+    f(kernel3D);
+  }
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+drie_status setError(drie_status status, const std::string &message) {
+  lastError = message;
+  return status;
+}
+
+// run f and translate all exceptions into status codes
+template <class F> drie_status guarded(F f) {
+  try {
+    return f();
+  } catch (const std::exception &e) {
+    return setError(DRIE_ERROR_INTERNAL, e.what());
+  } catch (...) {
+    return setError(DRIE_ERROR_INTERNAL, "Unknown exception");
+  }
+}
+
+// call f with the dimension as a compile time constant
+template <class F> drie_status dispatch(int dimension, F f) {
+  if (dimension == 2)
+    return f(std::integral_constant<int, 2>());
+  if (dimension == 3)
+    return f(std::integral_constant<int, 3>());
+  return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                  "Dimension must be 2 or 3, got " +
+                      std::to_string(dimension));
+}
+
+template <class F> drie_status setProcessParameter(drie_process process, F f) {
+  if (process == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Process handle is null");
+  return guarded([&]() {
+    process->forEachKernel(f);
+    return DRIE_OK;
+  });
+}
+
+template <int D>
+LSPtrType<D> makeLevelSet(const double *bounds, double gridDelta) {
+  double domainBounds[2 * D];
+  for (unsigned i = 0; i < 2 * D; ++i)
+    domainBounds[i] = bounds[i];
+
+  viennals::BoundaryConditionEnum boundaryCons[D];
+  for (unsigned i = 0; i < D - 1; ++i)
+    boundaryCons[i] = viennals::BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+  boundaryCons[D - 1] = viennals::BoundaryConditionEnum::INFINITE_BOUNDARY;
+
+  return LSPtrType<D>::New(domainBounds, boundaryCons, gridDelta);
+}
+
+template <int D>
+void fillMetrics(const BoschProcess<NumericType, D> &kernel,
+                 drie_process_metrics &metrics) {
+  const auto &data = kernel.getProcessData();
+  metrics.trench_bottom = data.trenchBottom;
+  metrics.taper_start = data.taperStart;
+  metrics.taper_ratio = data.taperRatio;
+  metrics.num_taper_cycles = data.numTaperCycles;
+  metrics.num_cycles = data.numCycles;
+  metrics.peak_resident_bytes = 0;
+  metrics.num_substrate_points = 0;
+  metrics.from_cache = 0;
+  for (auto &stage : kernel.getStageStatistics()) {
+    metrics.peak_resident_bytes =
+        std::max(metrics.peak_resident_bytes, stage.peakResidentBytes);
+    metrics.num_substrate_points = stage.numSubstratePoints;
+    if (stage.stage == "cache")
+      metrics.from_cache = 1;
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+int drie_get_api_version(void) { return DRIE_API_VERSION; }
+
+const char *drie_get_last_error(void) { return lastError.c_str(); }
+
+drie_status drie_set_num_threads(int num_threads) {
+  if (num_threads < 1)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Number of threads must be positive");
+  omp_set_num_threads(num_threads);
+  return DRIE_OK;
+}
+
+drie_status drie_domain_create(int dimension, const double *bounds,
+                               double grid_delta, drie_domain *domain) {
+  if (bounds == nullptr || domain == nullptr || !(grid_delta > 0.))
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid bounds, grid delta or output handle");
+  return dispatch(dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      auto handle = new drie_domain_s;
+      handle->set<D>(makeLevelSet<D>(bounds, grid_delta));
+      *domain = handle;
+      return DRIE_OK;
+    });
+  });
+}
+
+drie_status drie_domain_copy(drie_domain source, drie_domain *domain) {
+  if (source == nullptr || domain == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Domain handle is null");
+  return dispatch(source->dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      auto handle = new drie_domain_s;
+      handle->set<D>(LSPtrType<D>::New(source->get<D>()));
+      *domain = handle;
+      return DRIE_OK;
+    });
+  });
+}
+
+void drie_domain_destroy(drie_domain domain) { delete domain; }
+
+int drie_domain_get_dimension(drie_domain domain) {
+  return (domain != nullptr) ? domain->dimension : 0;
+}
+
+drie_status drie_domain_get_number_of_points(drie_domain domain,
+                                             uint64_t *num_points) {
+  if (domain == nullptr || num_points == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Domain handle is null");
+  return dispatch(domain->dimension, [&](auto dim) {
+    *num_points = domain->get<decltype(dim)::value>()->getNumberOfPoints();
+    return DRIE_OK;
+  });
+}
+
+drie_status drie_domain_read(int dimension, const char *file_name,
+                             drie_domain *domain) {
+  if (file_name == nullptr || domain == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid file name or output handle");
+  if (!std::filesystem::exists(file_name))
+    return setError(DRIE_ERROR_IO,
+                    "File " + std::string(file_name) + " does not exist");
+  return dispatch(dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      auto levelSet = LSPtrType<D>::New();
+      viennals::Reader<NumericType, D>(levelSet, file_name).apply();
+      auto handle = new drie_domain_s;
+      handle->set<D>(levelSet);
+      *domain = handle;
+      return DRIE_OK;
+    });
+  });
+}
+
+drie_status drie_domain_write(drie_domain domain, const char *file_name) {
+  if (domain == nullptr || file_name == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid domain handle or file name");
+  return dispatch(domain->dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      viennals::Writer<NumericType, D>(domain->get<D>(), file_name).apply();
+      return DRIE_OK;
+    });
+  });
+}
+
+drie_status drie_domain_write_surface(drie_domain domain,
+                                      const char *file_name) {
+  if (domain == nullptr || file_name == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid domain handle or file name");
+  return dispatch(domain->dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      auto mesh = viennals::SmartPointer<viennals::Mesh<NumericType>>::New();
+      viennals::ToSurfaceMesh<NumericType, D>(domain->get<D>(), mesh).apply();
+      viennals::VTKWriter<NumericType>(mesh, file_name).apply();
+      return DRIE_OK;
+    });
+  });
+}
+
+drie_status drie_make_mask(drie_domain substrate, drie_domain mask,
+                           const double *origin, double radius) {
+  if (substrate == nullptr || mask == nullptr || origin == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid domain handle or origin");
+  if (substrate->dimension != mask->dimension)
+    return setError(DRIE_ERROR_DIMENSION_MISMATCH,
+                    "Substrate and mask have different dimensions");
+  return dispatch(substrate->dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      std::array<NumericType, 3> maskOrigin = {origin[0], origin[1],
+                                               origin[2]};
+      MakeMask<NumericType, D> maskCreator(substrate->get<D>(),
+                                           mask->get<D>());
+      maskCreator.setMaskOrigin(maskOrigin);
+      maskCreator.setMaskRadius(radius);
+      maskCreator.apply();
+      return DRIE_OK;
+    });
+  });
+}
+
+drie_status drie_make_pillar_mask(drie_domain substrate, drie_domain mask,
+                                  const double *origin, double radius,
+                                  double line_distance) {
+  if (substrate == nullptr || mask == nullptr || origin == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid domain handle or origin");
+  if (substrate->dimension != 3 || mask->dimension != 3)
+    return setError(DRIE_ERROR_DIMENSION_MISMATCH,
+                    "The pillar mask requires 3D domains");
+  return guarded([&]() {
+    std::array<NumericType, 3> maskOrigin = {origin[0], origin[1], origin[2]};
+    PillarMask<NumericType, 3> maskCreator(substrate->get<3>(),
+                                           mask->get<3>());
+    maskCreator.setMaskOrigin(maskOrigin);
+    maskCreator.setMaskRadius(radius);
+    maskCreator.setLineDistance(line_distance);
+    maskCreator.apply();
+    return DRIE_OK;
+  });
+}
+
+drie_status drie_process_create(drie_process *process) {
+  if (process == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Output handle is null");
+  return guarded([&]() {
+    auto handle = new drie_process_s;
+    handle->forEachKernel([&](auto &kernel) {
+      kernel.setCancellationToken(handle->cancellation);
+      // the token is always set, so do not keep a copy of the substrate
+      kernel.setRestoreOnCancel(false);
+      // a library must not write to the stdout of its host
+      kernel.setVerbose(false);
+    });
+    *process = handle;
+    return DRIE_OK;
+  });
+}
+
+void drie_process_destroy(drie_process process) { delete process; }
+
+drie_status drie_process_set_num_threads(drie_process process,
+                                         int num_threads) {
+  if (process == nullptr || num_threads < 0)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid process handle or number of threads");
+  process->numThreads = num_threads;
+  return DRIE_OK;
+}
+
+drie_status drie_process_set_verbose(drie_process process, int verbose) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setVerbose(verbose != 0); });
+}
+
+drie_status drie_process_set_num_cycles(drie_process process,
+                                        unsigned num_cycles) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setNumCycles(num_cycles); });
+}
+
+drie_status drie_process_set_isotropic_rate(drie_process process,
+                                            double rate) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setIsotropicRate(rate); });
+}
+
+drie_status drie_process_set_start_width(drie_process process, double width) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setStartWidth(width); });
+}
+
+drie_status drie_process_set_bottom_width(drie_process process,
+                                          double width) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setBottomWidth(width); });
+}
+
+drie_status drie_process_set_start_of_tapering(drie_process process,
+                                               double z) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setStartOfTapering(z); });
+}
+
+drie_status drie_process_set_top_offset(drie_process process, double offset) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setTopOffset(offset); });
+}
+
+drie_status drie_process_set_mask_origin(drie_process process,
+                                         const double *origin) {
+  if (origin == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Origin is null");
+  return setProcessParameter(process, [&](auto &kernel) {
+    kernel.setMaskOrigin({origin[0], origin[1], origin[2]});
+  });
+}
+
+drie_status drie_process_set_tapering(drie_process process, int is_tapering) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setTapering(is_tapering != 0); });
+}
+
+drie_status drie_process_set_sidewall_tapering(drie_process process,
+                                               int is_tapering) {
+  return setProcessParameter(process, [&](auto &kernel) {
+    kernel.setSidewallTapering(is_tapering != 0);
+  });
+}
+
+drie_status drie_process_set_cycle_etch_depth(drie_process process,
+                                              double depth) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setCycleEtchDepth(depth); });
+}
+
+drie_status drie_process_set_sausage_cycling(drie_process process,
+                                             unsigned nth_cycle) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setSausageCycling(nth_cycle); });
+}
+
+drie_status drie_process_set_sausage_cycle_depth(drie_process process,
+                                                 double rate) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setSausageCycleDepth(rate); });
+}
+
+drie_status drie_process_set_lateral_etch_ratio(drie_process process,
+                                                double ratio) {
+  return setProcessParameter(
+      process, [&](auto &kernel) { kernel.setLateralEtchRatio(ratio); });
+}
+
+drie_status drie_process_add_recipe_step(drie_process process,
+                                         unsigned num_cycles,
+                                         double isotropic_rate,
+                                         double cycle_etch_depth,
+                                         double lateral_ratio) {
+  return setProcessParameter(process, [&](auto &kernel) {
+    kernel.addRecipeStep(num_cycles, isotropic_rate, cycle_etch_depth,
+                         lateral_ratio);
+  });
+}
+
+drie_status drie_process_add_recipe_ramp(
+    drie_process process, unsigned num_cycles, double start_isotropic_rate,
+    double end_isotropic_rate, double start_cycle_etch_depth,
+    double end_cycle_etch_depth, double start_lateral_ratio,
+    double end_lateral_ratio) {
+  return setProcessParameter(process, [&](auto &kernel) {
+    kernel.addRecipeRamp(num_cycles, start_isotropic_rate, end_isotropic_rate,
+                         start_cycle_etch_depth, end_cycle_etch_depth,
+                         start_lateral_ratio, end_lateral_ratio);
+  });
+}
+
+drie_status drie_process_clear_recipe(drie_process process) {
+  return setProcessParameter(process,
+                             [&](auto &kernel) { kernel.clearRecipe(); });
+}
+
+drie_status drie_process_apply(drie_process process, drie_domain substrate,
+                               drie_domain mask) {
+  if (process == nullptr || substrate == nullptr || mask == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid process or domain handle");
+  if (substrate->dimension != mask->dimension)
+    return setError(DRIE_ERROR_DIMENSION_MISMATCH,
+                    "Substrate and mask have different dimensions");
+
+  const int previousThreads = omp_get_max_threads();
+  if (process->numThreads > 0)
+    omp_set_num_threads(process->numThreads);
+
+  auto status = dispatch(substrate->dimension, [&](auto dim) {
+    return guarded([&]() {
+      constexpr int D = decltype(dim)::value;
+      BoschProcess<NumericType, D> *kernel;
+      if constexpr (D == 2)
+        kernel = &process->kernel2D;
+      else
+        kernel = &process->kernel3D;
+
+      kernel->setSubstrate(substrate->get<D>());
+      kernel->setMask(mask->get<D>());
+
+      auto start = std::chrono::steady_clock::now();
+      kernel->apply();
+      process->metrics.seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+      fillMetrics(*kernel, process->metrics);
+
+      if (kernel->isCancelled())
+        return setError(DRIE_ERROR_CANCELLED, "Process was cancelled");
+      return DRIE_OK;
+    });
+  });
+
+  // a cancellation request only applies to one call of apply
+  process->cancellation->reset();
+  if (process->numThreads > 0)
+    omp_set_num_threads(previousThreads);
+  return status;
+}
+
+drie_status drie_process_cancel(drie_process process) {
+  if (process == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT, "Process handle is null");
+  process->cancellation->cancel();
+  return DRIE_OK;
+}
+
+drie_status drie_process_get_metrics(drie_process process,
+                                     drie_process_metrics *metrics) {
+  if (process == nullptr || metrics == nullptr)
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "Invalid process handle or metrics");
+  if (metrics->struct_size < sizeof(size_t))
+    return setError(DRIE_ERROR_INVALID_ARGUMENT,
+                    "struct_size of the metrics is not set");
+
+  drie_process_metrics result = process->metrics;
+  const size_t size = std::min(metrics->struct_size, sizeof(result));
+  result.struct_size = size;
+  std::memcpy(metrics, &result, size);
+  return DRIE_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,170 @@
+#ifndef DRIE_SEQUENCES_H
+#define DRIE_SEQUENCES_H
+
+/* C interface of the driesequences shared library. It exposes the mask
+ * builders and BoschProcess on double precision level sets in 2D and 3D.
+ *
+ * All objects are accessed through opaque handles which are created and
+ * destroyed explicitly. A handle must not be used by two threads at the
+ * same time, except for drie_process_cancel. Independent handles can be
+ * used concurrently from different threads.
+ *
+ * All functions returning drie_status report errors through the status
+ * code; a description of the last error of the calling thread is returned
+ * by drie_get_last_error. No exception ever leaves the library. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef DRIE_BUILDING_LIBRARY
+#define DRIE_API __declspec(dllexport)
+#else
+#define DRIE_API __declspec(dllimport)
+#endif
+#else
+#define DRIE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented whenever the interface changes incompatibly. */
+#define DRIE_API_VERSION 1
+
+typedef enum {
+  DRIE_OK = 0,
+  DRIE_ERROR_INVALID_ARGUMENT = 1,
+  DRIE_ERROR_DIMENSION_MISMATCH = 2,
+  DRIE_ERROR_IO = 3,
+  DRIE_ERROR_CANCELLED = 4,
+  DRIE_ERROR_INTERNAL = 5
+} drie_status;
+
+typedef struct drie_domain_s *drie_domain;
+typedef struct drie_process_s *drie_process;
+
+/* Results of the last drie_process_apply. Set struct_size to
+ * sizeof(drie_process_metrics) before passing the struct, so that fields
+ * added in later versions are not written into older callers. */
+typedef struct {
+  size_t struct_size;
+  double trench_bottom;
+  double taper_start;
+  double taper_ratio;
+  unsigned num_taper_cycles;
+  unsigned num_cycles;
+  double seconds;
+  /* peak resident set size of the whole process up to the end of the
+   * apply; the library never resets it */
+  uint64_t peak_resident_bytes;
+  uint64_t num_substrate_points;
+  int from_cache;
+} drie_process_metrics;
+
+DRIE_API int drie_get_api_version(void);
+
+/* Description of the last error on the calling thread. The string is
+ * valid until the next call into the library on that thread. */
+DRIE_API const char *drie_get_last_error(void);
+
+/* Number of OpenMP threads used by calls from the calling thread. */
+DRIE_API drie_status drie_set_num_threads(int num_threads);
+
+/* Level set domains. bounds holds 2 * dimension values. The lateral
+ * boundaries are reflective and the vertical one is infinite, as in the
+ * models. */
+DRIE_API drie_status drie_domain_create(int dimension, const double *bounds,
+                                        double grid_delta,
+                                        drie_domain *domain);
+DRIE_API drie_status drie_domain_copy(drie_domain source, drie_domain *domain);
+DRIE_API void drie_domain_destroy(drie_domain domain);
+DRIE_API int drie_domain_get_dimension(drie_domain domain);
+DRIE_API drie_status drie_domain_get_number_of_points(drie_domain domain,
+                                                      uint64_t *num_points);
+/* Read and write the native .lvst format. */
+DRIE_API drie_status drie_domain_read(int dimension, const char *file_name,
+                                      drie_domain *domain);
+DRIE_API drie_status drie_domain_write(drie_domain domain,
+                                       const char *file_name);
+/* Write the surface as a .vtp file. */
+DRIE_API drie_status drie_domain_write_surface(drie_domain domain,
+                                               const char *file_name);
+
+/* Mask builders; origin holds 3 values. The pillar mask is 3D only. */
+DRIE_API drie_status drie_make_mask(drie_domain substrate, drie_domain mask,
+                                    const double *origin, double radius);
+DRIE_API drie_status drie_make_pillar_mask(drie_domain substrate,
+                                           drie_domain mask,
+                                           const double *origin,
+                                           double radius,
+                                           double line_distance);
+
+/* Bosch process. The parameters have the meaning of the setters of the
+ * C++ class BoschProcess. */
+DRIE_API drie_status drie_process_create(drie_process *process);
+DRIE_API void drie_process_destroy(drie_process process);
+/* Number of OpenMP threads used by drie_process_apply; 0 keeps the
+ * setting of the calling thread. */
+DRIE_API drie_status drie_process_set_num_threads(drie_process process,
+                                                  int num_threads);
+/* Whether drie_process_apply prints the derived process data and warnings
+ * to stdout. Defaults to 0, so the library does not write to stdout. */
+DRIE_API drie_status drie_process_set_verbose(drie_process process,
+                                              int verbose);
+DRIE_API drie_status drie_process_set_num_cycles(drie_process process,
+                                                 unsigned num_cycles);
+DRIE_API drie_status drie_process_set_isotropic_rate(drie_process process,
+                                                     double rate);
+DRIE_API drie_status drie_process_set_start_width(drie_process process,
+                                                  double width);
+DRIE_API drie_status drie_process_set_bottom_width(drie_process process,
+                                                   double width);
+DRIE_API drie_status drie_process_set_start_of_tapering(drie_process process,
+                                                        double z);
+DRIE_API drie_status drie_process_set_top_offset(drie_process process,
+                                                 double offset);
+DRIE_API drie_status drie_process_set_mask_origin(drie_process process,
+                                                  const double *origin);
+DRIE_API drie_status drie_process_set_tapering(drie_process process,
+                                               int is_tapering);
+DRIE_API drie_status drie_process_set_sidewall_tapering(drie_process process,
+                                                        int is_tapering);
+DRIE_API drie_status drie_process_set_cycle_etch_depth(drie_process process,
+                                                       double depth);
+DRIE_API drie_status drie_process_set_sausage_cycling(drie_process process,
+                                                      unsigned nth_cycle);
+DRIE_API drie_status drie_process_set_sausage_cycle_depth(drie_process process,
+                                                          double rate);
+DRIE_API drie_status drie_process_set_lateral_etch_ratio(drie_process process,
+                                                         double ratio);
+DRIE_API drie_status drie_process_add_recipe_step(drie_process process,
+                                                  unsigned num_cycles,
+                                                  double isotropic_rate,
+                                                  double cycle_etch_depth,
+                                                  double lateral_ratio);
+DRIE_API drie_status drie_process_add_recipe_ramp(
+    drie_process process, unsigned num_cycles, double start_isotropic_rate,
+    double end_isotropic_rate, double start_cycle_etch_depth,
+    double end_cycle_etch_depth, double start_lateral_ratio,
+    double end_lateral_ratio);
+DRIE_API drie_status drie_process_clear_recipe(drie_process process);
+
+/* Etch substrate through mask. Both domains must have the same dimension.
+ * Returns DRIE_ERROR_CANCELLED if drie_process_cancel was called, in which
+ * case the substrate is left partially etched. */
+DRIE_API drie_status drie_process_apply(drie_process process,
+                                        drie_domain substrate,
+                                        drie_domain mask);
+/* Request cancellation of a running drie_process_apply. May be called
+ * from any thread. If no apply is running, the next one is cancelled. */
+DRIE_API drie_status drie_process_cancel(drie_process process);
+DRIE_API drie_status drie_process_get_metrics(drie_process process,
+                                              drie_process_metrics *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRIE_SEQUENCES_H */
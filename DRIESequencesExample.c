@@ -0,0 +1,65 @@
+/* DEM2D through the C interface of the driesequences library, run for
+ * several bottom fractions with one process handle. */
+
+#include <stdio.h>
+
+#include "DRIESequences.h"
+
+#define CHECK(call)                                                            \
+  if ((call) != DRIE_OK) {                                                     \
+    fprintf(stderr, "%s failed: %s\n", #call, drie_get_last_error());         \
+    return 1;                                                                  \
+  }
+
+int main(void) {
+  const double extent = 4;
+  const double bounds[4] = {-extent, extent, -extent, extent};
+  const double gridDelta = 0.05;
+  const double maskOrigin[3] = {0., 0., 0.};
+  const double maskRadius = 0.6;
+  const double etchRate = -0.98;
+  const double bottomFractions[3] = {0.3, 0.5, 0.7};
+
+  drie_domain substrate, mask;
+  CHECK(drie_domain_create(2, bounds, gridDelta, &substrate));
+  CHECK(drie_domain_create(2, bounds, gridDelta, &mask));
+  CHECK(drie_make_mask(substrate, mask, maskOrigin, maskRadius));
+
+  drie_process process;
+  CHECK(drie_process_create(&process));
+  CHECK(drie_process_set_num_threads(process, 4));
+  CHECK(drie_process_set_num_cycles(process, 50));
+  CHECK(drie_process_set_isotropic_rate(process, etchRate * 0.6));
+  CHECK(drie_process_set_cycle_etch_depth(process, etchRate));
+  CHECK(drie_process_set_start_width(process, 2 * maskRadius));
+  CHECK(drie_process_set_start_of_tapering(process, 0));
+  CHECK(drie_process_set_sidewall_tapering(process, 0));
+  CHECK(drie_process_set_tapering(process, 0));
+  CHECK(drie_process_set_lateral_etch_ratio(process, 0.75));
+
+  for (unsigned i = 0; i < 3; ++i) {
+    drie_domain result;
+    CHECK(drie_domain_copy(substrate, &result));
+    CHECK(drie_process_set_bottom_width(process,
+                                        2 * maskRadius * bottomFractions[i]));
+    CHECK(drie_process_apply(process, result, mask));
+
+    drie_process_metrics metrics;
+    metrics.struct_size = sizeof(metrics);
+    CHECK(drie_process_get_metrics(process, &metrics));
+    printf("r_e %.1f: L_b = %g, %.3f s, %llu LS points\n", bottomFractions[i],
+           metrics.trench_bottom, metrics.seconds,
+           (unsigned long long)metrics.num_substrate_points);
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "surface%.1f.vtp",
+             bottomFractions[i]);
+    CHECK(drie_domain_write_surface(result, fileName));
+    drie_domain_destroy(result);
+  }
+
+  drie_process_destroy(process);
+  drie_domain_destroy(mask);
+  drie_domain_destroy(substrate);
+  return 0;
+}
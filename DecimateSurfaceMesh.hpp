@@ -0,0 +1,497 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include <lsMesh.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Reduces the number of elements of a surface mesh created by
+/// ToSurfaceMesh. Triangles (3D) are simplified by half-edge collapses
+/// ordered by their quadric error, i.e. the sum of the squared distances
+/// of the remaining vertex to the planes of the original triangles merged
+/// into it, as long as it stays below the squared tolerance. This is a
+/// heuristic and does not bound the distance to the original surface; set
+/// a maximum deviation for that, see setMaximumDeviation.
+/// Lines (2D) are simplified by removing vertices as long as no removed
+/// vertex is further than the tolerance from the new line. Flat regions
+/// therefore collapse to a few large elements, while curved features like
+/// scallops are preserved.
+/// Vertices on open mesh boundaries are never moved. Point and cell data
+/// are not transferred to the simplified mesh.
+template <class T> class DecimateSurfaceMesh {
+  using MeshPtrType = viennals::SmartPointer<viennals::Mesh<T>>;
+  using Quadric = std::array<double, 10>;
+
+  MeshPtrType inputMesh;
+  MeshPtrType outputMesh;
+  double tolerance = 0.;
+  double maxDeviation = std::numeric_limits<double>::infinity();
+
+  struct Collapse {
+    double cost;
+    unsigned from;
+    unsigned to;
+    unsigned fromVersion;
+    unsigned toVersion;
+    bool operator<(const Collapse &other) const { return cost > other.cost; }
+  };
+
+  static Quadric planeQuadric(const std::array<double, 3> &n, double d) {
+    return {n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * d,
+            n[1] * n[1], n[1] * n[2], n[1] * d,    n[2] * n[2],
+            n[2] * d,    d * d};
+  }
+
+  static double evaluate(const Quadric &q, const std::array<T, 3> &p) {
+    const double x = p[0], y = p[1], z = p[2];
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z +
+           2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+           q[7] * z * z + 2 * q[8] * z + q[9];
+  }
+
+  static std::array<double, 3> normal(const std::array<T, 3> &a,
+                                      const std::array<T, 3> &b,
+                                      const std::array<T, 3> &c) {
+    const double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    return {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+            u[0] * v[1] - u[1] * v[0]};
+  }
+
+  static double norm(const std::array<double, 3> &v) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  }
+
+  void decimateTriangles(std::vector<std::array<T, 3>> &nodes,
+                         std::vector<std::array<unsigned, 3>> &triangles) {
+    const unsigned numNodes = nodes.size();
+    std::vector<std::vector<unsigned>> nodeTriangles(numNodes);
+    std::vector<Quadric> quadrics(numNodes, Quadric{});
+    std::vector<bool> triangleAlive(triangles.size(), true);
+    std::vector<unsigned> version(numNodes, 0);
+
+    for (unsigned t = 0; t < triangles.size(); ++t) {
+      const auto &tri = triangles[t];
+      auto n = normal(nodes[tri[0]], nodes[tri[1]], nodes[tri[2]]);
+      const double length = norm(n);
+      if (length > 0.) {
+        for (auto &component : n)
+          component /= length;
+        const double d = -(n[0] * nodes[tri[0]][0] + n[1] * nodes[tri[0]][1] +
+                           n[2] * nodes[tri[0]][2]);
+        const auto q = planeQuadric(n, d);
+        for (unsigned i = 0; i < 3; ++i)
+          for (unsigned j = 0; j < 10; ++j)
+            quadrics[tri[i]][j] += q[j];
+      }
+      for (unsigned i = 0; i < 3; ++i)
+        nodeTriangles[tri[i]].push_back(t);
+    }
+
+    // nodes on open boundaries have an edge used by only one triangle
+    std::vector<bool> isBoundary(numNodes, false);
+    for (unsigned node = 0; node < numNodes; ++node) {
+      std::vector<unsigned> edgeNodes;
+      for (auto t : nodeTriangles[node])
+        for (unsigned i = 0; i < 3; ++i)
+          if (triangles[t][i] != node)
+            edgeNodes.push_back(triangles[t][i]);
+      std::sort(edgeNodes.begin(), edgeNodes.end());
+      for (unsigned i = 0; i < edgeNodes.size();) {
+        unsigned j = i;
+        while (j < edgeNodes.size() && edgeNodes[j] == edgeNodes[i])
+          ++j;
+        if (j - i != 2)
+          isBoundary[node] = true;
+        i = j;
+      }
+    }
+
+    auto neighbours = [&](unsigned node) {
+      std::vector<unsigned> result;
+      for (auto t : nodeTriangles[node])
+        for (unsigned i = 0; i < 3; ++i)
+          if (triangles[t][i] != node)
+            result.push_back(triangles[t][i]);
+      std::sort(result.begin(), result.end());
+      result.erase(std::unique(result.begin(), result.end()), result.end());
+      return result;
+    };
+
+    const double maxCost =
+        std::min(tolerance * tolerance, maxDeviation * maxDeviation);
+    const bool isDeviationBounded = std::isfinite(maxDeviation);
+    // nodes removed by collapses into a node, which keep their original
+    // position; each is within maxDeviation of the triangles around it
+    std::vector<std::vector<unsigned>> merged(numNodes);
+
+    // largest distance of the nodes merged into node, and of the given
+    // nodes, to the triangles around node once from is collapsed into to
+    auto fanDeviation = [&](unsigned node, unsigned from, unsigned to,
+                            const std::vector<unsigned> &moved) {
+      std::vector<std::array<unsigned, 3>> fan;
+      // the triangles sharing the collapsed edge vanish
+      auto addTriangles = [&](unsigned fanNode) {
+        for (auto t : nodeTriangles[fanNode]) {
+          auto tri = triangles[t];
+          const bool hasFrom = std::count(tri.begin(), tri.end(), from) > 0;
+          if (hasFrom && std::count(tri.begin(), tri.end(), to) > 0)
+            continue;
+          std::replace(tri.begin(), tri.end(), from, to);
+          fan.push_back(tri);
+        }
+      };
+      addTriangles(node);
+      if (node == to)
+        addTriangles(from);
+
+      double deviation = 0.;
+      const std::vector<unsigned> *lists[] = {&merged[node], &moved};
+      for (auto list : lists)
+        for (auto removed : *list) {
+          double distance = std::numeric_limits<double>::infinity();
+          for (const auto &tri : fan)
+            distance = std::min(
+                distance, distanceToTriangle(nodes[removed], nodes[tri[0]],
+                                             nodes[tri[1]], nodes[tri[2]]));
+          deviation = std::max(deviation, distance);
+          if (deviation > maxDeviation)
+            return deviation;
+        }
+      return deviation;
+    };
+
+    std::priority_queue<Collapse> queue;
+    auto pushCollapses = [&](unsigned node) {
+      for (auto other : neighbours(node)) {
+        // the removed node must not be on a boundary
+        for (auto [from, to] : {std::make_pair(node, other),
+                                std::make_pair(other, node)}) {
+          if (isBoundary[from])
+            continue;
+          Quadric q = quadrics[from];
+          for (unsigned j = 0; j < 10; ++j)
+            q[j] += quadrics[to][j];
+          const double cost = evaluate(q, nodes[to]);
+          if (cost <= maxCost)
+            queue.push({cost, from, to, version[from], version[to]});
+        }
+      }
+    };
+    for (unsigned node = 0; node < numNodes; ++node)
+      pushCollapses(node);
+
+    while (!queue.empty()) {
+      const auto collapse = queue.top();
+      queue.pop();
+      const unsigned from = collapse.from, to = collapse.to;
+      if (version[from] != collapse.fromVersion ||
+          version[to] != collapse.toVersion)
+        continue;
+
+      // link condition: the only common neighbours of the two nodes are
+      // the opposite nodes of the triangles sharing the edge
+      std::vector<unsigned> shared;
+      for (auto t : nodeTriangles[from]) {
+        const auto &tri = triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+          shared.push_back(t);
+      }
+      if (shared.empty())
+        continue;
+      auto fromNeighbours = neighbours(from);
+      auto toNeighbours = neighbours(to);
+      std::vector<unsigned> common;
+      std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(),
+                            toNeighbours.begin(), toNeighbours.end(),
+                            std::back_inserter(common));
+      if (common.size() != shared.size())
+        continue;
+
+      // moving the node must not flip any of the remaining triangles
+      bool isValid = true;
+      for (auto t : nodeTriangles[from]) {
+        auto tri = triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+          continue;
+        const auto oldNormal = normal(nodes[tri[0]], nodes[tri[1]],
+                                      nodes[tri[2]]);
+        for (auto &node : tri)
+          if (node == from)
+            node = to;
+        const auto newNormal = normal(nodes[tri[0]], nodes[tri[1]],
+                                      nodes[tri[2]]);
+        const double dot = oldNormal[0] * newNormal[0] +
+                           oldNormal[1] * newNormal[1] +
+                           oldNormal[2] * newNormal[2];
+        if (dot <= 0.2 * norm(oldNormal) * norm(newNormal)) {
+          isValid = false;
+          break;
+        }
+      }
+      if (!isValid)
+        continue;
+
+      // the nodes merged into from and into the nodes around it must stay
+      // within maxDeviation of the changed triangles around their nodes
+      if (isDeviationBounded) {
+        std::vector<unsigned> moved = merged[from];
+        moved.push_back(from);
+        if (fanDeviation(to, from, to, moved) > maxDeviation)
+          continue;
+        for (auto node : fromNeighbours) {
+          if (node != to && !merged[node].empty() &&
+              fanDeviation(node, from, to, {}) > maxDeviation) {
+            isValid = false;
+            break;
+          }
+        }
+        if (!isValid)
+          continue;
+        merged[to].insert(merged[to].end(), moved.begin(), moved.end());
+        merged[from].clear();
+      }
+
+      // perform the collapse
+      for (auto t : shared)
+        triangleAlive[t] = false;
+      for (auto t : nodeTriangles[from]) {
+        if (!triangleAlive[t])
+          continue;
+        for (auto &node : triangles[t])
+          if (node == from)
+            node = to;
+        nodeTriangles[to].push_back(t);
+      }
+      nodeTriangles[from].clear();
+      auto removeDead = [&](std::vector<unsigned> &triangleList) {
+        triangleList.erase(std::remove_if(triangleList.begin(),
+                                          triangleList.end(),
+                                          [&](unsigned t) {
+                                            return !triangleAlive[t];
+                                          }),
+                           triangleList.end());
+      };
+      removeDead(nodeTriangles[to]);
+      for (auto node : common)
+        removeDead(nodeTriangles[node]);
+      for (unsigned j = 0; j < 10; ++j)
+        quadrics[to][j] += quadrics[from][j];
+      ++version[from];
+      ++version[to];
+      pushCollapses(to);
+    }
+
+    // remove collapsed triangles and unused nodes
+    std::vector<unsigned> newIndex(numNodes, numNodes);
+    std::vector<std::array<T, 3>> newNodes;
+    std::vector<std::array<unsigned, 3>> newTriangles;
+    for (unsigned t = 0; t < triangles.size(); ++t) {
+      if (!triangleAlive[t])
+        continue;
+      auto tri = triangles[t];
+      for (auto &node : tri) {
+        if (newIndex[node] == numNodes) {
+          newIndex[node] = newNodes.size();
+          newNodes.push_back(nodes[node]);
+        }
+        node = newIndex[node];
+      }
+      newTriangles.push_back(tri);
+    }
+    nodes.swap(newNodes);
+    triangles.swap(newTriangles);
+  }
+
+  void decimateLines(std::vector<std::array<T, 3>> &nodes,
+                     std::vector<std::array<unsigned, 2>> &lines) {
+    const unsigned numNodes = nodes.size();
+    const unsigned none = numNodes;
+    std::vector<unsigned> previous(numNodes, none), next(numNodes, none);
+    std::vector<unsigned> degree(numNodes, 0);
+    for (auto &line : lines) {
+      next[line[0]] = line[1];
+      previous[line[1]] = line[0];
+      ++degree[line[0]];
+      ++degree[line[1]];
+    }
+
+    // original nodes which were removed between a node and its next node
+    std::vector<std::vector<unsigned>> removedAfter(numNodes);
+    std::vector<unsigned> version(numNodes, 0);
+    std::vector<bool> isAlive(numNodes, true);
+
+    auto removalCost = [&](unsigned node) {
+      const unsigned a = previous[node], b = next[node];
+      double cost = distanceToLine(nodes[node], nodes[a], nodes[b]);
+      for (auto list : {removedAfter[a], removedAfter[node]})
+        for (auto removed : list)
+          cost = std::max(cost, distanceToLine(nodes[removed], nodes[a],
+                                               nodes[b]));
+      return cost;
+    };
+
+    std::priority_queue<Collapse> queue;
+    auto pushRemoval = [&](unsigned node) {
+      if (degree[node] != 2 || previous[node] == none || next[node] == none ||
+          previous[node] == next[node])
+        return;
+      const double cost = removalCost(node);
+      if (cost <= std::min(tolerance, maxDeviation))
+        queue.push({cost, node, next[node], version[node], 0});
+    };
+    for (unsigned node = 0; node < numNodes; ++node)
+      pushRemoval(node);
+
+    while (!queue.empty()) {
+      const auto removal = queue.top();
+      queue.pop();
+      const unsigned node = removal.from;
+      if (!isAlive[node] || version[node] != removal.fromVersion)
+        continue;
+
+      const unsigned a = previous[node], b = next[node];
+      auto &removed = removedAfter[a];
+      removed.push_back(node);
+      removed.insert(removed.end(), removedAfter[node].begin(),
+                     removedAfter[node].end());
+      removedAfter[node].clear();
+      next[a] = b;
+      previous[b] = a;
+      isAlive[node] = false;
+      ++version[a];
+      ++version[b];
+      pushRemoval(a);
+      pushRemoval(b);
+    }
+
+    std::vector<unsigned> newIndex(numNodes, none);
+    std::vector<std::array<T, 3>> newNodes;
+    std::vector<std::array<unsigned, 2>> newLines;
+    for (unsigned node = 0; node < numNodes; ++node) {
+      if (!isAlive[node] || next[node] == none || !isAlive[next[node]])
+        continue;
+      std::array<unsigned, 2> line = {node, next[node]};
+      for (auto &n : line) {
+        if (newIndex[n] == none) {
+          newIndex[n] = newNodes.size();
+          newNodes.push_back(nodes[n]);
+        }
+        n = newIndex[n];
+      }
+      newLines.push_back(line);
+    }
+    nodes.swap(newNodes);
+    lines.swap(newLines);
+  }
+
+public:
+  /// Distance of the point p to the line segment ab.
+  static double distanceToLine(const std::array<T, 3> &p,
+                               const std::array<T, 3> &a,
+                               const std::array<T, 3> &b) {
+    double ab[3], ap[3];
+    double length2 = 0., projection = 0.;
+    for (unsigned i = 0; i < 3; ++i) {
+      ab[i] = b[i] - a[i];
+      ap[i] = p[i] - a[i];
+      length2 += ab[i] * ab[i];
+      projection += ab[i] * ap[i];
+    }
+    const double s =
+        (length2 > 0.) ? std::min(std::max(projection / length2, 0.), 1.) : 0.;
+    double distance2 = 0.;
+    for (unsigned i = 0; i < 3; ++i) {
+      const double d = ap[i] - s * ab[i];
+      distance2 += d * d;
+    }
+    return std::sqrt(distance2);
+  }
+
+  /// Distance of the point p to the triangle abc.
+  static double distanceToTriangle(const std::array<T, 3> &p,
+                                   const std::array<T, 3> &a,
+                                   const std::array<T, 3> &b,
+                                   const std::array<T, 3> &c) {
+    double ab[3], ac[3], ap[3];
+    double n[3];
+    for (unsigned i = 0; i < 3; ++i) {
+      ab[i] = b[i] - a[i];
+      ac[i] = c[i] - a[i];
+      ap[i] = p[i] - a[i];
+    }
+    n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    const double n2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+    // the projection of p onto the plane is inside if it is on the inner
+    // side of all edges
+    auto isInner = [&n](const std::array<T, 3> &from,
+                        const std::array<T, 3> &to,
+                        const std::array<T, 3> &point) {
+      const double u[3] = {to[0] - from[0], to[1] - from[1], to[2] - from[2]};
+      const double v[3] = {point[0] - from[0], point[1] - from[1],
+                           point[2] - from[2]};
+      return n[0] * (u[1] * v[2] - u[2] * v[1]) +
+                 n[1] * (u[2] * v[0] - u[0] * v[2]) +
+                 n[2] * (u[0] * v[1] - u[1] * v[0]) >=
+             0.;
+    };
+    if (n2 > 0. && isInner(a, b, p) && isInner(b, c, p) && isInner(c, a, p))
+      return std::abs(n[0] * ap[0] + n[1] * ap[1] + n[2] * ap[2]) /
+             std::sqrt(n2);
+    // the closest point is on an edge
+    return std::min({distanceToLine(p, a, b), distanceToLine(p, b, c),
+                     distanceToLine(p, c, a)});
+  }
+
+  DecimateSurfaceMesh() {}
+
+  DecimateSurfaceMesh(MeshPtrType passedInputMesh,
+                      MeshPtrType passedOutputMesh, double maxError)
+      : inputMesh(passedInputMesh), outputMesh(passedOutputMesh),
+        tolerance(maxError) {}
+
+  void setInputMesh(MeshPtrType passedMesh) { inputMesh = passedMesh; }
+
+  /// Mesh to write the simplified surface to. May be the input mesh.
+  void setOutputMesh(MeshPtrType passedMesh) { outputMesh = passedMesh; }
+
+  /// Tolerance of the simplification, see the class description.
+  void setMaximumError(double maxError) { tolerance = maxError; }
+
+  /// No vertex of the input mesh is further than this from the simplified
+  /// mesh. Collapses of triangles are rejected if their quadric error
+  /// exceeds its square or if they would move the triangles around a node
+  /// further than this from any input vertex removed into that node. For
+  /// lines, it caps the tolerance. Unbounded by default.
+  void setMaximumDeviation(double deviation) { maxDeviation = deviation; }
+
+  void apply() {
+    auto nodes = inputMesh->nodes;
+    auto triangles = inputMesh->triangles;
+    auto lines = inputMesh->lines;
+
+    if (!triangles.empty())
+      decimateTriangles(nodes, triangles);
+    else if (!lines.empty())
+      decimateLines(nodes, lines);
+
+    outputMesh->clear();
+    for (auto &node : nodes)
+      outputMesh->insertNextNode(node);
+    for (auto &triangle : triangles)
+      outputMesh->insertNextTriangle(triangle);
+    for (auto &line : lines)
+      outputMesh->insertNextLine(line);
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(DecimateSurfaceMesh);
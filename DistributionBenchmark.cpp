@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "BoschDistribution.hpp"
+#include "BoschProcess.hpp"
+#include "ViaDistribution.hpp"
+
+using namespace viennals;
+
+// Times the calls of the advect distributions on synthetic point sets,
+// without running the geometric advection. The initial points lie on the
+// surface of the finished trench and the candidates within the bounds of
+// the distribution around them, as in GeometricAdvect.
+
+typedef double NumericType;
+typedef std::array<viennahrle::CoordType, 3> PointType;
+template <int D>
+using DistributionType = GeometricAdvectDistribution<NumericType, D>;
+
+const double gridDelta = 0.05;
+const NumericType maskRadius = 0.6;
+const NumericType etchRate = -0.98;
+const double pi = std::acos(-1.);
+
+template <int D> struct BenchmarkRegime {
+  std::string name;
+  std::function<void(BoschProcess<NumericType, D> &)> setRecipe;
+};
+
+template <int D> std::vector<BenchmarkRegime<D>> getRegimes() {
+  auto base = [](BoschProcess<NumericType, D> &p) {
+    p.setNumCycles(50);
+    p.setIsotropicRate(etchRate * 0.6);
+    p.setCycleEtchDepth(etchRate);
+    p.setStartWidth(2 * maskRadius);
+    p.setBottomWidth(2 * maskRadius);
+    p.setLateralEtchRatio(0.75);
+  };
+
+  std::vector<BenchmarkRegime<D>> regimes;
+  regimes.push_back({"straight", base});
+  regimes.push_back({"taper", [base](BoschProcess<NumericType, D> &p) {
+                       base(p);
+                       p.setBottomWidth(2 * maskRadius * 0.3);
+                       p.setStartOfTapering(-10);
+                     }});
+  regimes.push_back({"sausage", [base](BoschProcess<NumericType, D> &p) {
+                       base(p);
+                       p.setSausageCycling(10);
+                       p.setSausageCycleDepth(2 * etchRate);
+                     }});
+  regimes.push_back({"scheduled", [base](BoschProcess<NumericType, D> &p) {
+                       base(p);
+                       p.addRecipeRamp(50, etchRate * 0.6, etchRate * 0.4,
+                                       etchRate, etchRate * 0.8, 0.75, 0.5);
+                     }});
+  return regimes;
+}
+
+double snap(double x) { return std::round(x / gridDelta) * gridDelta; }
+
+// initial points on the sidewalls and the bottom of the trench, weighted
+// by their area
+template <int D>
+std::vector<PointType>
+makeInitialPoints(const BoschProcessDataType<NumericType> &data,
+                  unsigned numPoints, std::mt19937_64 &generator) {
+  std::uniform_real_distribution<double> uniform(0., 1.);
+  const double depth = std::abs(data.trenchBottom);
+  const double sidewallArea =
+      (D == 2) ? 2 * depth : 2 * pi * data.startWidth * depth;
+  const double bottomArea =
+      (D == 2) ? 2 * data.bottomWidth
+               : pi * data.bottomWidth * data.bottomWidth;
+  const double taperDepth = std::min(std::abs(data.taperStart), depth);
+
+  std::vector<PointType> points(numPoints);
+  for (auto &point : points) {
+    double z, radius;
+    if (uniform(generator) * (sidewallArea + bottomArea) < sidewallArea) {
+      z = -uniform(generator) * depth;
+      const double s =
+          (depth > taperDepth)
+              ? std::max(std::abs(z) - taperDepth, 0.) / (depth - taperDepth)
+              : 0.;
+      radius = data.startWidth + s * (data.bottomWidth - data.startWidth);
+    } else {
+      z = data.trenchBottom;
+      radius = uniform(generator) * data.bottomWidth;
+    }
+    const double angle = 2 * pi * uniform(generator);
+    point = {};
+    if constexpr (D == 2) {
+      point[0] = snap((angle < pi) ? radius : -radius);
+    } else {
+      point[0] = snap(radius * std::cos(angle));
+      point[1] = snap(radius * std::sin(angle));
+    }
+    point[D - 1] = snap(z);
+  }
+  return points;
+}
+
+// one candidate per initial point, on a grid point within the bounds of
+// the distribution
+template <int D>
+std::vector<PointType> makeCandidates(const DistributionType<D> &dist,
+                                      const std::vector<PointType> &initial,
+                                      std::mt19937_64 &generator) {
+  std::uniform_real_distribution<double> uniform(0., 1.);
+  const auto bounds = dist.getBounds();
+  std::vector<PointType> candidates(initial.size());
+  for (unsigned i = 0; i < initial.size(); ++i) {
+    candidates[i] = {};
+    for (unsigned j = 0; j < D; ++j) {
+      const double low = std::min(bounds[2 * j], bounds[2 * j + 1]);
+      const double high = std::max(bounds[2 * j], bounds[2 * j + 1]);
+      candidates[i][j] =
+          snap(initial[i][j] + low + uniform(generator) * (high - low));
+    }
+  }
+  return candidates;
+}
+
+// nanoseconds per call on one thread (best of several repetitions) and
+// million calls per second on all threads
+template <class CallType>
+std::pair<double, double> timeCalls(unsigned numCalls, CallType call) {
+  const unsigned numRepetitions = 5;
+  volatile double sink = 0.;
+
+  double best = std::numeric_limits<double>::max();
+  for (unsigned r = 0; r < numRepetitions; ++r) {
+    double sum = 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < numCalls; ++i)
+      sum += call(i);
+    auto stop = std::chrono::steady_clock::now();
+    sink = sink + sum;
+    best = std::min(best, std::chrono::duration<double>(stop - start).count());
+  }
+
+  double bestParallel = std::numeric_limits<double>::max();
+  for (unsigned r = 0; r < numRepetitions; ++r) {
+    double sum = 0.;
+    auto start = std::chrono::steady_clock::now();
+#pragma omp parallel for reduction(+ : sum)
+    for (int i = 0; i < int(numCalls); ++i)
+      sum += call(i);
+    auto stop = std::chrono::steady_clock::now();
+    sink = sink + sum;
+    bestParallel = std::min(
+        bestParallel, std::chrono::duration<double>(stop - start).count());
+  }
+
+  return {1e9 * best / numCalls, 1e-6 * numCalls / bestParallel};
+}
+
+void printRow(int D, const std::string &regime, const std::string &function,
+              unsigned numCalls, std::pair<double, double> result) {
+  std::cout << std::left << std::setw(4) << (std::to_string(D) + "D")
+            << std::setw(11) << regime << std::setw(38) << function
+            << std::right << std::setw(10) << numCalls << std::fixed
+            << std::setprecision(2) << std::setw(10) << result.first
+            << std::setw(12) << result.second << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+}
+
+template <int D>
+void benchmarkDistribution(const std::string &regime,
+                           const std::string &name,
+                           const DistributionType<D> &dist,
+                           const std::vector<PointType> &initial,
+                           const std::vector<PointType> &candidates) {
+  printRow(D, regime, name + "::isInside", initial.size(),
+           timeCalls(initial.size(), [&](unsigned i) {
+             return double(dist.isInside(initial[i], candidates[i]));
+           }));
+
+  // getSignedDistance is only called for candidates which are inside
+  std::vector<unsigned> inside;
+  for (unsigned i = 0; i < initial.size(); ++i) {
+    if (dist.isInside(initial[i], candidates[i]))
+      inside.push_back(i);
+  }
+  if (inside.empty())
+    return;
+  printRow(D, regime, name + "::getSignedDistance", inside.size(),
+           timeCalls(inside.size(), [&](unsigned i) {
+             return double(dist.getSignedDistance(initial[inside[i]],
+                                                  candidates[inside[i]], 0));
+           }));
+}
+
+template <int D> void benchmark(unsigned numPoints) {
+  for (auto &regime : getRegimes<D>()) {
+    BoschProcess<NumericType, D> process;
+    process.setSubstrate(SmartPointer<Domain<NumericType, D>>::New(gridDelta));
+    regime.setRecipe(process);
+    process.deriveProcessData();
+    auto data = process.getProcessData();
+
+    std::mt19937_64 generator(12345);
+    auto initial = makeInitialPoints<D>(data, numPoints, generator);
+
+    ViaDistribution<NumericType, D> via(data);
+    benchmarkDistribution<D>(regime.name, "ViaDistribution", via, initial,
+                             makeCandidates<D>(via, initial, generator));
+    printRow(D, regime.name, "ViaDistribution::getDepth", numPoints,
+             timeCalls(numPoints,
+                       [&](unsigned i) { return via.getDepth(initial[i]); }));
+
+    BoschDistribution<NumericType, D> bosch(data);
+    benchmarkDistribution<D>(regime.name, "BoschDistribution", bosch,
+                             initial,
+                             makeCandidates<D>(bosch, initial, generator));
+    printRow(D, regime.name, "BoschDistribution::getRadius", numPoints,
+             timeCalls(numPoints, [&](unsigned i) {
+               return bosch.getRadius(initial[i][D - 1]);
+             }));
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned numPoints = 1 << 20;
+  if (argc > 1)
+    numPoints = std::stoul(argv[1]);
+
+  std::cout << "Distribution benchmark with " << numPoints
+            << " initial points, " << omp_get_max_threads()
+            << " threads for the throughput" << std::endl;
+  std::cout << std::left << std::setw(4) << "D" << std::setw(11) << "regime"
+            << std::setw(38) << "function" << std::right << std::setw(10)
+            << "calls" << std::setw(10) << "ns/call" << std::setw(12)
+            << "Mcalls/s" << std::endl;
+
+  benchmark<2>(numPoints);
+  benchmark<3>(numPoints);
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+/// Per-thread event counters for the geometric advect distributions. They
+/// are only used if DRIE_DISTRIBUTION_COUNTERS is defined; otherwise the
+/// DRIE_COUNT macro expands to nothing and the distributions do not even
+/// store a pointer to the counters.
+class DistributionCounters {
+public:
+  enum CounterEnum : unsigned {
+    IS_INSIDE = 0,
+    IS_INSIDE_ACCEPTED,
+    SIGNED_DISTANCE,
+    ZERO_RADIUS,
+    BOX_BRANCH,
+    SPHERE_BRANCH,
+    NUM_COUNTERS
+  };
+
+private:
+  // each thread writes to its own cache line
+  struct alignas(64) ThreadCounters {
+    std::array<std::uint64_t, NUM_COUNTERS> counts = {};
+  };
+
+  std::vector<ThreadCounters> threads;
+  // shared by all threads with a number beyond those at the last clear(),
+  // e.g. of a larger num_threads clause
+  ThreadCounters otherThreads;
+
+  static const char *getName(unsigned counter) {
+    static const char *names[NUM_COUNTERS] = {
+        "isInside",     "  accepted", "getSignedDistance",
+        "  zero radius", "  box",      "  sphere"};
+    return names[counter];
+  }
+
+public:
+  DistributionCounters() : threads(omp_get_max_threads()) {}
+
+  void increment(CounterEnum counter) {
+    const unsigned thread = omp_get_thread_num();
+    if (thread < threads.size()) {
+      ++threads[thread].counts[counter];
+    } else {
+#pragma omp atomic
+      ++otherThreads.counts[counter];
+    }
+  }
+
+  /// Resets all counters for the current number of threads. Call it before
+  /// every advection, so that each thread gets its own counters.
+  void clear() {
+    threads.assign(omp_get_max_threads(), ThreadCounters());
+    otherThreads = ThreadCounters();
+  }
+
+  unsigned getNumberOfThreads() const { return threads.size(); }
+
+  std::uint64_t get(CounterEnum counter, unsigned thread) const {
+    return threads[thread].counts[counter];
+  }
+
+  /// Calls of the threads which had no counters of their own.
+  std::uint64_t getOtherThreads(CounterEnum counter) const {
+    return otherThreads.counts[counter];
+  }
+
+  std::uint64_t get(CounterEnum counter) const {
+    std::uint64_t sum = otherThreads.counts[counter];
+    for (auto &thread : threads)
+      sum += thread.counts[counter];
+    return sum;
+  }
+
+  /// Ratio of the largest number of calls of one thread to the mean over
+  /// all threads which made calls. 1 means perfectly balanced.
+  double getImbalance(CounterEnum counter) const {
+    std::uint64_t maxCount = 0, sum = 0;
+    unsigned numActive = 0;
+    for (auto &thread : threads) {
+      maxCount = std::max(maxCount, thread.counts[counter]);
+      sum += thread.counts[counter];
+      numActive += (thread.counts[counter] > 0);
+    }
+    return (sum > 0) ? double(maxCount) * numActive / sum : 1.;
+  }
+
+  void print(const std::string &name, std::ostream &out = std::cout) const {
+    const auto precision = out.precision();
+    out << name << " counters:" << std::endl;
+    for (unsigned i = 0; i < NUM_COUNTERS; ++i) {
+      const auto counter = CounterEnum(i);
+      out << "  " << std::left << std::setw(20) << getName(i) << std::right
+          << std::setw(14) << get(counter);
+      // sub-counters are given as fraction of their parent counter
+      const unsigned parent =
+          (i == IS_INSIDE_ACCEPTED) ? IS_INSIDE
+          : (i > SIGNED_DISTANCE)   ? SIGNED_DISTANCE
+                                    : i;
+      if (parent != i && get(CounterEnum(parent)) > 0)
+        out << std::fixed << std::setprecision(1) << std::setw(8)
+            << 100. * get(counter) / get(CounterEnum(parent)) << " %";
+      out.unsetf(std::ios::floatfield);
+      out << std::endl;
+    }
+    out << "  per-thread getSignedDistance:";
+    for (auto &thread : threads)
+      out << " " << thread.counts[SIGNED_DISTANCE];
+    if (getOtherThreads(SIGNED_DISTANCE) > 0)
+      out << " (further threads: " << getOtherThreads(SIGNED_DISTANCE) << ")";
+    out << std::endl
+        << "  imbalance (max/mean): " << std::setprecision(3)
+        << getImbalance(SIGNED_DISTANCE) << std::endl;
+    out.precision(precision);
+  }
+};
+
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+#define DRIE_COUNT(counters, counter)                                          \
+  do {                                                                         \
+    if (counters != nullptr)                                                   \
+      counters->increment(DistributionCounters::counter);                      \
+  } while (0)
+#else
+#define DRIE_COUNT(counters, counter)                                          \
+  do {                                                                         \
+  } while (0)
+#endif
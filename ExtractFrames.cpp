@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+
+#include "BoschFrames.hpp"
+#include "MirrorLevelSet.hpp"
+
+using namespace viennals;
+
+typedef double NumericType;
+
+// Writes the surface of every frame of a frame file, e.g. written by DEM2D
+// with frameInterval > 0, to frame_<cycle>.vtp. With "mirror", the frames
+// of a mirror symmetric domain are mirrored about their lower lateral
+// bounds first.
+template <int D> int extract(const std::string &fileName, bool isMirror) {
+  BoschFrameReader<NumericType, D> reader(fileName);
+  if (!reader.apply())
+    return 1;
+
+  const auto grid = reader.getGrid();
+  std::array<NumericType, 3> symmetryOrigin = {};
+  viennahrle::IndexType minIndex[D], maxIndex[D];
+  typename Domain<NumericType, D>::BoundaryType boundaryCons[D];
+  for (unsigned i = 0; i < D; ++i) {
+    minIndex[i] = grid.getMinGridPoint(i);
+    maxIndex[i] = grid.getMaxGridPoint(i);
+    boundaryCons[i] = grid.getBoundaryConditions(i);
+    if (isMirror && i < D - 1) {
+      symmetryOrigin[i] = minIndex[i] * grid.getGridDelta();
+      minIndex[i] = 2 * minIndex[i] - maxIndex[i];
+    }
+  }
+  const typename Domain<NumericType, D>::GridType fullGrid(
+      minIndex, maxIndex, grid.getGridDelta(), boundaryCons);
+
+  for (std::size_t frame = 0; frame < reader.getNumberOfFrames(); ++frame) {
+    auto levelSet = reader.getFrame(frame);
+    if (isMirror) {
+      auto fullLevelSet = SmartPointer<Domain<NumericType, D>>::New(fullGrid);
+      MirrorLevelSet<NumericType, D> mirror(levelSet, fullLevelSet);
+      mirror.setSymmetryOrigin(symmetryOrigin);
+      mirror.apply();
+      levelSet = fullLevelSet;
+    }
+
+    const auto outputName =
+        "frame_" + std::to_string(reader.getCycle(frame)) + ".vtp";
+    auto mesh = SmartPointer<Mesh<NumericType>>::New();
+    ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+    VTKWriter(mesh, outputName).apply();
+    std::cout << "Wrote " << outputName << std::endl;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <frame file> [mirror]"
+              << std::endl;
+    return 1;
+  }
+  const std::string fileName = argv[1];
+  const bool isMirror = argc > 2 && std::string(argv[2]) == "mirror";
+
+  switch (BoschFrameHeader::readDimension(fileName)) {
+  case 2:
+    return extract<2>(fileName, isMirror);
+  case 3:
+    return extract<3>(fileName, isMirror);
+  default:
+    std::cout << "Cannot read " << fileName << std::endl;
+    return 1;
+  }
+}
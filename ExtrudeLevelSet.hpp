@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+#include <lsMesh.hpp>
+#include <vcLogger.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Extrudes a 2D (x, z) level set along y into a 3D level set, so that
+/// structures whose cross-section does not change along a line, e.g. line
+/// trenches, can be simulated in 2D and only converted to 3D when needed.
+/// The extrusion fills the whole y extent of the 3D domain, which sets the
+/// length of the line. Both level sets must have the same grid delta, and
+/// the 2D level set should cover the x extent of the 3D domain.
+template <class T> class ExtrudeLevelSet {
+  using LSPtr2DType = viennals::SmartPointer<viennals::Domain<T, 2>>;
+  using LSPtr3DType = viennals::SmartPointer<viennals::Domain<T, 3>>;
+
+  LSPtr2DType profile;
+  LSPtr3DType levelSet;
+  T lineOrigin = 0.;
+
+public:
+  ExtrudeLevelSet(LSPtr2DType passedProfile, LSPtr3DType passedLevelSet)
+      : profile(passedProfile), levelSet(passedLevelSet) {}
+
+  /// x coordinate in the 3D domain of x = 0 of the profile. Rounded to the
+  /// grid.
+  void setLineOrigin(T origin) { lineOrigin = origin; }
+
+  void apply() {
+    const auto &grid = levelSet->getGrid();
+    const double gridDelta = grid.getGridDelta();
+    if (std::abs(profile->getGrid().getGridDelta() - gridDelta) >
+        1e-6 * gridDelta) {
+      viennacore::Logger::getInstance().addError(
+          "ExtrudeLevelSet: Profile and level set must have the same "
+          "gridDelta!");
+      return;
+    }
+
+    const int offset = std::round(lineOrigin / gridDelta);
+    const int xMin = grid.getMinGridPoint(0), xMax = grid.getMaxGridPoint(0);
+    const T valueLimit = 1.;
+
+    // the points of the profile in the x range of the 3D domain
+    std::vector<std::pair<std::array<int, 2>, T>> profilePoints;
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, 2>::DomainType>
+             it(profile->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || std::abs(it.getValue()) > valueLimit)
+        continue;
+      const int x = it.getStartIndices()[0] + offset;
+      if (x < xMin || x > xMax)
+        continue;
+      profilePoints.push_back(
+          std::make_pair(std::array<int, 2>{x, it.getStartIndices()[1]},
+                         it.getValue()));
+    }
+    if (profilePoints.empty()) {
+      viennacore::Logger::getInstance()
+          .addWarning("ExtrudeLevelSet: Profile is empty.")
+          .print();
+      return;
+    }
+
+    if (profile->getGrid().getMinGridPoint(0) + offset > xMin ||
+        profile->getGrid().getMaxGridPoint(0) + offset < xMax) {
+      viennacore::Logger::getInstance()
+          .addWarning("ExtrudeLevelSet: Profile does not cover the x "
+                      "extent of the 3D domain. Increase its lateral "
+                      "extent.")
+          .print();
+    }
+
+    const int yMin = grid.getMinGridPoint(1);
+    const int numY = grid.getMaxGridPoint(1) - yMin + 1;
+    std::vector<typename viennals::Domain<T, 3>::PointValueVectorType>
+        rowPoints(numY);
+
+#pragma omp parallel for schedule(static)
+    for (int row = 0; row < numY; ++row) {
+      auto &points = rowPoints[row];
+      points.reserve(profilePoints.size());
+      for (auto &point : profilePoints) {
+        viennahrle::Index<3> index;
+        index[0] = point.first[0];
+        index[1] = yMin + row;
+        index[2] = point.first[1];
+        points.push_back(std::make_pair(index, point.second));
+      }
+    }
+
+    typename viennals::Domain<T, 3>::PointValueVectorType pointData;
+    pointData.reserve(std::size_t(numY) * profilePoints.size());
+    for (auto &points : rowPoints) {
+      pointData.insert(pointData.end(), points.begin(), points.end());
+      points = typename viennals::Domain<T, 3>::PointValueVectorType();
+    }
+
+    levelSet->insertPoints(pointData);
+    levelSet->getDomain().segment();
+    levelSet->finalize(2);
+    if (profile->getLevelSetWidth() > 2)
+      viennals::Expand<T, 3>(levelSet, profile->getLevelSetWidth()).apply();
+  }
+};
+
+/// Extrudes the line mesh of a 2D (x, z) surface, e.g. from
+/// viennals::ToSurfaceMesh, along y into a 3D triangle mesh between yMin
+/// and yMax. Much cheaper than extruding the level set if only the
+/// surface is needed.
+template <class T> class ExtrudeMesh {
+  using MeshPtrType = viennals::SmartPointer<viennals::Mesh<T>>;
+
+  MeshPtrType profileMesh;
+  MeshPtrType mesh;
+  T lineOrigin = 0.;
+  T yMin = 0.;
+  T yMax = 1.;
+
+public:
+  ExtrudeMesh(MeshPtrType passedProfileMesh, MeshPtrType passedMesh)
+      : profileMesh(passedProfileMesh), mesh(passedMesh) {}
+
+  /// x coordinate in 3D of x = 0 of the profile.
+  void setLineOrigin(T origin) { lineOrigin = origin; }
+
+  /// Range of the line along y.
+  void setExtent(T minimum, T maximum) {
+    yMin = minimum;
+    yMax = maximum;
+  }
+
+  void apply() {
+    mesh->clear();
+    const auto &nodes = profileMesh->nodes;
+    for (auto y : {yMin, yMax}) {
+      for (auto &node : nodes)
+        mesh->insertNextNode({node[0] + lineOrigin, y, node[1]});
+    }
+    // the positive side of a line is on its right; keep it on the
+    // outside of the triangles
+    const unsigned numNodes = nodes.size();
+    for (auto &line : profileMesh->lines) {
+      const unsigned a0 = line[0], b0 = line[1];
+      const unsigned a1 = a0 + numNodes, b1 = b0 + numNodes;
+      mesh->insertNextTriangle({a0, b1, b0});
+      mesh->insertNextTriangle({a0, a1, b1});
+    }
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(ExtrudeLevelSet);
+DRIE_PRECOMPILE_PRECISION(ExtrudeMesh);
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include <lsDomain.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+#include "MirrorLevelSet.hpp"
+
+/// Computes the smallest lateral domain bounds around a single mask
+/// opening of MakeMask which still contain everything the process etches:
+/// the opening itself, the maximum lateral reach of the etch beyond the
+/// opening edge (see BoschProcess::getMaximumLateralReach) and a margin of
+/// a few grid cells for the narrow band. The vertical bounds are kept as
+/// given. Since the lateral boundaries are reflective and only cut through
+/// masked material, the result of the process should not change; mode
+/// "fitted" of GoldenGeometry checks this against the full domain. Without
+/// fitting, the lateral bounds are the hand-picked extent of the models.
+template <class T, int D> class FitDomainBounds {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  T gridDelta = 1.;
+  std::array<T, 3> maskOrigin = {};
+  T maskRadius = 0.;
+  T lateralReach = 0.;
+  T verticalMin = 0.;
+  T verticalMax = 0.;
+  unsigned marginCells = 4;
+  bool isFitted = true;
+  T lateralExtent = 0.;
+  bool isMirrorSymmetric = false;
+
+  std::array<T, 3> symmetryOrigin = {};
+  std::array<double, 2 * D> bounds = {};
+  std::array<double, 2 * D> fullBounds = {};
+
+  LSPtrType makeDomain(std::array<double, 2 * D> domainBounds) const {
+    typename viennals::Domain<T, D>::BoundaryType boundaryCons[D];
+    for (unsigned i = 0; i < D - 1; ++i)
+      boundaryCons[i] = viennals::BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+    boundaryCons[D - 1] = viennals::BoundaryConditionEnum::INFINITE_BOUNDARY;
+    return LSPtrType::New(domainBounds.data(), boundaryCons, gridDelta);
+  }
+
+public:
+  FitDomainBounds() {}
+
+  FitDomainBounds(T passedGridDelta, T passedMaskRadius,
+                  T passedLateralReach)
+      : gridDelta(passedGridDelta), maskRadius(passedMaskRadius),
+        lateralReach(passedLateralReach) {}
+
+  void setGridDelta(T passedGridDelta) { gridDelta = passedGridDelta; }
+
+  void setMaskOrigin(std::array<T, 3> origin) { maskOrigin = origin; }
+
+  /// Half width of the mask opening, as passed to MakeMask.
+  void setMaskRadius(T radius) { maskRadius = radius; }
+
+  /// Largest lateral distance from the opening edge etched by the process.
+  void setLateralReach(T reach) { lateralReach = reach; }
+
+  void setVerticalBounds(T minimum, T maximum) {
+    verticalMin = minimum;
+    verticalMax = maximum;
+  }
+
+  /// Number of grid cells between the etched region and the lateral
+  /// boundaries. Defaults to 4.
+  void setMarginCells(unsigned cells) { marginCells = cells; }
+
+  /// Fit the lateral bounds to the etched region. Otherwise, they are the
+  /// mask origin +- the extent of setLateralExtent(). Defaults to true.
+  void setFitted(bool fitted) { isFitted = fitted; }
+
+  /// Lateral half width of the domain if it is not fitted.
+  void setLateralExtent(T extent) { lateralExtent = extent; }
+
+  /// Only keep the half (2D) or quarter (3D) of the domain on the
+  /// positive side of the mask origin. The lateral boundaries through the
+  /// origin are reflective, so they act as symmetry planes. The mask
+  /// origin is rounded to the grid. Use makeFullLevelSet() to reconstruct
+  /// the full level sets.
+  void setMirrorSymmetric(bool mirrorSymmetric) {
+    isMirrorSymmetric = mirrorSymmetric;
+  }
+
+  void apply() {
+    // the via pass etches one grid cell beyond the opening
+    const T halfWidth =
+        isFitted ? maskRadius + lateralReach + (1 + marginCells) * gridDelta
+                 : lateralExtent;
+    for (unsigned i = 0; i < D - 1; ++i) {
+      // MakeMask centres the opening of 2D masks at x = 0
+      T centre = (D == 2) ? 0. : maskOrigin[i];
+      if (isMirrorSymmetric)
+        centre = std::round(centre / gridDelta) * gridDelta;
+      symmetryOrigin[i] = centre;
+      fullBounds[2 * i] =
+          std::floor((centre - halfWidth) / gridDelta) * gridDelta;
+      fullBounds[2 * i + 1] =
+          std::ceil((centre + halfWidth) / gridDelta) * gridDelta;
+      bounds[2 * i] = isMirrorSymmetric ? centre : fullBounds[2 * i];
+      bounds[2 * i + 1] = fullBounds[2 * i + 1];
+    }
+    fullBounds[2 * D - 2] = bounds[2 * D - 2] = verticalMin;
+    fullBounds[2 * D - 1] = bounds[2 * D - 1] = verticalMax;
+  }
+
+  /// Bounds of the simulated domain.
+  const std::array<double, 2 * D> &getBounds() const { return bounds; }
+
+  /// Bounds of the whole structure, which differ from getBounds() only
+  /// for mirror symmetric domains.
+  const std::array<double, 2 * D> &getFullBounds() const {
+    return fullBounds;
+  }
+
+  /// New empty level set with the fitted bounds, reflective lateral and
+  /// infinite vertical boundary conditions, as used by the models.
+  LSPtrType makeDomain() const { return makeDomain(bounds); }
+
+  /// New empty level set with the full bounds, e.g. for mirroring the
+  /// result of a mirror symmetric domain.
+  LSPtrType makeFullDomain() const { return makeDomain(fullBounds); }
+
+  /// Level set of the whole structure: the mirror images of a level set
+  /// on the fitted domain on a new level set from makeFullDomain(), or
+  /// the passed level set itself if the domain is not mirror symmetric.
+  LSPtrType makeFullLevelSet(LSPtrType levelSet) const {
+    if (!isMirrorSymmetric)
+      return levelSet;
+    auto fullLevelSet = makeFullDomain();
+    MirrorLevelSet<T, D> mirror(levelSet, fullLevelSet);
+    mirror.setSymmetryOrigin(symmetryOrigin);
+    mirror.apply();
+    return fullLevelSet;
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(FitDomainBounds);
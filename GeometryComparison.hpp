@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Compares a level set to a reference level set on the same grid. The
+/// comparison is evaluated in parallel over z and yields the volume of
+/// the symmetric difference, the maximum deviation of one surface from
+/// the other and the critical dimension (CD) error per depth. The CD is
+/// the width of the etched region along the x-axis through the CD origin,
+/// measured in every row of grid points below the top surface.
+template <class T, int D> class GeometryComparison {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+  using IteratorType = viennahrle::ConstSparseIterator<
+      typename viennals::Domain<T, D>::DomainType>;
+
+  LSPtrType reference;
+  LSPtrType levelSet;
+  std::array<T, 3> cdOrigin = {};
+  T surfaceHeight = 0.;
+  int comparisonWidth = 8;
+
+  double symmetricDifference = 0.;
+  double maxSurfaceDeviation = 0.;
+  std::vector<T> cdDepths;
+  std::vector<T> referenceCD;
+  std::vector<T> levelSetCD;
+
+  // volume fraction of material at a grid point
+  static T materialFraction(T value) {
+    return std::min(std::max(T(0.5) - value, T(0)), T(1));
+  }
+
+public:
+  GeometryComparison() {}
+
+  GeometryComparison(LSPtrType passedReference, LSPtrType passedLevelSet)
+      : reference(passedReference), levelSet(passedLevelSet) {}
+
+  void setReference(LSPtrType passedReference) {
+    reference = passedReference;
+  }
+
+  void setLevelSet(LSPtrType passedLevelSet) { levelSet = passedLevelSet; }
+
+  /// Lateral position of the line along which the CD is measured.
+  void setCDOrigin(std::array<T, 3> origin) { cdOrigin = origin; }
+
+  /// The CD is only measured below this height. Defaults to 0.
+  void setSurfaceHeight(T height) { surfaceHeight = height; }
+
+  /// Width of the narrow band in which surface deviations are resolved.
+  /// Larger deviations are reported as half this width times gridDelta.
+  void setComparisonWidth(int width) { comparisonWidth = width; }
+
+  /// Volume (area in 2D) of the region which is inside one level set but
+  /// outside the other.
+  double getSymmetricDifference() const { return symmetricDifference; }
+
+  /// Largest distance of a surface point of either level set from the
+  /// surface of the other one.
+  double getMaxSurfaceDeviation() const { return maxSurfaceDeviation; }
+
+  const std::vector<T> &getCDDepths() const { return cdDepths; }
+
+  const std::vector<T> &getReferenceCD() const { return referenceCD; }
+
+  const std::vector<T> &getLevelSetCD() const { return levelSetCD; }
+
+  double getMaxCDError() const {
+    double maxError = 0.;
+    for (unsigned i = 0; i < cdDepths.size(); ++i)
+      maxError = std::max(maxError,
+                          double(std::abs(levelSetCD[i] - referenceCD[i])));
+    return maxError;
+  }
+
+  double getRMSCDError() const {
+    if (cdDepths.empty())
+      return 0.;
+    double sum = 0.;
+    for (unsigned i = 0; i < cdDepths.size(); ++i) {
+      const double error = levelSetCD[i] - referenceCD[i];
+      sum += error * error;
+    }
+    return std::sqrt(sum / cdDepths.size());
+  }
+
+  void apply() {
+    const auto &grid = reference->getGrid();
+    const double gridDelta = grid.getGridDelta();
+
+    // expanded copies resolve distances beyond the original narrow band
+    auto expandedReference = LSPtrType::New(reference);
+    auto expandedLevelSet = LSPtrType::New(levelSet);
+    viennals::Expand<T, D>(expandedReference, comparisonWidth).apply();
+    viennals::Expand<T, D>(expandedLevelSet, comparisonWidth).apply();
+
+    // bounding box of all defined points
+    std::array<int, D> minIndex, maxIndex;
+    minIndex.fill(std::numeric_limits<int>::max());
+    maxIndex.fill(std::numeric_limits<int>::lowest());
+    for (auto &ls : {expandedReference, expandedLevelSet}) {
+      for (IteratorType it(ls->getDomain()); !it.isFinished(); ++it) {
+        if (!it.isDefined())
+          continue;
+        for (unsigned i = 0; i < D; ++i) {
+          minIndex[i] = std::min(minIndex[i], it.getStartIndices()[i]);
+          maxIndex[i] = std::max(maxIndex[i], it.getStartIndices()[i]);
+        }
+      }
+    }
+    if (maxIndex[D - 1] < minIndex[D - 1])
+      return;
+
+    int cdLine = 0;
+    if constexpr (D == 3)
+      cdLine = std::round(cdOrigin[1] / gridDelta);
+    const T maxDeviation = comparisonWidth / 2.;
+
+    const int numRows = maxIndex[D - 1] - minIndex[D - 1] + 1;
+    std::vector<double> rowDifference(numRows, 0.);
+    std::vector<T> rowDeviation(numRows, 0.);
+    std::vector<T> rowReferenceCD(numRows, 0.), rowLevelSetCD(numRows, 0.);
+
+#pragma omp parallel
+    {
+      IteratorType itA(expandedReference->getDomain());
+      IteratorType itB(expandedLevelSet->getDomain());
+
+#pragma omp for schedule(dynamic)
+      for (int row = 0; row < numRows; ++row) {
+        viennahrle::Index<D> index;
+        index[D - 1] = row + minIndex[D - 1];
+        const int yMin = (D == 3) ? minIndex[1] : 0;
+        const int yMax = (D == 3) ? maxIndex[1] : 0;
+        for (int y = yMin; y <= yMax; ++y) {
+          if constexpr (D == 3)
+            index[1] = y;
+          for (int x = minIndex[0]; x <= maxIndex[0]; ++x) {
+            index[0] = x;
+            itA.goToIndicesSequential(index);
+            itB.goToIndicesSequential(index);
+            const T valueA = itA.getValue();
+            const T valueB = itB.getValue();
+
+            const T fractionA = materialFraction(valueA);
+            const T fractionB = materialFraction(valueB);
+            rowDifference[row] += std::abs(fractionA - fractionB);
+
+            // distance between the surfaces at surface points of either
+            if (std::abs(valueA) <= 0.5 || std::abs(valueB) <= 0.5) {
+              const T deviation =
+                  (itA.isDefined() && itB.isDefined())
+                      ? std::min(std::abs(valueA - valueB), maxDeviation)
+                      : maxDeviation;
+              rowDeviation[row] = std::max(rowDeviation[row], deviation);
+            }
+
+            if (y == cdLine) {
+              rowReferenceCD[row] += 1 - fractionA;
+              rowLevelSetCD[row] += 1 - fractionB;
+            }
+          }
+        }
+      }
+    }
+
+    symmetricDifference = 0.;
+    maxSurfaceDeviation = 0.;
+    cdDepths.clear();
+    referenceCD.clear();
+    levelSetCD.clear();
+    for (int row = 0; row < numRows; ++row) {
+      symmetricDifference += rowDifference[row];
+      maxSurfaceDeviation =
+          std::max(maxSurfaceDeviation, double(rowDeviation[row]));
+      const T z = (row + minIndex[D - 1]) * gridDelta;
+      if (z < surfaceHeight) {
+        cdDepths.push_back(z);
+        referenceCD.push_back(rowReferenceCD[row] * gridDelta);
+        levelSetCD.push_back(rowLevelSetCD[row] * gridDelta);
+      }
+    }
+    symmetricDifference *= std::pow(gridDelta, D);
+    maxSurfaceDeviation *= gridDelta;
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(GeometryComparison);
@@ -0,0 +1,516 @@
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+
+#include <lsBooleanOperation.hpp>
+#include <lsGeometricAdvect.hpp>
+#include <lsMakeGeometry.hpp>
+#include <lsReader.hpp>
+#include <lsToSurfaceMesh.hpp>
+#include <lsWriter.hpp>
+
+#include "BoschProcess.hpp"
+#include "DecimateSurfaceMesh.hpp"
+#include "FitDomainBounds.hpp"
+#include "GeometryComparison.hpp"
+#include "MakeMask.hpp"
+#include "MirrorLevelSet.hpp"
+#include "ModelRecipes.hpp"
+#include "PillarMask.hpp"
+#include "RevolveLevelSet.hpp"
+
+using namespace viennals;
+
+typedef double NumericType;
+template <int D> using LSPtr = SmartPointer<Domain<NumericType, D>>;
+
+// Geometry and recipe of one of the models, see ModelRecipes.hpp.
+template <int D> struct GoldenCase {
+  std::string name;
+  double gridDelta;
+  double extent;
+  std::function<void(LSPtr<D>, LSPtr<D>)> makeMask;
+  std::function<void(BoschProcess<NumericType, D> &)> setRecipe;
+  // recipe of the (r, z) profile of a circular via
+  std::function<void(BoschProcess<NumericType, 2> &)> setProfileRecipe;
+  // single opening centred at the origin
+  bool isMirrorSymmetric = false;
+  NumericType maskRadius = 0.;
+};
+
+// A way of computing the final substrate of a case. run returns the
+// substrate and sets the runtime of the part of the mode which is timed.
+template <int D> struct GoldenMode {
+  std::string name;
+  std::function<bool(const GoldenCase<D> &)> isApplicable;
+  std::function<LSPtr<D>(const GoldenCase<D> &, double &)> run;
+  // largest surface deviation from the golden geometry in grid cells for
+  // the mode to pass; negative if the deviation is only reported
+  double tolerance = -1.;
+};
+
+double timeRun(std::function<void()> run) {
+  auto start = std::chrono::high_resolution_clock::now();
+  run();
+  auto stop = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double>(stop - start).count();
+}
+
+template <int D>
+void makeDomains(const GoldenCase<D> &c, LSPtr<D> &substrate, LSPtr<D> &mask,
+                 bool isReduced = false) {
+  double bounds[2 * D];
+  BoundaryConditionEnum boundaryCons[D];
+  for (unsigned i = 0; i < D; ++i) {
+    bounds[2 * i] = (isReduced && i < D - 1) ? 0. : -c.extent;
+    bounds[2 * i + 1] = c.extent;
+    boundaryCons[i] = BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+  }
+  boundaryCons[D - 1] = BoundaryConditionEnum::INFINITE_BOUNDARY;
+  mask = LSPtr<D>::New(bounds, boundaryCons, c.gridDelta);
+  substrate = LSPtr<D>::New(bounds, boundaryCons, c.gridDelta);
+}
+
+// the unmodified models
+template <int D>
+LSPtr<D> runReference(const GoldenCase<D> &c, double &seconds) {
+  LSPtr<D> substrate, mask;
+  makeDomains(c, substrate, mask);
+  c.makeMask(substrate, mask);
+  BoschProcess<NumericType, D> process(substrate, mask);
+  c.setRecipe(process);
+  seconds = timeRun([&]() { process.apply(); });
+  return substrate;
+}
+
+// the second of two runs sharing a cache; only the second run is timed
+template <int D> LSPtr<D> runCached(const GoldenCase<D> &c, double &seconds) {
+  auto cache = SmartPointer<BoschProcessCache<NumericType, D>>::New();
+  LSPtr<D> substrate;
+  for (unsigned i = 0; i < 2; ++i) {
+    LSPtr<D> mask;
+    makeDomains(c, substrate, mask);
+    c.makeMask(substrate, mask);
+    BoschProcess<NumericType, D> process(substrate, mask);
+    c.setRecipe(process);
+    process.setCache(cache);
+    seconds = timeRun([&]() { process.apply(); });
+  }
+  return substrate;
+}
+
+// only the lateral half (2D) or quarter (3D) of the domain is simulated
+// and mirrored afterwards
+template <int D>
+LSPtr<D> runMirrored(const GoldenCase<D> &c, double &seconds) {
+  LSPtr<D> reduced, mask;
+  makeDomains(c, reduced, mask, true);
+  c.makeMask(reduced, mask);
+  BoschProcess<NumericType, D> process(reduced, mask);
+  c.setRecipe(process);
+
+  LSPtr<D> substrate, fullMask;
+  makeDomains(c, substrate, fullMask);
+  seconds = timeRun([&]() {
+    process.apply();
+    MirrorLevelSet<NumericType, D>(reduced, substrate).apply();
+  });
+  return substrate;
+}
+
+// lateral domain fitted to the etched region with FitDomainBounds; the
+// result is completed with the unetched substrate of the full domain
+// outside the fitted bounds
+template <int D> LSPtr<D> runFitted(const GoldenCase<D> &c, double &seconds) {
+  BoschProcess<NumericType, D> process;
+  c.setRecipe(process);
+  FitDomainBounds<NumericType, D> domainFit(
+      c.gridDelta, c.maskRadius, process.getMaximumLateralReach());
+  domainFit.setVerticalBounds(-c.extent, c.extent);
+  domainFit.apply();
+
+  auto fitted = domainFit.makeDomain();
+  auto mask = domainFit.makeDomain();
+  c.makeMask(fitted, mask);
+  process.setSubstrate(fitted);
+  process.setMask(mask);
+  seconds = timeRun([&]() { process.apply(); });
+
+  LSPtr<D> initial, fullMask;
+  makeDomains(c, initial, fullMask);
+  c.makeMask(initial, fullMask);
+
+  const auto &fittedGrid = fitted->getGrid();
+  auto isFitted = [&](const viennahrle::Index<D> &index) {
+    for (unsigned i = 0; i < D - 1; ++i) {
+      if (index[i] < fittedGrid.getMinGridPoint(i) ||
+          index[i] > fittedGrid.getMaxGridPoint(i))
+        return false;
+    }
+    return true;
+  };
+
+  const NumericType valueLimit = 1.;
+  typename Domain<NumericType, D>::PointValueVectorType pointData;
+  for (auto &ls : {fitted, initial}) {
+    for (viennahrle::ConstSparseIterator<
+             typename Domain<NumericType, D>::DomainType>
+             it(ls->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || std::abs(it.getValue()) > valueLimit ||
+          (ls == initial && isFitted(it.getStartIndices())))
+        continue;
+      pointData.push_back(std::make_pair(it.getStartIndices(), it.getValue()));
+    }
+  }
+
+  LSPtr<D> substrate;
+  makeDomains(c, substrate, fullMask);
+  substrate->insertPoints(pointData);
+  substrate->getDomain().segment();
+  substrate->finalize(2);
+  return substrate;
+}
+
+// circular vias simulated in 2D and revolved into 3D
+LSPtr<3> runAxisymmetric(const GoldenCase<3> &c, double &seconds) {
+  GoldenCase<2> profileCase;
+  profileCase.gridDelta = c.gridDelta;
+  profileCase.extent =
+      std::ceil(c.extent * std::sqrt(2.) / c.gridDelta + 2) * c.gridDelta;
+  LSPtr<2> profile, profileMask;
+  makeDomains(profileCase, profile, profileMask);
+
+  std::array<NumericType, 3> maskOrigin = {};
+  MakeMask<NumericType, 2> maskCreator(profile, profileMask);
+  maskCreator.setMaskOrigin(maskOrigin);
+  maskCreator.setMaskRadius(c.maskRadius);
+  maskCreator.apply();
+
+  BoschProcess<NumericType, 2> process(profile, profileMask);
+  c.setProfileRecipe(process);
+
+  LSPtr<3> substrate, mask;
+  makeDomains(c, substrate, mask);
+  seconds = timeRun([&]() {
+    process.apply();
+    RevolveLevelSet<NumericType>(profile, substrate).apply();
+  });
+  return substrate;
+}
+
+template <int D>
+std::function<void(LSPtr<D>, LSPtr<D>)> holeMask(NumericType maskRadius) {
+  return [maskRadius](LSPtr<D> substrate, LSPtr<D> mask) {
+    std::array<NumericType, 3> maskOrigin = {};
+    MakeMask<NumericType, D> maskCreator(substrate, mask);
+    maskCreator.setMaskOrigin(maskOrigin);
+    maskCreator.setMaskRadius(maskRadius);
+    maskCreator.apply();
+  };
+}
+
+std::vector<GoldenCase<2>> getCases2D() {
+  std::vector<GoldenCase<2>> cases;
+
+  GoldenCase<2> dem2d;
+  dem2d.name = "DEM2D";
+  dem2d.gridDelta = DEM2DRecipe::getGridDelta<NumericType, 2>();
+  dem2d.extent = DEM2DRecipe::extent;
+  dem2d.maskRadius = DEM2DRecipe::maskRadius;
+  dem2d.isMirrorSymmetric = true;
+  dem2d.makeMask = holeMask<2>(dem2d.maskRadius);
+  dem2d.setRecipe = DEM2DRecipe::apply<NumericType, 2>;
+  cases.push_back(dem2d);
+
+  GoldenCase<2> dream;
+  dream.name = "DREAM";
+  dream.gridDelta = DREAMRecipe::gridDelta;
+  dream.extent = DREAMRecipe::extent;
+  dream.maskRadius = DREAMRecipe::maskRadius;
+  dream.isMirrorSymmetric = true;
+  dream.makeMask = holeMask<2>(dream.maskRadius);
+  dream.setRecipe = [](BoschProcess<NumericType, 2> &p) {
+    DREAMRecipe::apply(p, DREAMRecipe::getBottomFraction(1.5));
+  };
+  cases.push_back(dream);
+
+  // a single opening etched with the sausage recipe of DREM3D, so that the
+  // fitted domain is checked against the reach of the sausage cycles
+  GoldenCase<2> sausage;
+  sausage.name = "Sausage2D";
+  sausage.gridDelta = DREM3DRecipe::gridDelta;
+  sausage.extent = DREM3DRecipe::extent;
+  sausage.maskRadius = DREM3DRecipe::maskRadius;
+  sausage.isMirrorSymmetric = true;
+  sausage.makeMask = holeMask<2>(sausage.maskRadius);
+  sausage.setRecipe = DREM3DRecipe::apply<NumericType, 2>;
+  cases.push_back(sausage);
+
+  return cases;
+}
+
+std::vector<GoldenCase<3>> getCases3D() {
+  std::vector<GoldenCase<3>> cases;
+
+  GoldenCase<3> dem3d;
+  dem3d.name = "DEM3D";
+  dem3d.gridDelta = DEM3DRecipe::gridDelta;
+  dem3d.extent = DEM3DRecipe::extent;
+  dem3d.maskRadius = DEM3DRecipe::maskRadius;
+  dem3d.isMirrorSymmetric = true;
+  dem3d.makeMask = holeMask<3>(dem3d.maskRadius);
+  dem3d.setRecipe = DEM3DRecipe::apply<NumericType, 3>;
+  dem3d.setProfileRecipe = DEM3DRecipe::apply<NumericType, 2>;
+  cases.push_back(dem3d);
+
+  GoldenCase<3> drem3d;
+  drem3d.name = "DREM3D";
+  drem3d.gridDelta = DREM3DRecipe::gridDelta;
+  drem3d.extent = DREM3DRecipe::extent;
+  drem3d.maskRadius = DREM3DRecipe::maskRadius;
+  drem3d.makeMask = [](LSPtr<3> substrate, LSPtr<3> mask) {
+    std::array<NumericType, 3> maskOrigin = {};
+    PillarMask<NumericType, 3> maskCreator(substrate, mask);
+    maskCreator.setMaskOrigin(maskOrigin);
+    maskCreator.setMaskRadius(DREM3DRecipe::maskRadius);
+    maskCreator.setLineDistance(DREM3DRecipe::lineDistance);
+    maskCreator.apply();
+  };
+  drem3d.setRecipe = DREM3DRecipe::apply<NumericType, 3>;
+  cases.push_back(drem3d);
+
+  return cases;
+}
+
+template <int D> std::vector<GoldenMode<D>> getModes() {
+  auto always = [](const GoldenCase<D> &) { return true; };
+  std::vector<GoldenMode<D>> modes;
+  // the reference, the cache, the fitted domain and the mirrored half or
+  // quarter domain have to reproduce the golden geometry
+  modes.push_back({"reference", always, runReference<D>, 1e-3});
+  modes.push_back({"cached", always, runCached<D>, 1e-3});
+  modes.push_back({"fitted",
+                   [](const GoldenCase<D> &c) { return c.isMirrorSymmetric; },
+                   runFitted<D>, 1e-3});
+  modes.push_back({"mirrored",
+                   [](const GoldenCase<D> &c) { return c.isMirrorSymmetric; },
+                   runMirrored<D>, 1e-3});
+  if constexpr (D == 3) {
+    modes.push_back(
+        {"axisymmetric",
+         [](const GoldenCase<3> &c) { return bool(c.setProfileRecipe); },
+         runAxisymmetric});
+  }
+  return modes;
+}
+
+// tolerance of the coarsest level of detail of DEM3D and DREM3D and a
+// tighter deviation bound, so that the bound limits the decimation, in
+// grid cells
+constexpr double decimationTolerance = 0.5;
+constexpr double decimationMaxDeviation = 0.25;
+
+// decimate the surface of the substrate and return the largest distance
+// of a vertex of the surface to the decimated surface, or a value above
+// maxDeviation if it is further
+template <int D>
+double getDecimationDeviation(LSPtr<D> substrate, double tolerance,
+                              double maxDeviation) {
+  using DecimateType = DecimateSurfaceMesh<NumericType>;
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, D>(substrate, mesh).apply();
+  auto decimated = SmartPointer<Mesh<NumericType>>::New();
+  DecimateType decimate(mesh, decimated, tolerance);
+  decimate.setMaximumDeviation(maxDeviation);
+  decimate.apply();
+
+  // bin the decimated elements into cells, each into all cells which it
+  // is closer to than maxDeviation, so the cell of a vertex holds all
+  // elements within maxDeviation of it
+  const double cellSize = 8 * substrate->getGrid().getGridDelta();
+  using CellType = std::array<long, 3>;
+  auto getCell = [cellSize](const std::array<NumericType, 3> &point,
+                            double offset) {
+    CellType cell;
+    for (unsigned i = 0; i < 3; ++i)
+      cell[i] = std::floor((point[i] + offset) / cellSize);
+    return cell;
+  };
+  std::map<CellType, std::vector<unsigned>> cells;
+  auto insert = [&](unsigned element, const auto &nodeIds) {
+    CellType lower = getCell(decimated->nodes[nodeIds[0]], -maxDeviation);
+    CellType upper = getCell(decimated->nodes[nodeIds[0]], maxDeviation);
+    for (auto id : nodeIds) {
+      const auto nodeLower = getCell(decimated->nodes[id], -maxDeviation);
+      const auto nodeUpper = getCell(decimated->nodes[id], maxDeviation);
+      for (unsigned i = 0; i < 3; ++i) {
+        lower[i] = std::min(lower[i], nodeLower[i]);
+        upper[i] = std::max(upper[i], nodeUpper[i]);
+      }
+    }
+    CellType cell;
+    for (cell[0] = lower[0]; cell[0] <= upper[0]; ++cell[0])
+      for (cell[1] = lower[1]; cell[1] <= upper[1]; ++cell[1])
+        for (cell[2] = lower[2]; cell[2] <= upper[2]; ++cell[2])
+          cells[cell].push_back(element);
+  };
+  const bool isLines = decimated->triangles.empty();
+  const unsigned numElements = isLines ? decimated->lines.size()
+                                       : decimated->triangles.size();
+  for (unsigned element = 0; element < numElements; ++element) {
+    if (isLines)
+      insert(element, decimated->lines[element]);
+    else
+      insert(element, decimated->triangles[element]);
+  }
+
+  double deviation = 0.;
+#pragma omp parallel for reduction(max : deviation)
+  for (std::size_t i = 0; i < mesh->nodes.size(); ++i) {
+    const auto &point = mesh->nodes[i];
+    double distance = 2 * maxDeviation;
+    const auto cell = cells.find(getCell(point, 0.));
+    if (cell != cells.end()) {
+      for (auto element : cell->second) {
+        const auto &nodes = decimated->nodes;
+        if (isLines) {
+          const auto &line = decimated->lines[element];
+          distance = std::min(distance,
+                              DecimateType::distanceToLine(
+                                  point, nodes[line[0]], nodes[line[1]]));
+        } else {
+          const auto &tri = decimated->triangles[element];
+          distance = std::min(distance, DecimateType::distanceToTriangle(
+                                            point, nodes[tri[0]],
+                                            nodes[tri[1]], nodes[tri[2]]));
+        }
+      }
+    }
+    deviation = std::max(deviation, distance);
+  }
+  return deviation;
+}
+
+// write the final substrate and runtime of the reference mode
+template <int D>
+void generate(const std::vector<GoldenCase<D>> &cases,
+              const std::filesystem::path &directory) {
+  for (auto &c : cases) {
+    std::cout << "Generating " << c.name << std::endl;
+    double seconds = 0.;
+    LSPtr<D> substrate = runReference<D>(c, seconds);
+    Writer<NumericType, D>(substrate, (directory / (c.name + ".lvst")).string())
+        .apply();
+    std::ofstream((directory / (c.name + ".time")).string()) << seconds;
+  }
+}
+
+// compare all modes with the stored references; returns false if a
+// golden geometry is missing or a mode with a tolerance does not
+// reproduce it
+template <int D>
+bool compare(const std::vector<GoldenCase<D>> &cases,
+             const std::filesystem::path &directory, std::ostream &report) {
+  bool isReproduced = true;
+  for (auto &c : cases) {
+    const auto fileName = directory / (c.name + ".lvst");
+    if (!std::filesystem::exists(fileName)) {
+      std::cout << "No golden geometry for " << c.name
+                << "; store it with GoldenGeometry generate" << std::endl;
+      isReproduced = false;
+      continue;
+    }
+    auto golden = LSPtr<D>::New();
+    Reader<NumericType, D>(golden, fileName.string()).apply();
+    double referenceSeconds = 0.;
+    std::ifstream((directory / (c.name + ".time")).string()) >>
+        referenceSeconds;
+
+    for (auto &mode : getModes<D>()) {
+      if (!mode.isApplicable(c))
+        continue;
+      std::cout << "Running " << c.name << " (" << mode.name << ")"
+                << std::endl;
+      double seconds = 0.;
+      LSPtr<D> substrate = mode.run(c, seconds);
+
+      GeometryComparison<NumericType, D> comparison(golden, substrate);
+      comparison.apply();
+
+      report << c.name << "," << mode.name << "," << seconds << ","
+             << referenceSeconds / seconds << ","
+             << comparison.getSymmetricDifference() << ","
+             << comparison.getMaxSurfaceDeviation() << ","
+             << comparison.getMaxCDError() << ","
+             << comparison.getRMSCDError() << std::endl;
+
+      if (mode.tolerance >= 0. && comparison.getMaxSurfaceDeviation() >
+                                      mode.tolerance * c.gridDelta) {
+        std::cout << c.name << " (" << mode.name
+                  << ") does not reproduce its golden geometry!" << std::endl;
+        isReproduced = false;
+      }
+
+      // the decimated scalloped surface has to keep its deviation bound
+      if (mode.name == "reference") {
+        const double deviation = getDecimationDeviation<D>(
+            substrate, decimationTolerance * c.gridDelta,
+            decimationMaxDeviation * c.gridDelta);
+        std::cout << c.name << " decimated with a deviation of "
+                  << deviation / c.gridDelta << " grid cells" << std::endl;
+        if (deviation > decimationMaxDeviation * c.gridDelta) {
+          std::cout << c.name << " exceeds the deviation bound of the "
+                    << "decimation!" << std::endl;
+          isReproduced = false;
+        }
+      }
+    }
+  }
+  return isReproduced;
+}
+
+// GoldenGeometry generate|compare <directory> [2|3]
+//
+// The golden geometries are read from and written to the directory. The
+// report of compare is written to golden_report.csv in the working
+// directory. If a dimension is given, only its cases are run.
+int main(int argc, char **argv) {
+  omp_set_num_threads(16);
+
+  if (argc < 3 || (std::string(argv[1]) != "generate" &&
+                   std::string(argv[1]) != "compare")) {
+    std::cout << "Usage: " << argv[0]
+              << " generate|compare <directory> [2|3]" << std::endl;
+    return 1;
+  }
+  std::filesystem::path directory(argv[2]);
+  const int dimension = (argc > 3) ? std::stoi(argv[3]) : 0;
+
+  if (std::string(argv[1]) == "generate") {
+    std::filesystem::create_directories(directory);
+    if (dimension != 3)
+      generate(getCases2D(), directory);
+    if (dimension != 2)
+      generate(getCases3D(), directory);
+    return 0;
+  }
+
+  const std::string reportName = "golden_report.csv";
+  std::ofstream report(reportName);
+  report << "case,mode,seconds,speedup,symmetricDifference,"
+            "maxSurfaceDeviation,maxCDError,rmsCDError"
+         << std::endl;
+  bool isReproduced = true;
+  if (dimension != 3)
+    isReproduced = compare(getCases2D(), directory, report) && isReproduced;
+  if (dimension != 2)
+    isReproduced = compare(getCases3D(), directory, report) && isReproduced;
+  std::cout << "Report written to " << reportName << std::endl;
+
+  return isReproduced ? 0 : 1;
+}
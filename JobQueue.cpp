@@ -0,0 +1,542 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include <omp.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+#include <lsWriter.hpp>
+
+#include "BoschCostEstimate.hpp"
+#include "BoschJobQueue.hpp"
+#include "BoschProcess.hpp"
+#include "FitDomainBounds.hpp"
+#include "MakeMask.hpp"
+
+using namespace viennals;
+
+typedef double NumericType;
+
+// Worker for a BoschJobQueue. Every job etches a single opening of
+// MakeMask with the BoschProcess parameters given in the manifest, e.g.
+//
+//   dem2d_r030 dimension=2 gridDelta=0.05 maskRadius=0.6 numCycles=50
+//     isotropicRate=-0.588 cycleEtchDepth=-0.98 bottomWidth=0.36
+//     lateralEtchRatio=0.75 tapering=0 sidewallTapering=0
+//
+// (on one line), and writes the final substrate and its surface to the
+// output directory of the job. Several workers can run on the same queue;
+// each one runs as many jobs at once as fit into its number of cores and,
+// if a memory limit is given, into the limit by their estimated peak
+// memory (see BoschCostEstimator). Jobs estimated to exceed the limit on
+// their own are failed without running them. Every job runs in a child
+// process of the worker, which writes its stdout and stderr to log.txt in
+// the output directory of the job.
+//
+//   JobQueue estimate <directory> [cores]  prints the estimates as CSV
+//   JobQueue calibrate <directory>         fits the estimator to the
+//                                          measured stages of finished jobs
+//                                          and writes <directory>/cost.txt
+//
+// Instead of gridDelta, a job can set resolution=<tolerance> to use the
+// coarsest grid delta which resolves its scallops to the tolerance (see
+// BoschGridResolution). The lateral domain spans -extent..extent; with
+// fit=1 it is fitted to the etched region and with mirror=1 only its
+// mirror symmetric half or quarter is simulated (see FitDomainBounds).
+
+const std::vector<std::string> jobParameters = {
+    "dimension",        "threads",           "gridDelta",
+    "extent",           "maskRadius",        "mirror",
+    "numCycles",        "isotropicRate",     "cycleEtchDepth",
+    "startWidth",       "bottomWidth",       "startOfTapering",
+    "topOffset",        "tapering",          "sidewallTapering",
+    "sausageCycling",   "sausageCycleDepth", "lateralEtchRatio",
+    "resolution",       "fit"};
+
+void checkParameters(const BoschJob &job) {
+  for (auto &parameter : job.getParameters()) {
+    if (std::find(jobParameters.begin(), jobParameters.end(),
+                  parameter.first) == jobParameters.end())
+      throw std::invalid_argument("Unknown parameter " + parameter.first);
+  }
+  for (auto required : {"dimension", "numCycles", "isotropicRate",
+                        "cycleEtchDepth"}) {
+    if (!job.hasParameter(required))
+      throw std::invalid_argument(std::string("Missing parameter ") +
+                                  required);
+  }
+  const int dimension = job.getInt("dimension", 0);
+  if (dimension != 2 && dimension != 3)
+    throw std::invalid_argument("dimension must be 2 or 3");
+}
+
+template <int D>
+void setupProcess(const BoschJob &job,
+                  BoschProcess<NumericType, D> &processKernel) {
+  const NumericType maskRadius = job.getDouble("maskRadius", 0.6);
+  processKernel.setNumCycles(job.getInt("numCycles", 0));
+  processKernel.setIsotropicRate(job.getDouble("isotropicRate", 0.));
+  processKernel.setCycleEtchDepth(job.getDouble("cycleEtchDepth", 0.));
+  const double startWidth = job.getDouble("startWidth", 2 * maskRadius);
+  processKernel.setStartWidth(startWidth);
+  processKernel.setBottomWidth(job.getDouble("bottomWidth", startWidth));
+  if (job.hasParameter("startOfTapering"))
+    processKernel.setStartOfTapering(job.getDouble("startOfTapering", 0.));
+  processKernel.setTopOffset(job.getDouble("topOffset", 0.));
+  processKernel.setTapering(job.getBool("tapering", true));
+  processKernel.setSidewallTapering(job.getBool("sidewallTapering", true));
+  processKernel.setSausageCycling(job.getInt("sausageCycling", 0));
+  processKernel.setSausageCycleDepth(job.getDouble("sausageCycleDepth", 0.));
+  processKernel.setLateralEtchRatio(job.getDouble("lateralEtchRatio", 0.));
+}
+
+template <int D>
+double getGridDelta(const BoschJob &job,
+                    const BoschProcess<NumericType, D> &processKernel) {
+  if (job.hasParameter("resolution"))
+    return processKernel.getResolvedGridDelta(job.getDouble(
+        "resolution", BoschGridResolution<NumericType>::defaultTolerance));
+  return job.getDouble("gridDelta", 0.05);
+}
+
+template <int D>
+FitDomainBounds<NumericType, D>
+fitDomain(const BoschJob &job,
+          const BoschProcess<NumericType, D> &processKernel) {
+  const double extent = job.getDouble("extent", 4.);
+  FitDomainBounds<NumericType, D> domainFit(
+      getGridDelta<D>(job, processKernel), job.getDouble("maskRadius", 0.6),
+      processKernel.getMaximumLateralReach());
+  domainFit.setMaskOrigin({});
+  domainFit.setFitted(job.getBool("fit", false));
+  domainFit.setLateralExtent(extent);
+  domainFit.setMirrorSymmetric(job.getBool("mirror", false));
+  domainFit.setVerticalBounds(-extent, extent);
+  domainFit.apply();
+  return domainFit;
+}
+
+// predicted points, memory and runtime of the job, see BoschCostEstimator
+template <int D>
+BoschCostEstimate estimateJob(const BoschJob &job, int numThreads,
+                              const BoschCostCoefficients &coefficients) {
+  BoschProcess<NumericType, D> processKernel;
+  setupProcess<D>(job, processKernel);
+  const auto domainFit = fitDomain<D>(job, processKernel);
+
+  BoschCostEstimator<NumericType, D> estimator(processKernel);
+  estimator.setCoefficients(coefficients);
+  estimator.setGridDelta(getGridDelta<D>(job, processKernel));
+  estimator.setDomainBounds(domainFit.getBounds());
+  // a mirror symmetric domain holds a half (2D) or quarter (3D) opening
+  const bool mirrorSymmetric = job.getBool("mirror", false);
+  estimator.setCircularOpening(job.getDouble("maskRadius", 0.6),
+                               mirrorSymmetric ? 1. / (1 << (D - 1)) : 1.);
+  estimator.setNumThreads(numThreads);
+  estimator.apply();
+  return estimator.getEstimate();
+}
+
+BoschCostEstimate estimateJob(const BoschJob &job, int numThreads,
+                              const BoschCostCoefficients &coefficients) {
+  checkParameters(job);
+  return (job.getInt("dimension", 0) == 2)
+             ? estimateJob<2>(job, numThreads, coefficients)
+             : estimateJob<3>(job, numThreads, coefficients);
+}
+
+// files recorded with the completion of a job
+std::vector<std::filesystem::path>
+getJobOutputs(const std::filesystem::path &outputDirectory) {
+  return {outputDirectory / "substrate.lvst", outputDirectory / "surface.vtp"};
+}
+
+template <int D>
+void runJob(const BoschJob &job, const std::filesystem::path &outputDirectory) {
+  std::array<NumericType, 3> maskOrigin = {};
+
+  BoschProcess<NumericType, D> processKernel;
+  setupProcess<D>(job, processKernel);
+  const auto domainFit = fitDomain<D>(job, processKernel);
+
+  auto mask = domainFit.makeDomain();
+  auto levelSet = domainFit.makeDomain();
+  MakeMask<NumericType, D> maskCreator(levelSet, mask);
+  maskCreator.setMaskOrigin(maskOrigin);
+  maskCreator.setMaskRadius(job.getDouble("maskRadius", 0.6));
+  maskCreator.apply();
+
+  processKernel.setSubstrate(levelSet);
+  processKernel.setMask(mask);
+  processKernel.apply();
+
+  levelSet = domainFit.makeFullLevelSet(levelSet);
+
+  std::filesystem::create_directories(outputDirectory);
+  // the measured stages are not outputs, since their timings differ
+  // between runs; they are used by JobQueue calibrate
+  {
+    auto stages = maskCreator.getStageStatistics();
+    for (auto &stage : processKernel.getStageStatistics())
+      stages.push_back(stage);
+    std::ofstream file((outputDirectory / "stages.txt").string());
+    file << "threads " << omp_get_max_threads() << "\n";
+    BoschMemoryTracker::write(stages, file);
+  }
+
+  const auto outputs = getJobOutputs(outputDirectory);
+  Writer<NumericType, D>(levelSet, outputs[0].string()).apply();
+  auto mesh = SmartPointer<Mesh<NumericType>>::New();
+  ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+  VTKWriter(mesh, outputs[1].string()).apply();
+}
+
+struct RunningJob {
+  std::string name;
+  int numThreads;
+  int processId = -1;
+  // read end of the pipe on which the job process sends its error message
+  int errorPipe = -1;
+  std::chrono::steady_clock::time_point start;
+  std::unique_ptr<BoschJobClaim> claim;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+// run the job in a child process with its own number of OpenMP threads,
+// so that jobs running at once neither share stdout nor the peak resident
+// set size; the worker itself never starts OpenMP threads, so the child
+// can use OpenMP after the fork
+bool startJob(const BoschJobQueue &queue, const BoschJob &job,
+              int numThreads, std::unique_ptr<BoschJobClaim> claim,
+              std::vector<RunningJob> &others, RunningJob &running) {
+  const auto outputDirectory = queue.getOutputDirectory(job.getName());
+  std::filesystem::create_directories(outputDirectory);
+  int errorPipe[2];
+  if (pipe(errorPipe) != 0) {
+    queue.fail(job.getName(), "Cannot create a pipe", std::move(claim));
+    return false;
+  }
+  const int processId = fork();
+  if (processId < 0) {
+    close(errorPipe[0]);
+    close(errorPipe[1]);
+    queue.fail(job.getName(), "Cannot start the job process",
+               std::move(claim));
+    return false;
+  }
+
+  if (processId == 0) {
+    close(errorPipe[0]);
+    // only keep the claim of this job, so that a crash of the worker does
+    // not leave the jobs of the other processes locked
+    for (auto &other : others) {
+      other.claim->closeInherited();
+      close(other.errorPipe);
+    }
+    const int log = open((outputDirectory / "log.txt").c_str(),
+                         O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log >= 0) {
+      dup2(log, STDOUT_FILENO);
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+    omp_set_num_threads(numThreads);
+    // the process runs one stage at a time, so the peak of each is its own
+    BoschMemoryTracker::setResetPeakResident(true);
+    int status = 0;
+    try {
+      checkParameters(job);
+      if (job.getInt("dimension", 0) == 2)
+        runJob<2>(job, outputDirectory);
+      else
+        runJob<3>(job, outputDirectory);
+    } catch (std::exception &e) {
+      const std::string message = e.what();
+      if (write(errorPipe[1], message.data(), message.size()) < 0)
+        std::cerr << message << std::endl;
+      status = 1;
+    }
+    std::cout.flush();
+    std::fflush(nullptr);
+    // skip the destructors, which would release the claim of the worker
+    _exit(status);
+  }
+
+  close(errorPipe[1]);
+  running.name = job.getName();
+  running.numThreads = numThreads;
+  running.processId = processId;
+  running.errorPipe = errorPipe[0];
+  running.start = std::chrono::steady_clock::now();
+  running.claim = std::move(claim);
+  std::cout << "Starting " << job.getName() << " on " << numThreads
+            << " threads" << std::endl;
+  return true;
+}
+
+// if the job process has exited, complete or fail the job and return true
+bool finishJob(const BoschJobQueue &queue, RunningJob &running) {
+  int status = 0;
+  if (waitpid(running.processId, &status, WNOHANG) != running.processId)
+    return false;
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - running.start)
+                             .count();
+  std::string message;
+  char buffer[256];
+  ssize_t size;
+  while ((size = read(running.errorPipe, buffer, sizeof(buffer))) > 0)
+    message.append(buffer, size);
+  close(running.errorPipe);
+
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    queue.complete(running.name,
+                   getJobOutputs(queue.getOutputDirectory(running.name)),
+                   seconds, std::move(running.claim));
+    std::cout << "Finished " << running.name << " in " << seconds << " s"
+              << std::endl;
+  } else {
+    if (message.empty())
+      message = WIFSIGNALED(status)
+                    ? "Killed by signal " + std::to_string(WTERMSIG(status))
+                    : "Exited with status " +
+                          std::to_string(WEXITSTATUS(status));
+    queue.fail(running.name, message, std::move(running.claim));
+    std::cout << "Failed " << running.name << ": " << message << std::endl;
+  }
+  return true;
+}
+#else
+// jobs cannot be claimed without file locks, see BoschJobQueue::claim
+bool startJob(const BoschJobQueue &queue, const BoschJob &job, int,
+              std::unique_ptr<BoschJobClaim> claim, std::vector<RunningJob> &,
+              RunningJob &) {
+  queue.fail(job.getName(), "Job processes are not supported",
+             std::move(claim));
+  return false;
+}
+
+bool finishJob(const BoschJobQueue &, RunningJob &) { return true; }
+#endif
+
+// 3D jobs use half of the cores by default and 2D jobs one, so a 3D job
+// leaves room for a second one or for the small jobs
+int getNumThreads(const BoschJob &job, int numCores) {
+  int numThreads = 1;
+  try {
+    const bool is3D = job.getInt("dimension", 2) == 3;
+    numThreads = job.getInt("threads", is3D ? std::max(numCores / 2, 1) : 1);
+  } catch (std::exception &) {
+    // the job fails with the error message when it is run
+  }
+  return std::min(std::max(numThreads, 1), numCores);
+}
+
+// coefficients fitted by JobQueue calibrate, or the defaults
+BoschCostCoefficients loadCoefficients(const std::filesystem::path &file) {
+  BoschCostCoefficients coefficients;
+  if (std::filesystem::exists(file) && !coefficients.read(file.string())) {
+    std::cout << "Cannot read " << file.string() << ", using defaults"
+              << std::endl;
+    coefficients = BoschCostCoefficients();
+  }
+  return coefficients;
+}
+
+int runWorker(BoschJobQueue &queue, int numCores, double memoryLimit,
+              const BoschCostCoefficients &coefficients) {
+  std::vector<const BoschJob *> order;
+  std::map<std::string, std::uint64_t> jobBytes;
+  for (auto &job : queue.getJobs()) {
+    order.push_back(&job);
+    if (memoryLimit > 0.) {
+      try {
+        jobBytes[job.getName()] =
+            estimateJob(job, getNumThreads(job, numCores), coefficients)
+                .peakBytes;
+      } catch (std::exception &) {
+        // the job fails with the error message when it is run
+      }
+    }
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const BoschJob *a, const BoschJob *b) {
+                     return getNumThreads(*a, numCores) >
+                            getNumThreads(*b, numCores);
+                   });
+
+  std::vector<RunningJob> running;
+  int numBusy = 0;
+  double busyBytes = 0.;
+  while (true) {
+    for (auto it = running.begin(); it != running.end();) {
+      if (finishJob(queue, *it)) {
+        numBusy -= it->numThreads;
+        busyBytes -= jobBytes[it->name];
+        it = running.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // claim the largest job which fits into the free cores and memory
+    bool isStarted = false, isUnfinished = false;
+    for (auto job : order) {
+      if (queue.isDone(job->getName()) || queue.isFailed(job->getName()))
+        continue;
+      isUnfinished = true;
+      const int numThreads = getNumThreads(*job, numCores);
+      const double bytes = jobBytes[job->getName()];
+      if (numBusy + numThreads > numCores ||
+          (busyBytes + bytes > memoryLimit && !running.empty()))
+        continue;
+      auto claim = queue.claim(job->getName());
+      if (claim == nullptr)
+        continue;
+      // never start a job which does not fit into an empty worker
+      if (bytes > memoryLimit && memoryLimit > 0.) {
+        const std::string message =
+            "Estimated peak memory of " +
+            std::to_string(std::lround(bytes / (1024. * 1024.))) +
+            " MiB exceeds the limit";
+        queue.fail(job->getName(), message, std::move(claim));
+        std::cout << "Rejected " << job->getName() << ": " << message
+                  << std::endl;
+        isStarted = true;
+        break;
+      }
+      RunningJob started;
+      if (startJob(queue, *job, numThreads, std::move(claim), running,
+                   started)) {
+        running.push_back(std::move(started));
+        numBusy += numThreads;
+        busyBytes += bytes;
+      }
+      isStarted = true;
+      break;
+    }
+
+    if (!isUnfinished && running.empty())
+      break;
+    // jobs claimed by other workers are retried in case those crash
+    if (!isStarted)
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+
+  queue.printStatus();
+  return 0;
+}
+
+// print the estimated cost of all jobs as CSV
+int printEstimates(const BoschJobQueue &queue, int numCores,
+                   const BoschCostCoefficients &coefficients) {
+  const double MiB = 1024. * 1024.;
+  std::cout << "name,threads,points,peakMiB,maskSeconds,viaSeconds,"
+               "scallopSeconds"
+            << std::endl;
+  for (auto &job : queue.getJobs()) {
+    const int numThreads = getNumThreads(job, numCores);
+    try {
+      const auto estimate = estimateJob(job, numThreads, coefficients);
+      std::cout << job.getName() << "," << numThreads << ","
+                << estimate.numFinalPoints << ","
+                << estimate.peakBytes / MiB << "," << estimate.maskSeconds
+                << "," << estimate.viaSeconds << ","
+                << estimate.scallopSeconds << std::endl;
+    } catch (std::exception &e) {
+      std::cout << job.getName() << "," << numThreads << ",,,,,"
+                << std::endl;
+      std::cerr << job.getName() << ": " << e.what() << std::endl;
+    }
+  }
+  return 0;
+}
+
+// fit the coefficients to the measured stages of all finished jobs
+int calibrate(const BoschJobQueue &queue,
+              const std::filesystem::path &coefficientFile) {
+  struct Run {
+    const BoschJob *job;
+    int numThreads;
+    std::vector<BoschStageStatistics> stages;
+  };
+  std::vector<Run> runs;
+  for (auto &job : queue.getJobs()) {
+    std::ifstream file(
+        (queue.getOutputDirectory(job.getName()) / "stages.txt").string());
+    std::string key;
+    Run run{&job, 0, {}};
+    if (!queue.isDone(job.getName()) || !(file >> key >> run.numThreads) ||
+        key != "threads" || !BoschMemoryTracker::read(file, run.stages))
+      continue;
+    runs.push_back(run);
+  }
+  if (runs.empty()) {
+    std::cout << "No finished jobs with measured stages" << std::endl;
+    return 1;
+  }
+
+  // the estimated work depends on the points per surface cell, so the
+  // estimates are recomputed with the fitted coefficients
+  BoschCostCoefficients coefficients;
+  for (unsigned iteration = 0; iteration < 3; ++iteration) {
+    BoschCostCalibration calibration;
+    for (auto &run : runs)
+      calibration.addRun(
+          estimateJob(*run.job, run.numThreads, coefficients), run.stages);
+    coefficients = calibration.fit(coefficients);
+  }
+  if (!coefficients.write(coefficientFile.string())) {
+    std::cout << "Cannot write " << coefficientFile.string() << std::endl;
+    return 1;
+  }
+  std::cout << "Calibrated on " << runs.size() << " jobs:" << std::endl;
+  coefficients.write(std::cout);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const std::string command = (argc > 1) ? argv[1] : "";
+  if (argc < 3 || (command != "run" && command != "status" &&
+                   command != "estimate" && command != "calibrate")) {
+    std::cout << "Usage: " << argv[0]
+              << " run|status|estimate|calibrate <directory> [cores] "
+                 "[memory MiB]"
+              << std::endl;
+    return 1;
+  }
+
+  BoschJobQueue queue(argv[2]);
+  std::string error;
+  if (!queue.load(error)) {
+    std::cout << error << std::endl;
+    return 1;
+  }
+
+  if (command == "status") {
+    queue.printStatus();
+    return 0;
+  }
+
+  const auto coefficientFile = std::filesystem::path(argv[2]) / "cost.txt";
+  if (command == "calibrate")
+    return calibrate(queue, coefficientFile);
+
+  const int numCores =
+      (argc > 3) ? std::stoi(argv[3]) : omp_get_num_procs();
+  const auto coefficients = loadCoefficients(coefficientFile);
+  if (command == "estimate")
+    return printEstimates(queue, std::max(numCores, 1), coefficients);
+
+  const double memoryLimit =
+      (argc > 4) ? std::stod(argv[4]) * 1024. * 1024. : 0.;
+  return runWorker(queue, std::max(numCores, 1), memoryLimit, coefficients);
+}
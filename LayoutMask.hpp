@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <vcLogger.hpp>
+
+#include "BoschMemory.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Mask openings of a lithography layout as closed polygons in the x-y
+/// plane. Nested polygons are combined with the even-odd rule, so a
+/// polygon inside an opening is an island of mask.
+///
+/// Text layouts have one polygon per line as "x0 y0 x1 y1 x2 y2 ...";
+/// empty lines and lines starting with '#' are ignored. Binary layouts
+/// start with "DRIELAY1" and the number of polygons (uint64), followed by
+/// the number of vertices (uint32) and the vertices (double x, y) of each
+/// polygon.
+template <class T> class PolygonLayout {
+public:
+  using Polygon = std::vector<std::array<T, 2>>;
+
+private:
+  std::vector<Polygon> polygons;
+
+  static constexpr char magic[9] = "DRIELAY1";
+
+  template <class ValueType>
+  static void write(std::ostream &stream, const ValueType &value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <class ValueType>
+  static bool read(std::istream &stream, ValueType &value) {
+    return bool(
+        stream.read(reinterpret_cast<char *>(&value), sizeof(value)));
+  }
+
+  bool readText(std::istream &stream, const std::string &fileName) {
+    std::string line;
+    std::vector<double> values;
+    for (std::size_t lineNumber = 1; std::getline(stream, line);
+         ++lineNumber) {
+      values.clear();
+      const char *position = line.c_str();
+      while (true) {
+        while (*position == ' ' || *position == '\t' || *position == ',' ||
+               *position == '\r')
+          ++position;
+        if (*position == '\0' || *position == '#')
+          break;
+        char *end;
+        values.push_back(std::strtod(position, &end));
+        if (end == position) {
+          values.push_back(0.); // mark as malformed
+          break;
+        }
+        position = end;
+      }
+      if (values.empty())
+        continue;
+      if (values.size() % 2 != 0 || values.size() < 6) {
+        viennacore::Logger::getInstance()
+            .addWarning("PolygonLayout: Malformed polygon in line " +
+                        std::to_string(lineNumber) + " of " + fileName +
+                        ".")
+            .print();
+        return false;
+      }
+      Polygon polygon(values.size() / 2);
+      for (std::size_t i = 0; i < polygon.size(); ++i)
+        polygon[i] = {T(values[2 * i]), T(values[2 * i + 1])};
+      polygons.push_back(std::move(polygon));
+    }
+    return true;
+  }
+
+  bool readBinary(std::istream &stream, const std::string &fileName) {
+    std::uint64_t numPolygons;
+    bool isValid = read(stream, numPolygons);
+    for (std::uint64_t p = 0; isValid && p < numPolygons; ++p) {
+      std::uint32_t numVertices;
+      isValid = read(stream, numVertices) && numVertices >= 3;
+      Polygon polygon;
+      for (std::uint32_t i = 0; isValid && i < numVertices; ++i) {
+        double x, y;
+        isValid = read(stream, x) && read(stream, y);
+        polygon.push_back({T(x), T(y)});
+      }
+      if (isValid)
+        polygons.push_back(std::move(polygon));
+    }
+    if (!isValid) {
+      viennacore::Logger::getInstance()
+          .addWarning("PolygonLayout: " + fileName + " is truncated.")
+          .print();
+    }
+    return isValid;
+  }
+
+public:
+  /// Add an opening. The polygon is closed implicitly.
+  void addPolygon(const Polygon &polygon) {
+    if (polygon.size() < 3) {
+      viennacore::Logger::getInstance()
+          .addWarning("PolygonLayout: Polygons need at least 3 vertices.")
+          .print();
+      return;
+    }
+    polygons.push_back(polygon);
+  }
+
+  void clear() { polygons.clear(); }
+
+  const std::vector<Polygon> &getPolygons() const { return polygons; }
+
+  std::size_t getNumberOfPolygons() const { return polygons.size(); }
+
+  /// Bounds (xmin, xmax, ymin, ymax) of all polygons.
+  std::array<T, 4> getBounds() const {
+    std::array<T, 4> bounds = {
+        std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest(),
+        std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest()};
+    for (auto &polygon : polygons) {
+      for (auto &vertex : polygon) {
+        for (unsigned i = 0; i < 2; ++i) {
+          bounds[2 * i] = std::min(bounds[2 * i], vertex[i]);
+          bounds[2 * i + 1] = std::max(bounds[2 * i + 1], vertex[i]);
+        }
+      }
+    }
+    return bounds;
+  }
+
+  /// Append the polygons of a text or binary layout file. Returns false if
+  /// the file cannot be read.
+  bool readFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+      viennacore::Logger::getInstance()
+          .addWarning("PolygonLayout: Cannot open " + fileName + ".")
+          .print();
+      return false;
+    }
+    char fileMagic[8] = {};
+    file.read(fileMagic, 8);
+    if (file && std::memcmp(fileMagic, magic, 8) == 0)
+      return readBinary(file, fileName);
+    file.clear();
+    file.seekg(0);
+    return readText(file, fileName);
+  }
+
+  bool writeText(const std::string &fileName) const {
+    std::ofstream file(fileName);
+    file.precision(std::numeric_limits<double>::max_digits10);
+    for (auto &polygon : polygons) {
+      for (std::size_t i = 0; i < polygon.size(); ++i)
+        file << (i > 0 ? " " : "") << polygon[i][0] << " " << polygon[i][1];
+      file << "\n";
+    }
+    return bool(file);
+  }
+
+  bool writeBinary(const std::string &fileName) const {
+    std::ofstream file(fileName, std::ios::binary);
+    file.write(magic, 8);
+    write(file, std::uint64_t(polygons.size()));
+    for (auto &polygon : polygons) {
+      write(file, std::uint32_t(polygon.size()));
+      for (auto &vertex : polygon) {
+        write(file, double(vertex[0]));
+        write(file, double(vertex[1]));
+      }
+    }
+    return bool(file);
+  }
+};
+
+/// Builds the mask and substrate level sets from a PolygonLayout. The
+/// mask is a layer of maskHeight on top of the substrate surface at
+/// z = maskOrigin[2], with the polygons of the layout, shifted by
+/// maskOrigin, cut out as openings; the substrate is the union of the
+/// substrate below the mask and the mask, as for MakeMask. Instead of one
+/// boolean operation per opening, the signed distances of the grid points
+/// next to the surfaces are computed directly, one row of the grid per
+/// thread. Each point only tests the polygon edges of its bin of a
+/// uniform grid over the layout, so the cost grows with the area of the
+/// domain and not with the number of openings.
+template <class T, int D> class LayoutMask {
+  static_assert(D == 3, "LayoutMask: Layouts can only be used in 3D.");
+
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+  LSPtrType substrate;
+  LSPtrType mask;
+  BoschMemoryTracker memoryTracker;
+
+  PolygonLayout<T> layout;
+  std::array<T, 3> maskOrigin = {};
+  T maskHeight = 2.;
+
+  // edges of the layout in grid units
+  struct Edge {
+    double a[2];
+    double b[2];
+  };
+
+  static double edgeDistance(const double p[2], const Edge &edge) {
+    const double ab[2] = {edge.b[0] - edge.a[0], edge.b[1] - edge.a[1]};
+    const double ap[2] = {p[0] - edge.a[0], p[1] - edge.a[1]};
+    const double length2 = ab[0] * ab[0] + ab[1] * ab[1];
+    double t = 0.;
+    if (length2 > 0.)
+      t = std::min(std::max((ap[0] * ab[0] + ap[1] * ab[1]) / length2, 0.),
+                   1.);
+    const double d[2] = {ap[0] - t * ab[0], ap[1] - t * ab[1]};
+    return std::sqrt(d[0] * d[0] + d[1] * d[1]);
+  }
+
+public:
+  LayoutMask(LSPtrType passedSubstrate, LSPtrType passedMask)
+      : substrate(passedSubstrate), mask(passedMask) {}
+
+  void setLayout(const PolygonLayout<T> &passedLayout) {
+    layout = passedLayout;
+  }
+
+  /// Position of the layout origin in x and y, and height of the substrate
+  /// surface below the mask in z.
+  void setMaskOrigin(std::array<T, 3> &origin) { maskOrigin = origin; }
+
+  void setMaskHeight(T height) { maskHeight = height; }
+
+  /// Time, peak memory and allocations of building the mask.
+  const std::vector<BoschStageStatistics> &getStageStatistics() const {
+    return memoryTracker.getStatistics();
+  }
+
+  void apply() {
+    memoryTracker.clear();
+    memoryTracker.beginStage("mask");
+    const auto &grid = substrate->getGrid();
+    const double gridDelta = grid.getGridDelta();
+    const T valueLimit = 1.;
+    const viennahrle::IndexType binSize = 8;
+
+    viennahrle::IndexType minIndex[2], maxIndex[2], numBins[2];
+    for (unsigned i = 0; i < 2; ++i) {
+      minIndex[i] = grid.getMinGridPoint(i);
+      maxIndex[i] = grid.getMaxGridPoint(i);
+      numBins[i] = (maxIndex[i] - minIndex[i]) / binSize + 1;
+    }
+    auto binOf = [&](double x, unsigned i) {
+      const viennahrle::IndexType bin =
+          std::floor((x - minIndex[i]) / binSize);
+      return std::min(std::max(bin, viennahrle::IndexType(0)),
+                      numBins[i] - 1);
+    };
+
+    // spatial index: every edge is listed in the bins it passes within
+    // valueLimit of, and in the bin rows it crosses for the scanlines
+    std::vector<Edge> edges;
+    for (auto &polygon : layout.getPolygons()) {
+      for (std::size_t i = 0; i < polygon.size(); ++i) {
+        const auto &a = polygon[i];
+        const auto &b = polygon[(i + 1) % polygon.size()];
+        Edge edge;
+        for (unsigned j = 0; j < 2; ++j) {
+          edge.a[j] = (a[j] + maskOrigin[j]) / gridDelta;
+          edge.b[j] = (b[j] + maskOrigin[j]) / gridDelta;
+        }
+        edges.push_back(edge);
+      }
+    }
+    std::vector<std::vector<unsigned>> bins(std::size_t(numBins[0]) *
+                                            numBins[1]);
+    std::vector<std::vector<unsigned>> rowBins(numBins[1]);
+    for (unsigned e = 0; e < edges.size(); ++e) {
+      const auto &edge = edges[e];
+      viennahrle::IndexType first[2], last[2];
+      for (unsigned i = 0; i < 2; ++i) {
+        first[i] = binOf(std::min(edge.a[i], edge.b[i]) - valueLimit, i);
+        last[i] = binOf(std::max(edge.a[i], edge.b[i]) + valueLimit, i);
+      }
+      for (auto y = first[1]; y <= last[1]; ++y) {
+        rowBins[y].push_back(e);
+        for (auto x = first[0]; x <= last[0]; ++x)
+          bins[std::size_t(y) * numBins[0] + x].push_back(e);
+      }
+    }
+
+    // the surfaces lie between the substrate surface and the mask top
+    const double zBottom = maskOrigin[2] / gridDelta;
+    const double zTop = (maskOrigin[2] + maskHeight) / gridDelta;
+    const viennahrle::IndexType zMin = std::floor(zBottom - valueLimit);
+    const viennahrle::IndexType zMax = std::ceil(zTop + valueLimit);
+
+    const int numRows = maxIndex[1] - minIndex[1] + 1;
+    std::vector<typename viennals::Domain<T, D>::PointValueVectorType>
+        maskRows(numRows), substrateRows(numRows);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int row = 0; row < numRows; ++row) {
+      const viennahrle::IndexType y = minIndex[1] + row;
+
+      // crossings of the scanline with the edges, for the even-odd rule
+      std::vector<double> crossings;
+      for (auto e : rowBins[binOf(y, 1)]) {
+        const auto &edge = edges[e];
+        if ((edge.a[1] <= y) == (edge.b[1] <= y))
+          continue;
+        crossings.push_back(edge.a[0] + (y - edge.a[1]) *
+                                            (edge.b[0] - edge.a[0]) /
+                                            (edge.b[1] - edge.a[1]));
+      }
+      std::sort(crossings.begin(), crossings.end());
+
+      std::size_t numCrossed = 0;
+      for (auto x = minIndex[0]; x <= maxIndex[0]; ++x) {
+        while (numCrossed < crossings.size() && crossings[numCrossed] < x)
+          ++numCrossed;
+        const bool isOpening = numCrossed % 2 == 1;
+
+        // lateral distance to the opening boundary, negative inside
+        const double point[2] = {double(x), double(y)};
+        double distance = valueLimit + 1.;
+        for (auto e : bins[std::size_t(binOf(y, 1)) * numBins[0] +
+                           binOf(x, 0)])
+          distance = std::min(distance, edgeDistance(point, edges[e]));
+        const double lateral = isOpening ? -distance : distance;
+
+        viennahrle::Index<D> index;
+        index[0] = x;
+        index[1] = y;
+        for (auto z = zMin; z <= zMax; ++z) {
+          index[2] = z;
+          const T maskValue =
+              std::max(std::max(zBottom - z, z - zTop), -lateral);
+          const T substrateValue = std::min(T(z - zBottom), maskValue);
+          if (std::abs(maskValue) <= valueLimit)
+            maskRows[row].push_back(std::make_pair(index, maskValue));
+          if (std::abs(substrateValue) <= valueLimit)
+            substrateRows[row].push_back(
+                std::make_pair(index, substrateValue));
+        }
+      }
+    }
+
+    for (auto levelSet : {std::make_pair(mask, &maskRows),
+                          std::make_pair(substrate, &substrateRows)}) {
+      typename viennals::Domain<T, D>::PointValueVectorType pointData;
+      for (auto &points : *levelSet.second)
+        pointData.insert(pointData.end(), points.begin(), points.end());
+      levelSet.first->insertPoints(pointData);
+      levelSet.first->getDomain().segment();
+      levelSet.first->finalize(2);
+    }
+
+    memoryTracker.endStage(substrate, mask);
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(PolygonLayout);
+DRIE_PRECOMPILE_SPECIALIZE(LayoutMask, 3);
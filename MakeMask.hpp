@@ -2,14 +2,27 @@
 
 #include <lsDomain.hpp>
 
+#include "BoschMemory.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Shape of the opening cut into the mask by MakeMask.
+enum struct MaskShapeEnum : unsigned {
+  // cylindrical hole in 3D
+  HOLE = 0,
+  // trench along y through the whole domain in 3D
+  LINE_TRENCH = 1
+};
+
 template <class T, int D> class MakeMask {
   using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
   LSPtrType substrate;
   LSPtrType mask;
+  BoschMemoryTracker memoryTracker;
 
   std::array<T, 3> maskOrigin = {};
   T maskRadius = 0;
   T maskHeight = 2.;
+  MaskShapeEnum maskShape = MaskShapeEnum::HOLE;
 
   unsigned numberOfHoles = 1;
   double scallopSpacing = 1.5;
@@ -22,7 +35,20 @@ public:
 
   void setMaskRadius(T radius) { maskRadius = radius; }
 
+  /// Shape of the opening in 3D; the radius is the half width of a line
+  /// trench. In 2D, both shapes are the same cross-section. Defaults to
+  /// HOLE.
+  void setMaskShape(MaskShapeEnum shape) { maskShape = shape; }
+
+  /// Time, peak memory and allocations of building the mask, including
+  /// all temporary level sets.
+  const std::vector<BoschStageStatistics> &getStageStatistics() const {
+    return memoryTracker.getStatistics();
+  }
+
   void apply() {
+    memoryTracker.clear();
+    memoryTracker.beginStage("mask");
     auto &grid = substrate->getGrid();
     auto &boundaryCons = grid.getBoundaryConditions();
     auto gridDelta = grid.getGridDelta();
@@ -57,14 +83,28 @@ public:
       auto maskHole = viennals::SmartPointer<viennals::Domain<T, D>>::New(grid);
 
       if constexpr (D == 3) {
-        maskOrigin[2] = origin[2] - gridDelta;
-        // maskRadius = extent / 2.0;
-        double axis[3] = {0.0, 0.0, 1.0};
-        viennals::MakeGeometry<T, D>(
-            maskHole, viennals::SmartPointer<viennals::Cylinder<T, D>>::New(
-                          maskOrigin.data(), axis, maskHeight + 2 * gridDelta,
-                          maskRadius))
-            .apply();
+        if (maskShape == MaskShapeEnum::LINE_TRENCH) {
+          double min[3] = {maskOrigin[0] - maskRadius,
+                           (grid.getMinGridPoint(1) - 1) * gridDelta,
+                           -gridDelta};
+          double max[3] = {maskOrigin[0] + maskRadius,
+                           (grid.getMaxGridPoint(1) + 1) * gridDelta,
+                           maskHeight + 2 * gridDelta};
+          viennals::MakeGeometry<T, D>(
+              maskHole,
+              viennals::SmartPointer<viennals::Box<T, D>>::New(min, max))
+              .apply();
+        } else {
+          maskOrigin[2] = origin[2] - gridDelta;
+          // maskRadius = extent / 2.0;
+          double axis[3] = {0.0, 0.0, 1.0};
+          viennals::MakeGeometry<T, D>(
+              maskHole,
+              viennals::SmartPointer<viennals::Cylinder<T, D>>::New(
+                  maskOrigin.data(), axis, maskHeight + 2 * gridDelta,
+                  maskRadius))
+              .apply();
+        }
       } else {
         // double minScalar = origin[D-1] - 2 * gridDelta;
         // maskRadius = extent / 2.0;
@@ -92,5 +132,9 @@ public:
                                        viennals::BooleanOperationEnum::UNION)
           .apply();
     }
+
+    memoryTracker.endStage(substrate, mask);
   }
-};
\ No newline at end of file
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(MakeMask);
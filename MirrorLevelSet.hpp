@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+#include <vcLogger.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Reconstructs a level set which is mirror symmetric about the planes
+/// x = origin[0] (and y = origin[1] in 3D) from the half (quarter in 3D)
+/// domain on the positive side of these planes. The reduced level set is
+/// simulated with reflective boundaries on the symmetry planes, see
+/// FitDomainBounds::setMirrorSymmetric, and only mirrored for output or
+/// comparisons. The full level set must have the same gridDelta and is
+/// overwritten.
+template <class T, int D> class MirrorLevelSet {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+
+  LSPtrType reducedLevelSet;
+  LSPtrType fullLevelSet;
+  std::array<T, 3> symmetryOrigin = {};
+
+public:
+  MirrorLevelSet(LSPtrType passedReducedLevelSet,
+                 LSPtrType passedFullLevelSet)
+      : reducedLevelSet(passedReducedLevelSet),
+        fullLevelSet(passedFullLevelSet) {}
+
+  /// Position of the symmetry planes. Must lie on grid points.
+  void setSymmetryOrigin(std::array<T, 3> origin) { symmetryOrigin = origin; }
+
+  void apply() {
+    const auto &grid = fullLevelSet->getGrid();
+    const double gridDelta = grid.getGridDelta();
+    if (std::abs(reducedLevelSet->getGrid().getGridDelta() - gridDelta) >
+        1e-6 * gridDelta) {
+      viennacore::Logger::getInstance().addError(
+          "MirrorLevelSet: Both level sets must have the same gridDelta!");
+      return;
+    }
+
+    std::array<int, D - 1> plane;
+    for (unsigned i = 0; i < D - 1; ++i)
+      plane[i] = std::round(symmetryOrigin[i] / gridDelta);
+
+    const T valueLimit = 1.;
+    typename viennals::Domain<T, D>::PointValueVectorType pointData;
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, D>::DomainType>
+             it(reducedLevelSet->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || std::abs(it.getValue()) > valueLimit)
+        continue;
+      const auto &index = it.getStartIndices();
+
+      // one image per combination of mirrored axes; points on a symmetry
+      // plane are their own image
+      for (unsigned mirror = 0; mirror < (1u << (D - 1)); ++mirror) {
+        viennahrle::Index<D> image;
+        image[D - 1] = index[D - 1];
+        bool isValid = true;
+        for (unsigned i = 0; i < D - 1; ++i) {
+          if (index[i] < plane[i]) {
+            isValid = false;
+          } else if (mirror & (1u << i)) {
+            isValid &= (index[i] != plane[i]);
+            image[i] = 2 * plane[i] - index[i];
+          } else {
+            image[i] = index[i];
+          }
+          isValid &= (image[i] >= grid.getMinGridPoint(i) &&
+                      image[i] <= grid.getMaxGridPoint(i));
+        }
+        if (isValid)
+          pointData.push_back(std::make_pair(image, it.getValue()));
+      }
+    }
+
+    fullLevelSet->insertPoints(pointData);
+    fullLevelSet->getDomain().segment();
+    fullLevelSet->finalize(2);
+    if (reducedLevelSet->getLevelSetWidth() > 2)
+      viennals::Expand<T, D>(fullLevelSet,
+                             reducedLevelSet->getLevelSetWidth())
+          .apply();
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(MirrorLevelSet);
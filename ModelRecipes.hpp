@@ -0,0 +1,130 @@
+#pragma once
+
+#include "BoschProcess.hpp"
+
+/// Mask geometry, domain extent and recipe of the models. They are shared
+/// by the model executables and GoldenGeometry, so that the golden
+/// references are always computed with the recipes the models use.
+
+/// DEM2D: a hole of radius 0.6 etched with a taper to 30 % of its width.
+/// Also used by DEM3DLine and DEM2DEnsemble.
+struct DEM2DRecipe {
+  static constexpr double extent = 4;
+  static constexpr double maskRadius = 0.6;
+  static constexpr double bottomFraction = 0.3;
+  static constexpr double etchRate = -0.98;
+  // the scallops are resolved with five cells per height
+  static constexpr double resolutionTolerance = 0.2;
+
+  template <class T, int D> static void apply(BoschProcess<T, D> &process) {
+    process.setResolutionTolerance(resolutionTolerance);
+    process.setNumCycles(50);
+    process.setIsotropicRate(etchRate * 0.6);
+    process.setCycleEtchDepth(etchRate);
+    process.setStartWidth(2 * maskRadius);
+    process.setBottomWidth(2 * maskRadius * bottomFraction);
+    process.setStartOfTapering(0);
+    process.setSidewallTapering(false);
+    process.setTapering(false);
+    process.setLateralEtchRatio(0.75);
+  }
+
+  /// Coarsest grid delta which resolves the scallops of the recipe.
+  template <class T, int D> static double getGridDelta() {
+    BoschProcess<T, D> process;
+    apply(process);
+    return process.getResolvedGridDelta(resolutionTolerance);
+  }
+};
+
+/// DREAM: a hole of radius 0.4 etched for 100 cycles, with the bottom
+/// width given by the ash time of the passivation.
+struct DREAMRecipe {
+  static constexpr double gridDelta = 0.025;
+  static constexpr double extent = 3;
+  static constexpr double maskRadius = 0.4;
+  // average from etch rate measurements in Fig3.11d from ChangThesis2018
+  static constexpr double etchRate = -(46 + 42 + 44 * 2) / (4 * 119.);
+  static constexpr double startOfTapering = -24.5;
+  // the scallops are about four cells high
+  static constexpr double resolutionTolerance = 0.3;
+
+  /// Ratio of the bottom to the top width for an ash time, fitted to the
+  /// measurements.
+  static double getBottomFraction(double ashTime) {
+    static constexpr double p0 = 1.17506441;
+    static constexpr double p1 = 0.61536308;
+    static constexpr double p2 = -0.42438527;
+    static constexpr double t0 = p1 / p0 - p2;
+    static constexpr double tm = p1 / (p0 - 1) - p2;
+
+    if (ashTime <= t0) {
+      return 0.;
+    } else if (ashTime >= tm) {
+      return 1.;
+    } else {
+      return p0 - p1 / (p2 + ashTime);
+    }
+  }
+
+  template <class T, int D>
+  static void apply(BoschProcess<T, D> &process, double bottomFraction) {
+    process.setResolutionTolerance(resolutionTolerance);
+    process.setNumCycles(100);
+    // * 1.2 / 2 because it is a radius
+    process.setIsotropicRate(etchRate * 0.6);
+    process.setCycleEtchDepth(etchRate);
+    process.setStartWidth(2 * maskRadius);
+    process.setLateralEtchRatio(0.5);
+    process.setBottomWidth(2 * maskRadius * bottomFraction);
+    process.setStartOfTapering(startOfTapering);
+  }
+};
+
+/// DEM3D: a wide via of radius 6 etched for 19 cycles with a taper to
+/// 70 % of its width. Also used by DEM3DAxisymmetric.
+struct DEM3DRecipe {
+  static constexpr double gridDelta = 0.125;
+  static constexpr double extent = 12;
+  static constexpr double maskRadius = extent / 2.0;
+  static constexpr double bottomFraction = 0.7;
+  static constexpr double etchRate = -1.86;
+
+  // the grid only resolves the scallops with 1.7 cells per height, so
+  // apply() warns with the default tolerance
+  template <class T, int D> static void apply(BoschProcess<T, D> &process) {
+    process.setNumCycles(19);
+    process.setIsotropicRate(etchRate * 1.15);
+    process.setCycleEtchDepth(etchRate);
+    process.setStartWidth(2 * maskRadius);
+    process.setBottomWidth(2 * maskRadius * bottomFraction);
+    process.setStartOfTapering(-10);
+    process.setLateralEtchRatio(0.5);
+  }
+};
+
+/// DREM3D: a field of pillars of radius 0.625 etched for 80 cycles with a
+/// sausage cycle.
+struct DREM3DRecipe {
+  static constexpr double gridDelta = 0.05;
+  static constexpr double maskRadius = 1.25 / 2.;
+  static constexpr double lineDistance = 0.51;
+  static constexpr double unitCellLength = 2 * maskRadius + lineDistance;
+  static constexpr double extent = 2 * unitCellLength;
+  // average from etch rate measurements in Fig6.c from Chang2018
+  static constexpr double etchRate = -0.25;
+
+  // the bulge of the sausage cycle is only 1.3 cells high, so apply()
+  // warns with the default tolerance
+  template <class T, int D> static void apply(BoschProcess<T, D> &process) {
+    process.setNumCycles(80);
+    // * 1.2 / 2 because it is a radius
+    process.setIsotropicRate(etchRate * 0.6);
+    process.setCycleEtchDepth(etchRate);
+    process.setStartWidth(2 * maskRadius);
+    process.setBottomWidth(2 * maskRadius);
+    process.setSausageCycling(10);
+    process.setSausageCycleDepth(2 * etchRate);
+    process.setLateralEtchRatio(0.5);
+  }
+};
@@ -4,15 +4,21 @@
 #include <lsDomain.hpp>
 #include <lsMakeGeometry.hpp>
 
+#include "BoschMemory.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
 template <class T, int D> class PillarMask {
   using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
   LSPtrType substrate;
   LSPtrType mask;
+  BoschMemoryTracker memoryTracker;
 
   std::array<T, 3> maskOrigin = {};
   T maskRadius = 0;
   T maskHeight = 1.;
   T lineDistance = 0;
+  std::array<T, 4> patternBounds = {};
+  bool isPatternBoundsSet = false;
 
 public:
   PillarMask(LSPtrType passedSubstrate, LSPtrType passedMask)
@@ -24,7 +30,24 @@ public:
 
   void setLineDistance(T distance) { lineDistance = distance; }
 
+  /// Lateral bounds (xmin, xmax, ymin, ymax) of the whole pillar field.
+  /// Defaults to the bounds of the domain. Set it to the bounds of the full
+  /// domain if the mask is only built on a part of it, e.g. on one tile of
+  /// TiledBoschProcess, so that the pillars stay in place.
+  void setPatternBounds(std::array<T, 4> bounds) {
+    patternBounds = bounds;
+    isPatternBoundsSet = true;
+  }
+
+  /// Time, peak memory and allocations of building the mask, including
+  /// all temporary level sets.
+  const std::vector<BoschStageStatistics> &getStageStatistics() const {
+    return memoryTracker.getStatistics();
+  }
+
   void apply() {
+    memoryTracker.clear();
+    memoryTracker.beginStage("mask");
     auto &grid = substrate->getGrid();
     auto &boundaryCons = grid.getBoundaryConditions();
     auto gridDelta = grid.getGridDelta();
@@ -37,39 +60,53 @@ public:
     // std::cout << "domainBounds: " << domainBounds << std::endl;
     // std::cout << "linDistance:  " << lineDistance << std::endl;
     // std::cout << "maskRadius:   " << maskRadius << std::endl;
+    if (!isPatternBoundsSet) {
+      for (unsigned i = 0; i < 4; ++i)
+        patternBounds[i] = domainBounds[i];
+    }
+
     std::array<T, 3> maskVec;
     for (unsigned i = 0; i < 2; ++i) {
-      maskVec[i] = domainBounds[2 * i] + 0.5 * lineDistance + maskRadius;
+      maskVec[i] = patternBounds[2 * i] + 0.5 * lineDistance + maskRadius;
     }
     maskVec[2] = maskOrigin[2] - gridDelta;
 
     // while y is within bounds
     unsigned yLines = 1;
     double axis[3] = {0.0, 0.0, 1.0};
-    while (maskVec[1] < domainBounds[3]) {
+    while (maskVec[1] < patternBounds[3]) {
+      // only pillars which reach into the domain
+      bool isInDomain = true;
+      for (unsigned i = 0; i < 2; ++i) {
+        isInDomain &=
+            maskVec[i] + maskRadius + gridDelta >= domainBounds[2 * i] &&
+            maskVec[i] - maskRadius - gridDelta <= domainBounds[2 * i + 1];
+      }
       // std::cout << "maskVec: " << maskVec[0] << ", " << maskVec[1] <<
       // std::endl; make single cylinder at maskVec
-      auto maskSpot = LSPtrType::New(grid);
-      viennals::MakeGeometry<T, 3>(
-          maskSpot, viennals::SmartPointer<viennals::Sphere<T, D>>::New(
-                        maskVec.data(), maskRadius))
-          .apply();
-      // viennals::MakeGeometry<T, 3>(maskSpot,
-      //                       viennals::SmartPointer<lsCylinder<T, D>>::New(
-      //                           maskVec.data(), axis,
-      //                           maskHeight + 2 * gridDelta, maskRadius))
-      //     .apply();
-      // add cylinder to whole mask
-      viennals::BooleanOperation<T, 3>(mask, maskSpot,
-                                       viennals::BooleanOperationEnum::UNION)
-          .apply();
+      if (isInDomain) {
+        auto maskSpot = LSPtrType::New(grid);
+        viennals::MakeGeometry<T, 3>(
+            maskSpot, viennals::SmartPointer<viennals::Sphere<T, D>>::New(
+                          maskVec.data(), maskRadius))
+            .apply();
+        // viennals::MakeGeometry<T, 3>(maskSpot,
+        //                       viennals::SmartPointer<lsCylinder<T, D>>::New(
+        //                           maskVec.data(), axis,
+        //                           maskHeight + 2 * gridDelta, maskRadius))
+        //     .apply();
+        // add cylinder to whole mask
+        viennals::BooleanOperation<T, 3>(mask, maskSpot,
+                                         viennals::BooleanOperationEnum::UNION)
+            .apply();
+      }
 
       // advance maskVec in x direction
       maskVec[0] += 2 * (lineDistance + 2 * maskRadius);
       // if outside of x-range, advance y direction
-      if (maskVec[0] > domainBounds[1]) {
-        maskVec[0] = domainBounds[2] + (((yLines++) % 2) ? 1.5 : 0.5) *
-                                           (lineDistance + 2 * maskRadius);
+      if (maskVec[0] > patternBounds[1]) {
+        maskVec[0] = patternBounds[2] + (((yLines++) % 2) ? 1.5 : 0.5) *
+                                            (lineDistance + 2 * maskRadius);
         maskVec[1] += lineDistance + 2 * maskRadius;
       }
     }
@@ -88,5 +125,9 @@ public:
     viennals::BooleanOperation<T, 3>(mask, maskBottom,
                                      viennals::BooleanOperationEnum::INTERSECT)
         .apply();
+
+    memoryTracker.endStage(substrate, mask);
   }
-};
\ No newline at end of file
+};
+
+DRIE_PRECOMPILE_SPECIALIZE(PillarMask, 3);
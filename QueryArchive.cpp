@@ -0,0 +1,100 @@
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <lsToSurfaceMesh.hpp>
+#include <lsVTKWriter.hpp>
+
+#include "BoschArchive.hpp"
+
+using namespace viennals;
+
+typedef double NumericType;
+
+// Queries an archive of a parameter campaign, e.g. dream.drarc written by
+// DREAM:
+//
+//   QueryArchive <archive>                      all runs as CSV
+//   QueryArchive <archive> <field> <min> <max>  runs with field in range
+//   QueryArchive <archive> extract <name>       surface of one run
+//
+// Only the index of the archive is read for queries, and only the record
+// of the run for extracting its surface.
+
+template <int D>
+void printRuns(const BoschArchiveReader<NumericType, D> &reader,
+               const std::vector<std::size_t> &runs) {
+  std::cout << "name";
+  for (auto &field : reader.getFields())
+    std::cout << "," << field;
+  std::cout << ",numPoints" << std::endl;
+  std::cout.precision(std::numeric_limits<double>::max_digits10);
+  for (auto run : runs) {
+    std::cout << reader.getName(run);
+    for (auto &field : reader.getFields())
+      std::cout << "," << reader.getValue(run, field);
+    std::cout << "," << reader.getNumberOfPoints(run) << std::endl;
+  }
+}
+
+template <int D> int query(int argc, char **argv) {
+  BoschArchiveReader<NumericType, D> reader(argv[1]);
+  if (!reader.apply())
+    return 1;
+
+  if (argc == 2) {
+    std::vector<std::size_t> runs(reader.getNumberOfRuns());
+    for (std::size_t run = 0; run < runs.size(); ++run)
+      runs[run] = run;
+    printRuns(reader, runs);
+    return 0;
+  }
+
+  if (argc == 4 && std::string(argv[2]) == "extract") {
+    const auto run = reader.findRun(argv[3]);
+    if (run == reader.getNumberOfRuns()) {
+      std::cout << "No run " << argv[3] << std::endl;
+      return 1;
+    }
+    auto levelSet = reader.getGeometry(run);
+    if (levelSet == nullptr) {
+      std::cout << "The geometry of " << argv[3] << " is damaged"
+                << std::endl;
+      return 1;
+    }
+    auto mesh = SmartPointer<Mesh<NumericType>>::New();
+    ToSurfaceMesh<NumericType, D>(levelSet, mesh).apply();
+    VTKWriter(mesh, std::string(argv[3]) + ".vtp").apply();
+    return 0;
+  }
+
+  if (argc == 5) {
+    printRuns(reader, reader.findRuns(argv[2], std::stod(argv[3]),
+                                      std::stod(argv[4])));
+    return 0;
+  }
+
+  std::cout << "Usage: " << argv[0]
+            << " <archive> [<field> <min> <max> | extract <name>]"
+            << std::endl;
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0]
+              << " <archive> [<field> <min> <max> | extract <name>]"
+              << std::endl;
+    return 1;
+  }
+
+  switch (BoschArchiveReader<NumericType, 2>::readDimension(argv[1])) {
+  case 2:
+    return query<2>(argc, argv);
+  case 3:
+    return query<3>(argc, argv);
+  default:
+    std::cout << "Cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+}
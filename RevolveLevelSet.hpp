@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+#include <vcLogger.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Revolves a 2D (r, z) level set around its y-axis (x = 0) into a 3D
+/// level set. The 2D level set must be symmetric about x = 0 and extend
+/// laterally at least to the largest radius of the 3D domain, so that
+/// rotationally symmetric structures can be simulated in 2D and only
+/// converted to 3D for output.
+template <class T> class RevolveLevelSet {
+  using LSPtr2DType = viennals::SmartPointer<viennals::Domain<T, 2>>;
+  using LSPtr3DType = viennals::SmartPointer<viennals::Domain<T, 3>>;
+
+  LSPtr2DType profile;
+  LSPtr3DType levelSet;
+  std::array<T, 3> axisOrigin = {};
+
+public:
+  RevolveLevelSet(LSPtr2DType passedProfile, LSPtr3DType passedLevelSet)
+      : profile(passedProfile), levelSet(passedLevelSet) {}
+
+  /// Lateral position of the rotation axis in the 3D domain.
+  void setAxisOrigin(std::array<T, 3> origin) { axisOrigin = origin; }
+
+  void apply() {
+    const auto &grid = levelSet->getGrid();
+    const double gridDelta = grid.getGridDelta();
+    if (std::abs(profile->getGrid().getGridDelta() - gridDelta) >
+        1e-6 * gridDelta) {
+      viennacore::Logger::getInstance().addError(
+          "RevolveLevelSet: Profile and level set must have the same "
+          "gridDelta!");
+      return;
+    }
+
+    // copy the r >= 0 half of the profile into a dense table
+    int minIndex[2] = {std::numeric_limits<int>::max(),
+                       std::numeric_limits<int>::max()};
+    int maxIndex[2] = {std::numeric_limits<int>::lowest(),
+                       std::numeric_limits<int>::lowest()};
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, 2>::DomainType>
+             it(profile->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || it.getStartIndices()[0] < 0)
+        continue;
+      for (unsigned i = 0; i < 2; ++i) {
+        minIndex[i] = std::min(minIndex[i], it.getStartIndices()[i]);
+        maxIndex[i] = std::max(maxIndex[i], it.getStartIndices()[i]);
+      }
+    }
+    if (maxIndex[1] < minIndex[1]) {
+      viennacore::Logger::getInstance()
+          .addWarning("RevolveLevelSet: Profile is empty.")
+          .print();
+      return;
+    }
+
+    const int numR = maxIndex[0] + 1;
+    const int numZ = maxIndex[1] - minIndex[1] + 1;
+    const T undefined = std::numeric_limits<T>::max();
+    std::vector<T> table(std::size_t(numR) * numZ, undefined);
+    for (viennahrle::ConstSparseIterator<
+             typename viennals::Domain<T, 2>::DomainType>
+             it(profile->getDomain());
+         !it.isFinished(); ++it) {
+      if (!it.isDefined() || it.getStartIndices()[0] < 0)
+        continue;
+      const auto &index = it.getStartIndices();
+      table[std::size_t(index[1] - minIndex[1]) * numR + index[0]] =
+          it.getValue();
+    }
+
+    // the profile must cover the corners of the 3D domain
+    const double axis[2] = {axisOrigin[0] / gridDelta,
+                            axisOrigin[1] / gridDelta};
+    double maxCornerRadius = 0.;
+    for (unsigned i = 0; i < 4; ++i) {
+      const double x = ((i & 1) ? grid.getMaxGridPoint(0)
+                                : grid.getMinGridPoint(0)) -
+                       axis[0];
+      const double y = ((i & 2) ? grid.getMaxGridPoint(1)
+                                : grid.getMinGridPoint(1)) -
+                       axis[1];
+      maxCornerRadius = std::max(maxCornerRadius, std::sqrt(x * x + y * y));
+    }
+    if (maxCornerRadius > profile->getGrid().getMaxGridPoint(0)) {
+      viennacore::Logger::getInstance()
+          .addWarning("RevolveLevelSet: Profile does not reach the corners "
+                      "of the 3D domain. Increase its lateral extent.")
+          .print();
+    }
+
+    const T valueLimit = 1.;
+    std::vector<typename viennals::Domain<T, 3>::PointValueVectorType>
+        rowPoints(numZ);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int row = 0; row < numZ; ++row) {
+      const T *values = &table[std::size_t(row) * numR];
+      auto &points = rowPoints[row];
+
+      // revolve every run of consecutive defined radii as an annulus
+      int runStart = 0;
+      while (runStart < numR) {
+        if (values[runStart] == undefined) {
+          ++runStart;
+          continue;
+        }
+        int runEnd = runStart;
+        while (runEnd + 1 < numR && values[runEnd + 1] != undefined)
+          ++runEnd;
+
+        const double rMin = runStart, rMax = runEnd;
+        const int xMin =
+            std::max<int>(std::ceil(axis[0] - rMax), grid.getMinGridPoint(0));
+        const int xMax = std::min<int>(std::floor(axis[0] + rMax),
+                                       grid.getMaxGridPoint(0));
+        for (int x = xMin; x <= xMax; ++x) {
+          const double dx = x - axis[0];
+          const double outer = std::sqrt(std::max(rMax * rMax - dx * dx, 0.));
+          const double inner2 = rMin * rMin - dx * dx;
+
+          // the column crosses the annulus once, or twice if it passes
+          // through its hole
+          double ranges[2][2] = {{-outer - 1e-9, outer + 1e-9}, {0., -1.}};
+          if (inner2 > 0.) {
+            const double inner = std::sqrt(inner2);
+            ranges[0][1] = -inner + 1e-9;
+            ranges[1][0] = inner - 1e-9;
+            ranges[1][1] = outer + 1e-9;
+          }
+          for (auto &range : ranges) {
+            const int yMin = std::max<int>(std::ceil(axis[1] + range[0]),
+                                           grid.getMinGridPoint(1));
+            const int yMax = std::min<int>(std::floor(axis[1] + range[1]),
+                                           grid.getMaxGridPoint(1));
+            for (int y = yMin; y <= yMax; ++y) {
+              const double dy = y - axis[1];
+              const double r = std::sqrt(dx * dx + dy * dy);
+              if (r < rMin - 1e-6 || r > rMax + 1e-6)
+                continue;
+
+              // interpolate linearly between the neighbouring radii
+              const int r0 = std::min(std::max<int>(std::floor(r), runStart),
+                                      std::max(runEnd - 1, runStart));
+              const double t = std::min(std::max(r - r0, 0.), 1.);
+              const T value = (runEnd > runStart)
+                                  ? (1 - t) * values[r0] + t * values[r0 + 1]
+                                  : values[r0];
+
+              if (std::abs(value) <= valueLimit) {
+                viennahrle::Index<3> index;
+                index[0] = x;
+                index[1] = y;
+                index[2] = row + minIndex[1];
+                points.push_back(std::make_pair(index, value));
+              }
+            }
+          }
+        }
+        runStart = runEnd + 1;
+      }
+    }
+
+    typename viennals::Domain<T, 3>::PointValueVectorType pointData;
+    for (auto &points : rowPoints)
+      pointData.insert(pointData.end(), points.begin(), points.end());
+
+    levelSet->insertPoints(pointData);
+    levelSet->getDomain().segment();
+    levelSet->finalize(2);
+    if (profile->getLevelSetWidth() > 2)
+      viennals::Expand<T, 3>(levelSet, profile->getLevelSetWidth()).apply();
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(RevolveLevelSet);
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+#include <lsMesh.hpp>
+#include <vcLogger.hpp>
+
+#include "DRIEPreCompileMacros.hpp"
+
+/// Extracts a vertical cross-section of a 3D level set without meshing its
+/// surface. The section plane passes through planeOrigin along the
+/// horizontal planeDirection; its 2D coordinates are the distance s from
+/// planeOrigin along planeDirection and the height z. The 3D level set is
+/// interpolated bilinearly onto the section grid, which has the gridDelta
+/// of the 3D level set, row by row in parallel, so the cost only scales
+/// with the area of the section. Planes along x or y through grid points
+/// are sampled exactly. The section is returned as the profile contour,
+/// a line mesh with nodes (s, z, 0), and/or as a 2D level set.
+template <class T> class SliceLevelSet {
+  using LSPtr2DType = viennals::SmartPointer<viennals::Domain<T, 2>>;
+  using LSPtr3DType = viennals::SmartPointer<viennals::Domain<T, 3>>;
+  using MeshPtrType = viennals::SmartPointer<viennals::Mesh<T>>;
+  using Segment = std::array<std::uint64_t, 2>;
+
+  LSPtr3DType levelSet;
+  LSPtr2DType slice;
+  MeshPtrType contour;
+  std::array<T, 3> planeOrigin = {};
+  std::array<T, 2> planeDirection = {1., 0.};
+
+  static constexpr T undefinedValue = std::numeric_limits<T>::max();
+
+  // dense table of the sampled section, numS values per row of z
+  std::vector<T> table;
+  int numS = 0;
+  int numZ = 0;
+
+  static bool isNegative(T value) { return value < 0; }
+
+  // key of the horizontal (direction 0) or vertical (direction 1) edge
+  // starting at sample (s, z) of the table
+  std::uint64_t edgeKey(int s, int z, int direction) const {
+    return ((std::uint64_t(z) * numS + s) << 1) | direction;
+  }
+
+  // position of the zero crossing on an edge, in table units
+  std::array<double, 2> crossing(std::uint64_t key) const {
+    const int direction = key & 1;
+    const std::uint64_t sample = key >> 1;
+    const int s = sample % numS;
+    const int z = sample / numS;
+    const T a = table[sample];
+    const T b = table[sample + (direction ? numS : 1)];
+    double t = 0.5;
+    if (std::abs(a) != undefinedValue && std::abs(b) != undefinedValue &&
+        a != b)
+      t = std::min(std::max(double(a) / (double(a) - b), 0.), 1.);
+    return {s + (direction ? 0. : t), z + (direction ? t : 0.)};
+  }
+
+  // marching squares on one row of cells; the material (negative values)
+  // lies on the left of every segment, as for ToSurfaceMesh
+  void contourRow(int z, std::vector<Segment> &segments) const {
+    for (int s = 0; s + 1 < numS; ++s) {
+      // corners and edges in counter-clockwise order
+      const T corners[4] = {
+          table[std::size_t(z) * numS + s],
+          table[std::size_t(z) * numS + s + 1],
+          table[std::size_t(z + 1) * numS + s + 1],
+          table[std::size_t(z + 1) * numS + s]};
+      const std::uint64_t edges[4] = {edgeKey(s, z, 0), edgeKey(s + 1, z, 1),
+                                      edgeKey(s, z + 1, 0),
+                                      edgeKey(s, z, 1)};
+
+      // a contour leaves the material on edges from a negative to a
+      // positive corner and enters it on the others
+      int leaving[2], entering[2];
+      int numLeaving = 0, numEntering = 0;
+      for (int e = 0; e < 4; ++e) {
+        const bool from = isNegative(corners[e]);
+        const bool to = isNegative(corners[(e + 1) % 4]);
+        if (from && !to)
+          leaving[numLeaving++] = e;
+        else if (!from && to)
+          entering[numEntering++] = e;
+      }
+
+      if (numLeaving == 1) {
+        segments.push_back({edges[leaving[0]], edges[entering[0]]});
+      } else if (numLeaving == 2) {
+        // saddle: the value at the centre decides whether the negative
+        // corners are connected
+        T centre = 0;
+        for (auto corner : corners)
+          centre += std::max<T>(std::min<T>(corner, 1), -1) / 4;
+        for (int i = 0; i < 2; ++i) {
+          const int e = leaving[i];
+          const int partner = isNegative(centre) ? (e + 1) % 4 : (e + 3) % 4;
+          segments.push_back({edges[e], edges[partner]});
+        }
+      }
+    }
+  }
+
+  static double segmentDistance(const std::array<double, 2> &p,
+                                const std::array<double, 2> &a,
+                                const std::array<double, 2> &b) {
+    const double ab[2] = {b[0] - a[0], b[1] - a[1]};
+    const double ap[2] = {p[0] - a[0], p[1] - a[1]};
+    const double length2 = ab[0] * ab[0] + ab[1] * ab[1];
+    double t = 0.;
+    if (length2 > 0.)
+      t = std::min(std::max((ap[0] * ab[0] + ap[1] * ab[1]) / length2, 0.),
+                   1.);
+    const double d[2] = {ap[0] - t * ab[0], ap[1] - t * ab[1]};
+    return std::sqrt(d[0] * d[0] + d[1] * d[1]);
+  }
+
+public:
+  SliceLevelSet(LSPtr3DType passedLevelSet) : levelSet(passedLevelSet) {}
+
+  /// Point on the section plane. Only x and y are used.
+  void setPlaneOrigin(std::array<T, 3> origin) { planeOrigin = origin; }
+
+  /// Horizontal direction of the section plane, which becomes the s-axis
+  /// of the section. Does not need to be normalised.
+  void setPlaneDirection(std::array<T, 2> direction) {
+    planeDirection = direction;
+  }
+
+  /// 2D level set of the section. It is overwritten and gets the level set
+  /// width of the 3D level set.
+  void setSlice(LSPtr2DType passedSlice) { slice = passedSlice; }
+
+  /// Mesh receiving the lines of the profile contour. It is overwritten.
+  void setContour(MeshPtrType passedContour) { contour = passedContour; }
+
+  void apply() {
+    const auto &grid = levelSet->getGrid();
+    const double gridDelta = grid.getGridDelta();
+    const double length = std::sqrt(planeDirection[0] * planeDirection[0] +
+                                    planeDirection[1] * planeDirection[1]);
+    if (length == 0.) {
+      viennacore::Logger::getInstance().addError(
+          "SliceLevelSet: Plane direction must not be zero!");
+      return;
+    }
+    const double direction[2] = {planeDirection[0] / length,
+                                 planeDirection[1] / length};
+    const double origin[2] = {planeOrigin[0] / gridDelta,
+                              planeOrigin[1] / gridDelta};
+
+    // part of the plane inside the lateral bounds of the 3D grid
+    double sRange[2] = {std::numeric_limits<double>::lowest(),
+                        std::numeric_limits<double>::max()};
+    for (unsigned i = 0; i < 2; ++i) {
+      const double lower = grid.getMinGridPoint(i) - origin[i];
+      const double upper = grid.getMaxGridPoint(i) - origin[i];
+      if (std::abs(direction[i]) < 1e-12) {
+        if (lower > 1e-9 || upper < -1e-9)
+          sRange[1] = sRange[0];
+        continue;
+      }
+      const double a = lower / direction[i], b = upper / direction[i];
+      sRange[0] = std::max(sRange[0], std::min(a, b));
+      sRange[1] = std::min(sRange[1], std::max(a, b));
+    }
+    if (sRange[1] - sRange[0] < 1.) {
+      viennacore::Logger::getInstance()
+          .addWarning("SliceLevelSet: Plane does not cut the level set.")
+          .print();
+      return;
+    }
+    const int sMin = std::ceil(sRange[0] - 1e-9);
+    const int sMax = std::floor(sRange[1] + 1e-9);
+    const int zMin = grid.getMinGridPoint(2);
+    const int zMax = grid.getMaxGridPoint(2);
+    numS = sMax - sMin + 1;
+    numZ = zMax - zMin + 1;
+    table.assign(std::size_t(numS) * numZ, undefinedValue);
+
+    // lateral grid cell and weights of every column of the section; planes
+    // through grid points need only one or two of the four corners
+    struct Column {
+      viennahrle::IndexType x, y;
+      double weights[4];
+    };
+    std::vector<Column> columns(numS);
+    for (int s = 0; s < numS; ++s) {
+      double position[2];
+      viennahrle::IndexType cell[2];
+      double t[2];
+      for (unsigned i = 0; i < 2; ++i) {
+        position[i] = origin[i] + (s + sMin) * direction[i];
+        cell[i] = std::floor(position[i] + 1e-9);
+        t[i] = std::max(position[i] - cell[i], 0.);
+        if (t[i] < 1e-9)
+          t[i] = 0.;
+        if (cell[i] >= grid.getMaxGridPoint(i)) {
+          cell[i] = grid.getMaxGridPoint(i);
+          t[i] = 0.;
+        }
+      }
+      columns[s] = {cell[0],
+                    cell[1],
+                    {(1 - t[0]) * (1 - t[1]), t[0] * (1 - t[1]),
+                     (1 - t[0]) * t[1], t[0] * t[1]}};
+    }
+
+#pragma omp parallel
+    {
+      viennahrle::ConstSparseIterator<
+          typename viennals::Domain<T, 3>::DomainType>
+          it(levelSet->getDomain());
+
+#pragma omp for schedule(dynamic)
+      for (int z = 0; z < numZ; ++z) {
+        T *row = &table[std::size_t(z) * numS];
+        for (int s = 0; s < numS; ++s) {
+          const auto &column = columns[s];
+          double value = 0.;
+          double heaviest = -1.;
+          T sign = 1;
+          bool isDefined = true;
+          for (unsigned corner = 0; corner < 4; ++corner) {
+            const double weight = column.weights[corner];
+            if (weight == 0.)
+              continue;
+            viennahrle::Index<3> index;
+            index[0] = column.x + (corner & 1);
+            index[1] = column.y + (corner >> 1);
+            index[2] = z + zMin;
+            it.goToIndices(index);
+            const T cornerValue = it.getValue();
+            if (it.isDefined())
+              value += weight * cornerValue;
+            else
+              isDefined = false;
+            if (weight > heaviest) {
+              heaviest = weight;
+              sign = isNegative(cornerValue) ? -1 : 1;
+            }
+          }
+          row[s] = isDefined ? T(value) : sign * undefinedValue;
+        }
+      }
+    }
+
+    // profile contour, generated per row of cells
+    std::vector<std::vector<Segment>> rowSegments(numZ - 1);
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < numZ - 1; ++z)
+      contourRow(z, rowSegments[z]);
+
+    if (contour != nullptr) {
+      contour->clear();
+      std::unordered_map<std::uint64_t, unsigned> nodeIds;
+      for (auto &segments : rowSegments) {
+        for (auto &segment : segments) {
+          std::array<unsigned, 2> line;
+          for (unsigned i = 0; i < 2; ++i) {
+            auto inserted = nodeIds.emplace(segment[i], 0);
+            if (inserted.second) {
+              const auto position = crossing(segment[i]);
+              inserted.first->second = contour->insertNextNode(
+                  {T((position[0] + sMin) * gridDelta),
+                   T((position[1] + zMin) * gridDelta), T(0)});
+            }
+            line[i] = inserted.first->second;
+          }
+          if (line[0] != line[1])
+            contour->insertNextLine(line);
+        }
+      }
+    }
+
+    if (slice == nullptr)
+      return;
+
+    // signed distances to the contour of all points next to it; a segment
+    // of cell row r only reaches the points of rows r - 1 to r + 2
+    const T valueLimit = 1.;
+    std::vector<typename viennals::Domain<T, 2>::PointValueVectorType>
+        rowPoints(numZ);
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < numZ; ++z) {
+      std::vector<double> distances(numS, valueLimit + 1.);
+      for (int r = std::max(z - 2, 0); r <= std::min(z + 1, numZ - 2); ++r) {
+        for (auto &segment : rowSegments[r]) {
+          const auto a = crossing(segment[0]);
+          const auto b = crossing(segment[1]);
+          const int first =
+              std::max<int>(std::ceil(std::min(a[0], b[0]) - valueLimit), 0);
+          const int last = std::min<int>(
+              std::floor(std::max(a[0], b[0]) + valueLimit), numS - 1);
+          for (int s = first; s <= last; ++s)
+            distances[s] = std::min(distances[s],
+                                    segmentDistance({double(s), double(z)},
+                                                    a, b));
+        }
+      }
+      for (int s = 0; s < numS; ++s) {
+        if (distances[s] > valueLimit)
+          continue;
+        viennahrle::Index<2> index;
+        index[0] = s + sMin;
+        index[1] = z + zMin;
+        const T value = isNegative(table[std::size_t(z) * numS + s])
+                            ? -distances[s]
+                            : distances[s];
+        rowPoints[z].push_back(std::make_pair(index, value));
+      }
+    }
+
+    typename viennals::Domain<T, 2>::PointValueVectorType pointData;
+    for (auto &points : rowPoints)
+      pointData.insert(pointData.end(), points.begin(), points.end());
+
+    viennahrle::IndexType minIndex[2] = {sMin, zMin};
+    viennahrle::IndexType maxIndex[2] = {sMax, zMax};
+    typename viennals::Domain<T, 2>::BoundaryType boundaryCons[2] = {
+        viennals::BoundaryConditionEnum::REFLECTIVE_BOUNDARY,
+        grid.getBoundaryConditions(2)};
+    auto newSlice = LSPtr2DType::New(typename viennals::Domain<T, 2>::GridType(
+        minIndex, maxIndex, gridDelta, boundaryCons));
+    newSlice->insertPoints(pointData);
+    newSlice->getDomain().segment();
+    newSlice->finalize(2);
+    if (levelSet->getLevelSetWidth() > 2)
+      viennals::Expand<T, 2>(newSlice, levelSet->getLevelSetWidth()).apply();
+    slice->deepCopy(newSlice);
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION(SliceLevelSet);
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include <lsDomain.hpp>
+#include <lsExpand.hpp>
+#include <lsReader.hpp>
+#include <lsWriter.hpp>
+#include <vcLogger.hpp>
+
+#include "BoschCostEstimate.hpp"
+#include "BoschMemory.hpp"
+#include "BoschProcess.hpp"
+#include "DRIEPreCompileMacros.hpp"
+
+/// Runs a Bosch process on a large lateral domain, e.g. a pillar field,
+/// tile by tile. The lateral domain is split into tiles of at most
+/// setTileSize() and every tile is extended by a halo which is wider than
+/// the maximum lateral reach of the etch (see
+/// BoschProcess::getMaximumLateralReach). The boundaries of the extended
+/// tile are reflective, so the etch within the core of the tile is the
+/// same as on the whole domain. Every tile builds its own mask and
+/// substrate, runs the process and writes both level sets to the spill
+/// directory, so only the tiles which currently run are held in memory.
+///
+/// The largest tile runs alone and its level set sizes give the memory
+/// footprint of a tile, see BoschCostCoefficients::bytesPerPoint. Then as
+/// many tiles run at once as fit into the memory budget, sharing the
+/// threads. The processes of the tiles are silent and, while several run
+/// at once, no stage resets the peak resident set size of the process
+/// (see BoschMemoryTracker::setResetPeakResident). stitch() combines the
+/// cores of all tiles into level sets on the whole domain, which have to
+/// fit into memory.
+///
+/// The mask function must place the mask at the same global positions on
+/// every tile, e.g. PillarMask::setPatternBounds with the lateral bounds
+/// of the whole domain.
+template <class T, int D> class TiledBoschProcess {
+  using LSPtrType = viennals::SmartPointer<viennals::Domain<T, D>>;
+  using MaskFunctionType = std::function<void(LSPtrType, LSPtrType)>;
+  using RecipeType = std::function<void(BoschProcess<T, D> &)>;
+
+  struct Tile {
+    // lateral grid indices of the core of the tile; the upper index is
+    // only part of the core for the last tile along an axis
+    std::array<int, D - 1> coreMin;
+    std::array<int, D - 1> coreMax;
+    // grid indices of the tile including the halo
+    viennahrle::IndexType minIndex[D];
+    viennahrle::IndexType maxIndex[D];
+    std::string name;
+  };
+
+  std::array<double, 2 * D> bounds = {};
+  double gridDelta = 1.;
+  MaskFunctionType maskFunction;
+  RecipeType recipe;
+  T tileSize = 0.;
+  std::filesystem::path spillDirectory = "tiles";
+  std::uint64_t memoryBudget = 0;
+  unsigned marginCells = 4;
+  BoschCostCoefficients coefficients;
+
+  std::vector<Tile> tiles;
+  std::array<int, D - 1> globalMax = {};
+  std::uint64_t tileFootprint = 0;
+  unsigned numConcurrentTiles = 1;
+
+  typename viennals::Domain<T, D>::BoundaryType boundaryCons[D];
+
+  std::filesystem::path getFileName(const Tile &tile,
+                                    const std::string &levelSet) const {
+    return spillDirectory / (tile.name + "_" + levelSet + ".lvst");
+  }
+
+  void makeTiles(int haloCells) {
+    tiles.clear();
+    // without a tile size, the tiles are as wide as the domain along x
+    const T size = (tileSize > 0.) ? tileSize : bounds[1] - bounds[0];
+    const int tileCells = std::max<int>(1, std::lround(size / gridDelta));
+
+    std::array<int, D - 1> globalMin, numTiles;
+    unsigned totalTiles = 1;
+    for (unsigned i = 0; i < D - 1; ++i) {
+      // as in the constructor of viennals::Domain
+      globalMin[i] = std::floor(bounds[2 * i] / gridDelta);
+      globalMax[i] = std::ceil(bounds[2 * i + 1] / gridDelta);
+      numTiles[i] = std::max(
+          1, (globalMax[i] - globalMin[i] + tileCells - 1) / tileCells);
+      totalTiles *= numTiles[i];
+    }
+
+    for (unsigned t = 0; t < totalTiles; ++t) {
+      Tile tile;
+      tile.name = "tile";
+      unsigned rest = t;
+      for (unsigned i = 0; i < D - 1; ++i) {
+        const int k = rest % numTiles[i];
+        rest /= numTiles[i];
+        tile.coreMin[i] = globalMin[i] + k * tileCells;
+        tile.coreMax[i] =
+            std::min(tile.coreMin[i] + tileCells, globalMax[i]);
+        tile.minIndex[i] =
+            std::max(globalMin[i], tile.coreMin[i] - haloCells);
+        tile.maxIndex[i] =
+            std::min(globalMax[i], tile.coreMax[i] + haloCells);
+        tile.name += "_" + std::to_string(k);
+      }
+      tile.minIndex[D - 1] = std::floor(bounds[2 * D - 2] / gridDelta);
+      tile.maxIndex[D - 1] = std::ceil(bounds[2 * D - 1] / gridDelta);
+      tiles.push_back(tile);
+    }
+  }
+
+  // returns the statistics of the process stages
+  std::vector<BoschStageStatistics> runTile(const Tile &tile) const {
+    // the grid is built from indices, so that it lines up with the grid
+    // of the whole domain
+    typename viennals::Domain<T, D>::GridType grid(
+        tile.minIndex, tile.maxIndex, gridDelta, boundaryCons);
+    auto mask = LSPtrType::New(grid);
+    auto substrate = LSPtrType::New(grid);
+    maskFunction(substrate, mask);
+
+    BoschProcess<T, D> process;
+    recipe(process);
+    process.setVerbose(false);
+    process.setSubstrate(substrate);
+    process.setMask(mask);
+    process.apply();
+
+    viennals::Writer<T, D>(substrate,
+                           getFileName(tile, "substrate").string())
+        .apply();
+    viennals::Writer<T, D>(mask, getFileName(tile, "mask").string()).apply();
+
+    return process.getStageStatistics();
+  }
+
+  // number of lateral grid points of a tile including the halo
+  static std::uint64_t getLateralPoints(const Tile &tile) {
+    std::uint64_t points = 1;
+    for (unsigned i = 0; i < D - 1; ++i)
+      points *= tile.maxIndex[i] - tile.minIndex[i] + 1;
+    return points;
+  }
+
+  bool isInCore(const Tile &tile, const viennahrle::Index<D> &index) const {
+    for (unsigned i = 0; i < D - 1; ++i) {
+      if (index[i] < tile.coreMin[i])
+        return false;
+      if (index[i] >= tile.coreMax[i] &&
+          !(index[i] == globalMax[i] && tile.coreMax[i] == globalMax[i]))
+        return false;
+    }
+    return true;
+  }
+
+  void stitchLevelSet(LSPtrType levelSet, const std::string &name) const {
+    const T valueLimit = 1.;
+    typename viennals::Domain<T, D>::PointValueVectorType pointData;
+    int width = 2;
+    for (auto &tile : tiles) {
+      auto tileLevelSet = LSPtrType::New();
+      viennals::Reader<T, D>(tileLevelSet, getFileName(tile, name).string())
+          .apply();
+      width = std::max(width, tileLevelSet->getLevelSetWidth());
+      for (viennahrle::ConstSparseIterator<
+               typename viennals::Domain<T, D>::DomainType>
+               it(tileLevelSet->getDomain());
+           !it.isFinished(); ++it) {
+        if (!it.isDefined() || std::abs(it.getValue()) > valueLimit ||
+            !isInCore(tile, it.getStartIndices()))
+          continue;
+        pointData.push_back(
+            std::make_pair(it.getStartIndices(), it.getValue()));
+      }
+    }
+
+    levelSet->insertPoints(pointData);
+    levelSet->getDomain().segment();
+    levelSet->finalize(2);
+    if (width > 2)
+      viennals::Expand<T, D>(levelSet, width).apply();
+  }
+
+public:
+  TiledBoschProcess() {
+    for (unsigned i = 0; i < D - 1; ++i)
+      boundaryCons[i] = viennals::BoundaryConditionEnum::REFLECTIVE_BOUNDARY;
+    boundaryCons[D - 1] = viennals::BoundaryConditionEnum::INFINITE_BOUNDARY;
+  }
+
+  /// Bounds of the whole domain.
+  void setBounds(const std::array<double, 2 * D> &passedBounds) {
+    bounds = passedBounds;
+  }
+
+  void setGridDelta(double passedGridDelta) { gridDelta = passedGridDelta; }
+
+  /// Builds the substrate and the mask on the empty level sets of a tile,
+  /// called as maskFunction(substrate, mask).
+  void setMaskFunction(MaskFunctionType passedMaskFunction) {
+    maskFunction = passedMaskFunction;
+  }
+
+  /// Sets the parameters of the process of every tile.
+  void setRecipe(RecipeType passedRecipe) { recipe = passedRecipe; }
+
+  /// Lateral length of the core of a tile, rounded to the grid. Tiles at
+  /// the upper bounds may be smaller.
+  void setTileSize(T size) { tileSize = size; }
+
+  /// Directory of the level sets of the tiles. Defaults to "tiles".
+  void setSpillDirectory(std::filesystem::path directory) {
+    spillDirectory = directory;
+  }
+
+  /// Resident memory in bytes which the tiles running at the same time may
+  /// use. With the default of 0, the tiles run one after the other.
+  void setMemoryBudget(std::uint64_t bytes) { memoryBudget = bytes; }
+
+  /// Number of grid cells the halo extends beyond the maximum lateral
+  /// reach of the etch. Defaults to 4.
+  void setMarginCells(unsigned cells) { marginCells = cells; }
+
+  std::size_t getNumberOfTiles() const { return tiles.size(); }
+
+  /// Coefficients which give the memory footprint of a tile from its level
+  /// set points, e.g. fitted by BoschCostCalibration.
+  void setCostCoefficients(const BoschCostCoefficients &passedCoefficients) {
+    coefficients = passedCoefficients;
+  }
+
+  /// Memory footprint of a tile in bytes, estimated from the level set
+  /// points of the largest tile: the mask and twice the largest substrate,
+  /// as in BoschCostEstimator.
+  std::uint64_t getTileFootprint() const { return tileFootprint; }
+
+  unsigned getNumberOfConcurrentTiles() const { return numConcurrentTiles; }
+
+  void apply() {
+    if (!maskFunction || !recipe) {
+      viennacore::Logger::getInstance().addError(
+          "TiledBoschProcess: Mask function and recipe must be set!");
+      return;
+    }
+
+    BoschProcess<T, D> process;
+    recipe(process);
+    const int haloCells =
+        std::ceil(process.getMaximumLateralReach() / gridDelta) + 1 +
+        marginCells;
+    makeTiles(haloCells);
+    std::filesystem::create_directories(spillDirectory);
+
+    // the tiles at the domain boundary have a halo on fewer sides, so the
+    // largest tile runs first and its footprint bounds those of the others;
+    // the peak resident set size is shared by all threads, so it cannot
+    // measure one tile while others run
+    std::vector<std::size_t> order(tiles.size());
+    for (std::size_t t = 0; t < tiles.size(); ++t)
+      order[t] = t;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return getLateralPoints(tiles[a]) >
+                              getLateralPoints(tiles[b]);
+                     });
+    std::uint64_t maskPoints = 0, substratePoints = 0;
+    for (auto &stage : runTile(tiles[order.front()])) {
+      maskPoints = std::max(maskPoints, stage.numMaskPoints);
+      substratePoints = std::max(substratePoints, stage.numSubstratePoints);
+    }
+    tileFootprint =
+        coefficients.bytesPerPoint * (maskPoints + 2 * substratePoints);
+
+    const int maxThreads = omp_get_max_threads();
+    numConcurrentTiles = 1;
+    if (memoryBudget > 0 && tileFootprint > 0) {
+      numConcurrentTiles = std::max<std::uint64_t>(
+          1, std::min<std::uint64_t>(memoryBudget / tileFootprint,
+                                     std::min<std::size_t>(maxThreads,
+                                                           tiles.size() - 1)));
+    }
+    const int innerThreads = std::max(1, maxThreads / int(numConcurrentTiles));
+
+    const bool isResetPeakResident = BoschMemoryTracker::isResetPeakResident();
+    if (numConcurrentTiles > 1)
+      BoschMemoryTracker::setResetPeakResident(false);
+    const int maxActiveLevels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+#pragma omp parallel for schedule(dynamic) num_threads(numConcurrentTiles)
+    for (int t = 1; t < int(tiles.size()); ++t) {
+      omp_set_num_threads(innerThreads);
+      runTile(tiles[order[t]]);
+    }
+    omp_set_max_active_levels(maxActiveLevels);
+    BoschMemoryTracker::setResetPeakResident(isResetPeakResident);
+  }
+
+  /// Combine the cores of all tiles into level sets on the whole domain.
+  /// The level sets are overwritten and must have the bounds and the
+  /// gridDelta of the whole domain. The mask is only stitched if it is
+  /// given. Unlike apply(), this is not bounded by disk space: the narrow
+  /// band points of all tiles are collected and the whole level set is
+  /// built in memory. For domains whose narrow band does not fit, use the
+  /// level sets of the tiles in the spill directory instead.
+  void stitch(LSPtrType substrate, LSPtrType mask = nullptr) const {
+    stitchLevelSet(substrate, "substrate");
+    if (mask != nullptr)
+      stitchLevelSet(mask, "mask");
+  }
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(TiledBoschProcess);
@@ -4,17 +4,26 @@
 #include <lsGeometricAdvectDistributions.hpp>
 
 #include "BoschProcessData.hpp"
+#include "BoschProgress.hpp"
+#include "DRIEPreCompileMacros.hpp"
+#include "DistributionCounters.hpp"
 
 template <class T, int D>
 class ViaDistribution : public viennals::GeometricAdvectDistribution<T, D> {
+public:
+  /// Depth of the via below the initial point, which decreases with the
+  /// distance from the mask origin (from its x coordinate for a line
+  /// trench) if the via is tapered. The via ends at the bottom of the last
+  /// etched cycle.
   double getDepth(const std::array<viennahrle::CoordType, 3> &initial) const {
     if (!isTapering ||
         std::abs(data.taperStart) > std::abs(data.trenchBottom)) {
-      return data.trenchBottom;
+      return data.etchBottom;
     }
 
     double radius = 0;
-    for (unsigned i = 0; i < D - 1; ++i) {
+    const unsigned numLateral = data.isLineTrench ? 1 : D - 1;
+    for (unsigned i = 0; i < numLateral; ++i) {
       double dist = initial[i] - data.maskOrigin[i];
       radius += dist * dist;
     }
@@ -25,36 +34,67 @@ class ViaDistribution : public viennals::GeometricAdvectDistribution<T, D> {
         data.taperStart +
         std::max(1.0 - radius / (data.startWidth - data.bottomWidth), 0.0) *
             taperDepth;
-    return depth;
+    return (std::abs(depth) > std::abs(data.etchBottom)) ? data.etchBottom
+                                                         : depth;
   }
 
-public:
   BoschProcessDataType<T> data;
   const double taperDepth;
   const bool isTapering;
+  const BoschCancellationToken *cancellation = nullptr;
+  BoschStageProgress *stageProgress = nullptr;
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  DistributionCounters *counters = nullptr;
+#endif
 
   ViaDistribution(const BoschProcessDataType<T> &processData)
       : data(processData), taperDepth(data.trenchBottom - data.taperStart),
         isTapering(data.sidewallTapering) {}
 
+  /// If the token is cancelled, no candidate is inside the distribution
+  /// anymore, so the advection finishes quickly.
+  void setCancellationToken(const BoschCancellationToken *token) {
+    cancellation = token;
+  }
+
+  /// Records every candidate point, to report the progress of the
+  /// advection.
+  void setStageProgress(BoschStageProgress *progress) {
+    stageProgress = progress;
+  }
+
+#ifdef DRIE_DISTRIBUTION_COUNTERS
+  void setCounters(DistributionCounters *passedCounters) {
+    counters = passedCounters;
+  }
+#endif
+
   bool isInside(const std::array<viennahrle::CoordType, 3> &initial,
                 const std::array<viennahrle::CoordType, 3> &candidate,
                 double eps = 0.) const override {
+    if (cancellation != nullptr && cancellation->isCancelled())
+      return false;
+    if (stageProgress != nullptr)
+      stageProgress->recordCandidate(candidate[D - 1]);
+    DRIE_COUNT(counters, IS_INSIDE);
+
     for (unsigned i = 0; i < D - 1; ++i) {
       if (std::abs(candidate[i] - initial[i]) > (data.gridDelta + eps)) {
         return false;
       }
     }
     if (std::abs(candidate[D - 1] - initial[D - 1]) >
-        std::abs(data.trenchBottom) + eps) {
+        std::abs(data.etchBottom) + eps) {
       return false;
     }
+    DRIE_COUNT(counters, IS_INSIDE_ACCEPTED);
     return true;
   }
 
   T getSignedDistance(const std::array<viennahrle::CoordType, 3> &initial,
                       const std::array<viennahrle::CoordType, 3> &candidate,
                       unsigned long initialPointId) const override {
+    DRIE_COUNT(counters, SIGNED_DISTANCE);
     T distance = std::numeric_limits<T>::lowest();
     for (unsigned i = 0; i < D - 1; ++i) {
       T vector = std::abs(candidate[i] - initial[i]);
@@ -72,9 +112,11 @@ public:
       bounds[2 * i] = -data.gridDelta * ((data.trenchBottom < 0) ? -1 : 1);
       bounds[2 * i + 1] = data.gridDelta * ((data.trenchBottom < 0) ? -1 : 1);
     }
-    bounds[2 * (D - 1)] = -data.trenchBottom;
-    bounds[2 * (D - 1) + 1] = data.trenchBottom;
+    bounds[2 * (D - 1)] = -data.etchBottom;
+    bounds[2 * (D - 1) + 1] = data.etchBottom;
 
     return bounds;
   }
-};
\ No newline at end of file
+};
+
+DRIE_PRECOMPILE_PRECISION_DIMENSION(ViaDistribution);